@@ -0,0 +1,749 @@
+//Benchmark suite of the fractal generators
+//Sweeps a fixed corpus of scenes over generator, simd type, thread count and resolution,
+//reports throughput and scaling efficiency and writes everything as json,
+//optionally comparing it against a baseline written by an earlier run
+//Generation and 2D post-processing stages are also timed in every buffer layout,
+//Buddhabrot accumulation is timed over thread counts for both histogram strategies,
+//and histogram equalization is timed against the generation of the same frame
+//Fully refined deadline renders are checked to be identical to plain frame renders,
+//and zoom sequences rendered through an exponential map are timed against rendering every frame
+//
+//Usage: CaffeinicFractalitis_bench [-quick] [-out <file>] [-baseline <file>]
+//                                  [-tolerance <fraction>] [-repeats <n>]
+
+#include "ComputeFractal.h"
+#include "GenData.h"
+#include "SimdType.h"
+#include "DataLayout.h"
+#include "Buddhabrot.h"
+#include "Equalize.h"
+#include "Render.h"
+#include "ExpMap.h"
+#include "Image.h"
+
+#include <map>
+#include <array>
+#include <limits>
+#include <optional>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+struct Scene{
+    std::string Name;
+    float CenterX;
+    float CenterY;
+    float Width;
+};
+
+//Chosen to stress different parts of the kernels:
+//mostly fast escaping pixels, many pixels near the boundary,
+//mostly interior pixels running the whole iteration budget,
+//and a zoom deep enough to approach float precision
+static const std::array<Scene, 4> Scenes{{
+    {"Shallow",  -0.5f,           0.0f,          3.0f},
+    {"Boundary", -0.743644786f,   0.131825253f,  0.01f},
+    {"Interior", -0.2f,           0.0f,          0.5f},
+    {"Deep",     -0.743643887f,   0.131825904f,  1e-4f}
+}};
+
+static const std::array<std::pair<std::string, FractalGenerator>, 4> Generators{{
+    {"SmoothIter",  FractalGenerator::SmoothIter},
+    {"Gradient",    FractalGenerator::Gradient},
+    {"BurningShip", FractalGenerator::BurningShip},
+    {"Julia",       FractalGenerator::Julia}
+}};
+
+static const std::array<std::pair<std::string, SimdType>, 3> SimdTypes{{
+    {"Scalar", SimdType::Scalar},
+    {"SSE",    SimdType::SSE},
+    {"AVX",    SimdType::AVX}
+}};
+
+struct BenchArgs{
+    bool Quick = false;
+    std::string OutFile = "bench.json";
+    std::optional<std::string> Baseline;
+    double Tolerance = 0.1;
+    uint32_t Repeats = 3;
+};
+
+static GenData::FrameParams GetFrame(const Scene& s, size_t width, size_t height)
+{
+    //Region stays square regardless of resolution, so that weak scaling
+    //runs sample the same content more densely
+    return GenData::FrameParams{
+        .MinX   = s.CenterX - 0.5f * s.Width,
+        .MaxX   = s.CenterX + 0.5f * s.Width,
+        .MinY   = s.CenterY - 0.5f * s.Width,
+        .MaxY   = s.CenterY + 0.5f * s.Width,
+        .Width  = width,
+        .Height = height
+    };
+}
+
+//Iterations executed by the kernels over the frame, as counted by ComputeFractal::ExecutedIterations
+//Taken from a single threaded scalar run, since the counter is per thread and vector kernels
+//count an iteration once for all their lanes, so the measure is the same for every simd type
+static double CountIterations(GenFunction f, const GenData::FrameParams& p)
+{
+    AlignedVector<float> data(p.Width * p.Height);
+
+    const GenData::ExecutionPolicy policy{
+        .Simd = SimdType::Scalar,
+        .NumJobs = 1
+    };
+
+    const uint64_t before = ComputeFractal::ExecutedIterations;
+
+    GenData::GenerateFractal(data, f, p, policy);
+
+    return static_cast<double>(ComputeFractal::ExecutedIterations - before);
+}
+
+//Best of several runs, after one warm-up run
+static double TimeGeneration(GenFunction f, const GenData::FrameParams& p, SimdType simd, uint32_t threads, uint32_t repeats)
+{
+    AlignedVector<float> data(p.Width * p.Height);
+
+    const GenData::ExecutionPolicy policy{
+        .Simd = simd,
+        .NumJobs = threads
+    };
+
+    GenData::GenerateFractal(data, f, p, policy);
+
+    double best = std::numeric_limits<double>::max();
+
+    for (uint32_t i = 0; i < repeats; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        GenData::GenerateFractal(data, f, p, policy);
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+static double TimeBest(const std::function<void()>& fn, uint32_t repeats)
+{
+    fn();
+
+    double best = std::numeric_limits<double>::max();
+
+    for (uint32_t i = 0; i < repeats; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        fn();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+static const std::array<std::pair<std::string, DataLayout>, 3> Layouts{{
+    {"RowMajor", DataLayout::RowMajor},
+    {"Tiled",    DataLayout::Tiled},
+    {"Morton",   DataLayout::Morton}
+}};
+
+//Times generation, 2D stages and de-tiling in every layout on a frame that does not fit in cache,
+//and checks that de-tiled results are identical to a single threaded row-major reference
+static json BenchLayouts(size_t res, uint32_t threads, uint32_t repeats)
+{
+    //Not a multiple of the tile side, so that partial tiles are part of the measurement
+    const GenData::FrameParams frame = GetFrame(Scenes[1], res, res);
+
+    const GenData::ExecutionPolicy policy{
+        .Simd = SimdType::SSE,
+        .NumJobs = threads
+    };
+
+    const GenFunction f = GetGeneratingFunction(FractalGenerator::SmoothIter);
+
+    const size_t pixels = frame.Width * frame.Height;
+    const size_t half_pixels = (frame.Width / 2) * (frame.Height / 2);
+
+    //Row-major reference, computed single threaded, so that a result depending on the split
+    //into jobs shows up as a difference in every layout, row-major included
+    AlignedVector<float> ref_data(pixels), ref_variance(pixels), ref_half(half_pixels);
+
+    const GenData::ExecutionPolicy ref_policy{
+        .Simd = policy.Simd,
+        .NumJobs = 1
+    };
+
+    Layout::GenerateFractal(ref_data, DataLayout::RowMajor, f, frame, ref_policy);
+    Layout::LocalVariance(ref_data, ref_variance, DataLayout::RowMajor, frame.Width, frame.Height, 1);
+    Layout::Downsample(ref_data, DataLayout::RowMajor, ref_half, frame.Width, frame.Height, 1);
+
+    json results = json::array();
+
+    for (const auto& [name, layout] : Layouts)
+    {
+        const size_t size = Layout::BufferSize(layout, frame.Width, frame.Height);
+
+        AlignedVector<float> data(size), variance(size), half(half_pixels), out(pixels), out_variance(pixels);
+
+        const double generate = TimeBest([&](){
+            Layout::GenerateFractal(data, layout, f, frame, policy);
+        }, repeats);
+
+        const double local_variance = TimeBest([&](){
+            Layout::LocalVariance(data, variance, layout, frame.Width, frame.Height, threads);
+        }, repeats);
+
+        const double downsample = TimeBest([&](){
+            Layout::Downsample(data, layout, half, frame.Width, frame.Height, threads);
+        }, repeats);
+
+        const double detile = TimeBest([&](){
+            Layout::ToRowMajor(data, layout, out, frame.Width, frame.Height, threads);
+        }, repeats);
+
+        Layout::ToRowMajor(variance, layout, out_variance, frame.Width, frame.Height, threads);
+
+        //Bitwise, so that NaNs of interior points compare equal too
+        auto Same = [](const AlignedVector<float>& a, const AlignedVector<float>& b)
+        {
+            return std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+        };
+
+        const bool matches = Same(out, ref_data) && Same(out_variance, ref_variance) && Same(half, ref_half);
+
+        json result{
+            {"Layout", name},
+            {"Threads", threads},
+            {"Width", frame.Width},
+            {"Height", frame.Height},
+            {"GenerateSeconds", generate},
+            {"LocalVarianceSeconds", local_variance},
+            {"DownsampleSeconds", downsample},
+            {"ToRowMajorSeconds", detile},
+            {"MatchesReference", matches}
+        };
+
+        std::cout << name << "/" << threads << "/" << frame.Width << "x" << frame.Height << ": generate "
+                  << 1000.0 * generate << "[ms], local variance " << 1000.0 * local_variance
+                  << "[ms], downsample " << 1000.0 * downsample << "[ms], to row-major "
+                  << 1000.0 * detile << "[ms]" << (matches ? "" : ", DIFFERS FROM REFERENCE") << '\n';
+
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+static const std::array<std::pair<std::string, Buddhabrot::Sampling>, 2> Samplings{{
+    {"Uniform",    Buddhabrot::Sampling::Uniform},
+    {"Metropolis", Buddhabrot::Sampling::Metropolis}
+}};
+
+//Samples per second of orbit accumulation and their scaling over threads,
+//with a private histogram per thread and with a single shared one of atomic counters
+static json BenchBuddhabrot(uint64_t samples, const std::vector<uint32_t>& thread_counts, uint32_t repeats)
+{
+    const GenData::FrameParams frame = GetFrame(Scenes[0], 512, 512);
+
+    json results = json::array();
+
+    for (const auto& [name, sampling] : Samplings)
+    {
+        for (const uint32_t shards : {0u, 1u})
+        {
+            double base = 0.0;
+
+            for (const uint32_t threads : thread_counts)
+            {
+                const Buddhabrot::BuddhabrotParams params{
+                    .Samples = samples,
+                    .Mode    = sampling,
+                    .Shards  = shards
+                };
+
+                const GenData::ExecutionPolicy policy{
+                    .Simd = SimdType::AVX,
+                    .NumJobs = threads
+                };
+
+                AlignedVector<float> density(frame.Width * frame.Height);
+
+                uint64_t taken = 0;
+
+                const double seconds = TimeBest([&](){
+                    taken = Buddhabrot::Accumulate(density, FractalGenerator::SmoothIter, frame, params, policy).Samples;
+                }, repeats);
+
+                if (threads == 1)
+                    base = seconds;
+
+                const json result{
+                    {"Sampling", name},
+                    {"Histograms", (shards == 0) ? "PerThread" : "Shared"},
+                    {"Threads", threads},
+                    {"Samples", taken},
+                    {"Seconds", seconds},
+                    {"MSamplesPerSecond", static_cast<double>(taken) / seconds * 1e-6},
+                    {"StrongScaling", base / (seconds * threads)}
+                };
+
+                std::cout << "Buddhabrot/" << name << "/" << result["Histograms"].get<std::string>() << "/" << threads << ": "
+                          << result["MSamplesPerSecond"].get<double>() << " MSamples/s, strong "
+                          << 100.0 * result["StrongScaling"].get<double>() << "%\n";
+
+                results.push_back(result);
+            }
+        }
+    }
+
+    return results;
+}
+
+//Cost of histogram equalization relative to generating the frame it is applied to
+static json BenchEqualize(size_t res, uint32_t threads, uint32_t repeats)
+{
+    const GenData::FrameParams frame = GetFrame(Scenes[1], res, res);
+
+    const GenData::ExecutionPolicy policy{
+        .Simd = SimdType::AVX,
+        .NumJobs = threads
+    };
+
+    const GenFunction f = GetGeneratingFunction(FractalGenerator::SmoothIter);
+
+    AlignedVector<float> data(frame.Width * frame.Height), out(frame.Width * frame.Height);
+
+    const double generate = TimeBest([&](){
+        GenData::GenerateFractal(data, f, frame, policy);
+    }, repeats);
+
+    Equalize::Equalizer equalizer(Equalize::EqualizeParams{
+        .Range       = GetValueRange(FractalGenerator::SmoothIter),
+        .OutputScale = static_cast<float>(IterationBudget)
+    });
+
+    const double histogram = TimeBest([&](){
+        equalizer.Update(data, threads);
+    }, repeats);
+
+    const double apply = TimeBest([&](){
+        equalizer.Apply(data, out, threads);
+    }, repeats);
+
+    const json result{
+        {"Threads", threads},
+        {"Width", frame.Width},
+        {"Height", frame.Height},
+        {"GenerateSeconds", generate},
+        {"HistogramSeconds", histogram},
+        {"ApplySeconds", apply},
+        {"FractionOfGeneration", (histogram + apply) / generate}
+    };
+
+    std::cout << "Equalize/" << threads << "/" << frame.Width << "x" << frame.Height << ": histogram "
+              << 1000.0 * histogram << "[ms], apply " << 1000.0 * apply << "[ms], "
+              << 100.0 * result["FractionOfGeneration"].get<double>() << "% of generation\n";
+
+    return result;
+}
+
+//Deadline render given enough time to refine every tile down to single pixels, compared with
+//the same frame generated in one piece, both as generator output and as colored pixels
+static json BenchDeadline(SimdType simd, const std::string& simd_name, uint32_t threads)
+{
+    //Odd size, so that subgrid rows end in partial vectors
+    const GenData::FrameParams frame = GetFrame(Scenes[1], 1001, 701);
+
+    const GenData::ExecutionPolicy policy{
+        .Simd = simd,
+        .NumJobs = threads
+    };
+
+    const GenFunction f = GetGeneratingFunction(FractalGenerator::SmoothIter);
+    const Image::ColoringFn c = Image::GetColoringFunction(Image::ImageColoring::IterToColorIQ);
+
+    const size_t pixels = frame.Width * frame.Height;
+
+    AlignedVector<float> reference(pixels), refined(pixels);
+
+    GenData::GenerateFractal(reference, f, frame, policy);
+
+    //Generator output the way refinement produces it, one row of a tile at a time
+    AlignedVector<float> scratch(policy.TileSize);
+
+    for (size_t y = 0; y < frame.Height; y++)
+    {
+        for (size_t x = 0; x < frame.Width; x += policy.TileSize)
+        {
+            const GenData::TileRect row{
+                .X      = x,
+                .Y      = y,
+                .Width  = std::min(policy.TileSize, frame.Width - x),
+                .Height = 1
+            };
+
+            GenData::GenerateSubgrid(scratch.data(), f, frame, row, 1, 0, 0, simd);
+            std::copy_n(scratch.data(), row.Width, &refined[y * frame.Width + x]);
+        }
+    }
+
+    const bool data_matches = std::memcmp(reference.data(), refined.data(), pixels * sizeof(float)) == 0;
+
+    std::vector<Image::Pixel> image(pixels);
+
+    const Render::DeadlineParams params{
+        .Budget = std::chrono::hours(1),
+        .CoarseStep = 8
+    };
+
+    const Render::DeadlineStats stats = Render::RenderWithDeadline(image, f, c, frame, policy, params);
+
+    size_t differing = 0;
+
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const Image::Pixel expected = c(reference[i]);
+
+        if (image[i].r != expected.r || image[i].g != expected.g || image[i].b != expected.b)
+            differing++;
+    }
+
+    const bool matches = data_matches && differing == 0 && stats.Step == 1;
+
+    const json result{
+        {"Simd", simd_name},
+        {"Threads", threads},
+        {"Width", frame.Width},
+        {"Height", frame.Height},
+        {"Seconds", std::chrono::duration<double>(stats.Elapsed).count()},
+        {"DifferingPixels", differing},
+        {"MatchesFrames", matches}
+    };
+
+    std::cout << "Deadline/" << simd_name << "/" << threads << "/" << frame.Width << "x" << frame.Height << ": refined in "
+              << 1000.0 * result["Seconds"].get<double>() << "[ms]"
+              << (matches ? "" : ", DIFFERS FROM FRAMES (" + std::to_string(differing) + " pixels)") << '\n';
+
+    return result;
+}
+
+//Zoom sequence rendered frame by frame and through a single log-polar strip,
+//which is generated once and then remapped to every frame
+static json BenchExpMap(uint32_t num_frames, size_t res, uint32_t threads)
+{
+    //Shallow start, zooming into the boundary at the deep scene's center
+    const ExpMap::SequenceParams sequence{
+        .CenterX = Scenes[3].CenterX,
+        .CenterY = Scenes[3].CenterY,
+        .InitialWidth = Scenes[0].Width,
+        .ZoomSpeed = 0.99f,
+        .NumFrames = num_frames,
+        .Width = res,
+        .Height = res
+    };
+
+    const GenData::ExecutionPolicy policy{
+        .Simd = SimdType::AVX,
+        .NumJobs = threads
+    };
+
+    const GenFunction f = GetGeneratingFunction(FractalGenerator::SmoothIter);
+
+    AlignedVector<float> data(res * res);
+
+    const auto frames_start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        const Scene zoomed{
+            .Name = "",
+            .CenterX = sequence.CenterX,
+            .CenterY = sequence.CenterY,
+            .Width = sequence.InitialWidth * std::pow(sequence.ZoomSpeed, static_cast<float>(i))
+        };
+
+        GenData::GenerateFractal(data, f, GetFrame(zoomed, res, res), policy);
+    }
+
+    const std::chrono::duration<double> frames = std::chrono::steady_clock::now() - frames_start;
+
+    const auto strip_start = std::chrono::steady_clock::now();
+
+    const ExpMap::Strip strip = ExpMap::GenerateStrip(f, sequence, policy);
+
+    const std::chrono::duration<double> generate_strip = std::chrono::steady_clock::now() - strip_start;
+
+    const ExpMap::FrameMapper mapper(strip, sequence);
+
+    const auto map_start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < num_frames; i++)
+        mapper.MapFrame(data, i, threads);
+
+    const std::chrono::duration<double> map = std::chrono::steady_clock::now() - map_start;
+
+    const double exp_map = generate_strip.count() + map.count();
+
+    const json result{
+        {"Threads", threads},
+        {"Frames", num_frames},
+        {"Width", res},
+        {"Height", res},
+        {"FramesSeconds", frames.count()},
+        {"StripSeconds", generate_strip.count()},
+        {"MapSeconds", map.count()},
+        {"Speedup", frames.count() / exp_map}
+    };
+
+    std::cout << "ExpMap/" << threads << "/" << num_frames << "x" << res << "x" << res << ": frames "
+              << 1000.0 * frames.count() << "[ms], strip " << 1000.0 * generate_strip.count() << "[ms], map "
+              << 1000.0 * map.count() / num_frames << "[ms/frame], speedup "
+              << result["Speedup"].get<double>() << '\n';
+
+    return result;
+}
+
+static std::string GetKey(const json& result)
+{
+    return result["Scene"].get<std::string>() + "/" + result["Generator"].get<std::string>() + "/"
+         + result["Simd"].get<std::string>() + "/" + std::to_string(result["Threads"].get<uint32_t>()) + "/"
+         + std::to_string(result["Width"].get<size_t>()) + "x" + std::to_string(result["Height"].get<size_t>());
+}
+
+//Returns number of results slower than the baseline by more than the tolerance
+static size_t CompareToBaseline(const json& results, const json& baseline, double tolerance)
+{
+    std::map<std::string, double> reference;
+
+    for (const auto& result : baseline["Results"])
+        reference[GetKey(result)] = result["MPixelsPerSecond"];
+
+    size_t regressions = 0;
+
+    for (const auto& result : results)
+    {
+        const auto it = reference.find(GetKey(result));
+
+        if (it == reference.end())
+            continue;
+
+        const double current = result["MPixelsPerSecond"];
+        const double ratio = current / it->second;
+
+        if (ratio < 1.0 - tolerance)
+        {
+            std::cout << "REGRESSION " << GetKey(result) << ": " << current << " MPix/s vs "
+                      << it->second << " MPix/s in baseline (" << 100.0 * (ratio - 1.0) << "%)\n";
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+static std::optional<BenchArgs> ParseArgs(int argc, char* argv[])
+{
+    BenchArgs res;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+
+        if (arg == "-quick")
+            res.Quick = true;
+        else if (arg == "-out" && has_value)
+            res.OutFile = argv[++i];
+        else if (arg == "-baseline" && has_value)
+            res.Baseline = argv[++i];
+        else if (arg == "-tolerance" && has_value)
+            res.Tolerance = std::stod(argv[++i]);
+        else if (arg == "-repeats" && has_value)
+            res.Repeats = std::max(1, std::stoi(argv[++i]));
+        else
+        {
+            std::cerr << "Unknown argument " << arg << '\n';
+            return std::nullopt;
+        }
+    }
+
+    return res;
+}
+
+int main(int argc, char* argv[])
+{
+    const auto args = ParseArgs(argc, argv);
+
+    if (!args.has_value())
+        return -1;
+
+    const uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    //Powers of two up to the machine's thread count, plus the count itself
+    std::vector<uint32_t> thread_counts;
+
+    for (uint32_t t = 1; t < max_threads; t *= 2)
+        thread_counts.push_back(t);
+
+    thread_counts.push_back(max_threads);
+
+    if (args->Quick)
+        thread_counts = (max_threads > 1) ? std::vector<uint32_t>{1, max_threads} : std::vector<uint32_t>{1};
+
+    const std::vector<size_t> resolutions = args->Quick ? std::vector<size_t>{256} : std::vector<size_t>{256, 512, 1024};
+
+    json results = json::array();
+
+    for (const Scene& scene : Scenes)
+    {
+        for (const size_t res : resolutions)
+        {
+            for (const auto& [gen_name, generator] : Generators)
+            {
+                const GenFunction f = GetGeneratingFunction(generator);
+
+                //Iteration counts only depend on the generator and the frame, not on how it is computed
+                const double iterations = CountIterations(f, GetFrame(scene, res, res));
+
+                for (const auto& [simd_name, simd] : SimdTypes)
+                {
+                    double strong_base = 0.0, weak_base = 0.0;
+
+                    for (const uint32_t threads : thread_counts)
+                    {
+                        const GenData::FrameParams frame = GetFrame(scene, res, res);
+                        const double seconds = TimeGeneration(f, frame, simd, threads, args->Repeats);
+
+                        //Weak scaling keeps pixels per thread constant
+                        const GenData::FrameParams weak_frame = GetFrame(scene, res, res * threads);
+                        const double weak_seconds = (threads == 1) ? seconds
+                                                  : TimeGeneration(f, weak_frame, simd, threads, args->Repeats);
+
+                        if (threads == 1)
+                        {
+                            strong_base = seconds;
+                            weak_base = seconds;
+                        }
+
+                        const double pixels = double(res) * double(res);
+
+                        json result{
+                            {"Scene", scene.Name},
+                            {"Generator", gen_name},
+                            {"Simd", simd_name},
+                            {"Threads", threads},
+                            {"Width", res},
+                            {"Height", res},
+                            {"Seconds", seconds},
+                            {"MPixelsPerSecond", pixels / seconds * 1e-6},
+                            {"GIterationsPerSecond", iterations / seconds * 1e-9},
+                            {"StrongScaling", strong_base / (seconds * threads)},
+                            {"WeakScaling", weak_base / weak_seconds}
+                        };
+
+                        std::cout << GetKey(result) << ": "
+                                  << result["MPixelsPerSecond"].get<double>() << " MPix/s, "
+                                  << result["GIterationsPerSecond"].get<double>() << " GIter/s, strong "
+                                  << 100.0 * result["StrongScaling"].get<double>() << "%, weak "
+                                  << 100.0 * result["WeakScaling"].get<double>() << "%\n";
+
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+
+    json layouts = json::array();
+
+    for (const uint32_t threads : std::vector<uint32_t>{1, max_threads})
+    {
+        for (const auto& result : BenchLayouts(args->Quick ? 1000 : 3000, threads, args->Repeats))
+            layouts.push_back(result);
+
+        if (max_threads == 1)
+            break;
+    }
+
+    json equalize = json::array();
+
+    for (const uint32_t threads : std::vector<uint32_t>{1, max_threads})
+    {
+        equalize.push_back(BenchEqualize(args->Quick ? 1000 : 3000, threads, args->Repeats));
+
+        if (max_threads == 1)
+            break;
+    }
+
+    json deadline = json::array();
+
+    for (const auto& [simd_name, simd] : SimdTypes)
+        deadline.push_back(BenchDeadline(simd, simd_name, max_threads));
+
+    json exp_map = json::array();
+
+    for (const uint32_t num_frames : args->Quick ? std::vector<uint32_t>{100} : std::vector<uint32_t>{100, 1000})
+        exp_map.push_back(BenchExpMap(num_frames, args->Quick ? 256 : 512, max_threads));
+
+    const json buddhabrot = BenchBuddhabrot(args->Quick ? 2'000'000 : 20'000'000, thread_counts, args->Repeats);
+
+    const json report{
+        {"IterationBudget", IterationBudget},
+        {"HardwareThreads", max_threads},
+        {"Repeats", args->Repeats},
+        {"Results", results},
+        {"Layouts", layouts},
+        {"Buddhabrot", buddhabrot},
+        {"Equalize", equalize},
+        {"Deadline", deadline},
+        {"ExpMap", exp_map}
+    };
+
+    std::ofstream(args->OutFile) << report.dump(4) << '\n';
+
+    std::cout << "Results written to " << args->OutFile << '\n';
+
+    if (args->Baseline.has_value())
+    {
+        std::ifstream file(args->Baseline.value());
+
+        if (!file)
+        {
+            std::cerr << "Failed to open baseline " << args->Baseline.value() << '\n';
+            return -1;
+        }
+
+        const json baseline = json::parse(file, nullptr, false);
+
+        if (baseline.is_discarded() || !baseline.contains("Results"))
+        {
+            std::cerr << "Invalid baseline " << args->Baseline.value() << '\n';
+            return -1;
+        }
+
+        const size_t regressions = CompareToBaseline(results, baseline, args->Tolerance);
+
+        std::cout << regressions << " regressions beyond " << 100.0 * args->Tolerance << "% tolerance\n";
+
+        return regressions > 0 ? 1 : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include "Autotune.h"
+
+#include "GenData.h"
+#include "Render.h"
+#include "Image.h"
+#include "Checkpoint.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+static constexpr uint32_t ProfileVersion = 1;
+
+//Candidate has to be this much faster to replace the current best
+static constexpr double RequiredGain = 0.03;
+
+static constexpr size_t Repeats = 3;
+
+//Whole set at a quarter of 720p, with enough boundary and interior
+//to weigh the cheap and the expensive pixels like an ordinary zoom does
+static const GenData::FrameParams CalibrationFrame{
+    .MinX   = -2.2f,
+    .MaxX   =  0.8f,
+    .MinY   = -0.84375f,
+    .MaxY   =  0.84375f,
+    .Width  = 640,
+    .Height = 360
+};
+
+static bool IsSupported(SimdType simd)
+{
+#if defined(__GNUC__)
+    if (simd == SimdType::AVX)
+        return __builtin_cpu_supports("avx");
+#endif
+    (void)simd;
+    return true;
+}
+
+static std::string MachineSignature()
+{
+    std::string model;
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+
+    for (std::string line; std::getline(cpuinfo, line);)
+    {
+        if (line.starts_with("model name"))
+        {
+            model = line.substr(std::min(line.find(':') + 1, line.size()));
+            break;
+        }
+    }
+
+    return model + "|" + std::to_string(std::thread::hardware_concurrency());
+}
+
+//Best of a few calibration renders, in seconds
+static double Measure(const Autotune::Profile& candidate, std::span<Image::Pixel> image)
+{
+    const GenData::ExecutionPolicy e{
+        .Simd = candidate.Simd,
+        .NumJobs = candidate.NumThreads,
+        .TileSize = candidate.TileSize
+    };
+
+    const GenFunction f = GetGeneratingFunction(FractalGenerator::SmoothIter);
+    const Image::ColoringFn c = Image::GetColoringFunction(Image::ImageColoring::IterToColorIQ);
+
+    double best = 0.0;
+
+    for (size_t i = 0; i < Repeats; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        Render::GenerateAndColor(image, f, c, CalibrationFrame, e);
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (i == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+
+    return best;
+}
+
+const char* Autotune::SimdName(SimdType simd)
+{
+    switch (simd)
+    {
+        case SimdType::Scalar: return "Scalar";
+        case SimdType::SSE:    return "SSE";
+        case SimdType::AVX:    return "AVX";
+    }
+
+    return "Unknown";
+}
+
+Autotune::Profile Autotune::Tune(std::ostream& log)
+{
+    const uint32_t hw_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Image::Pixel> image(CalibrationFrame.Width * CalibrationFrame.Height);
+
+    Profile best{
+        .Simd = SimdType::SSE,
+        .NumThreads = hw_threads,
+        .TileSize = 64
+    };
+
+    double best_time = 0.0;
+
+    //Candidates come in order of preference, the first one sets the reference time
+    auto Try = [&](Profile candidate, bool first)
+    {
+        const double time = Measure(candidate, image);
+
+        const double mpix = double(image.size()) / time * 1e-6;
+
+        log << "  " << SimdName(candidate.Simd) << ", " << candidate.NumThreads << " threads, tile "
+            << candidate.TileSize << ": " << 1000.0 * time << "[ms], " << mpix << " MPix/s\n";
+
+        if (first || time < best_time * (1.0 - RequiredGain))
+        {
+            best = candidate;
+            best_time = time;
+        }
+    };
+
+    //Wakes up the cores and faults in the image, so that the first candidate is not penalized
+    Measure(best, image);
+
+    log << "Tuning simd width:\n";
+
+    {
+        const Profile start = best;
+        bool first = true;
+
+        for (SimdType simd : {SimdType::AVX, SimdType::SSE, SimdType::Scalar})
+        {
+            if (!IsSupported(simd))
+                continue;
+
+            Profile candidate = start;
+            candidate.Simd = simd;
+
+            Try(candidate, first);
+            first = false;
+        }
+    }
+
+    log << "Tuning thread count:\n";
+
+    {
+        //All hardware threads first, then half of them (one per core with SMT),
+        //then powers of two below
+        std::vector<uint32_t> counts{hw_threads};
+
+        if (hw_threads >= 2)
+            counts.push_back(hw_threads / 2);
+
+        for (uint32_t n = 1; n < hw_threads / 2; n *= 2)
+            counts.push_back(n);
+
+        const Profile start = best;
+        bool first = true;
+
+        for (uint32_t n : counts)
+        {
+            Profile candidate = start;
+            candidate.NumThreads = n;
+
+            Try(candidate, first);
+            first = false;
+        }
+    }
+
+    log << "Tuning tile size:\n";
+
+    {
+        const Profile start = best;
+        bool first = true;
+
+        for (size_t tile : {64, 32, 128, 16, 256})
+        {
+            Profile candidate = start;
+            candidate.TileSize = tile;
+
+            Try(candidate, first);
+            first = false;
+        }
+    }
+
+    log << "Selected " << SimdName(best.Simd) << ", " << best.NumThreads << " threads, tile "
+        << best.TileSize << '\n';
+
+    return best;
+}
+
+std::optional<Autotune::Profile> Autotune::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+
+    std::string magic;
+    uint32_t version = 0;
+
+    if (!(file >> magic >> version) || magic != "CFPROFILE" || version != ProfileVersion)
+        return std::nullopt;
+
+    Profile profile;
+    uint64_t machine = 0;
+
+    bool has_machine = false, has_simd = false, has_threads = false, has_tile = false;
+
+    for (std::string key; file >> key;)
+    {
+        if (key == "machine")
+        {
+            has_machine = static_cast<bool>(file >> std::hex >> machine >> std::dec);
+        }
+
+        else if (key == "simd")
+        {
+            std::string name;
+            file >> name;
+
+            for (SimdType simd : {SimdType::Scalar, SimdType::SSE, SimdType::AVX})
+            {
+                if (name == SimdName(simd))
+                {
+                    profile.Simd = simd;
+                    has_simd = true;
+                }
+            }
+        }
+
+        else if (key == "threads")
+        {
+            has_threads = static_cast<bool>(file >> profile.NumThreads) && profile.NumThreads > 0;
+        }
+
+        else if (key == "tile")
+        {
+            has_tile = static_cast<bool>(file >> profile.TileSize) && profile.TileSize > 0;
+        }
+
+        else
+        {
+            break;
+        }
+    }
+
+    if (!has_machine || !has_simd || !has_threads || !has_tile)
+        return std::nullopt;
+
+    if (machine != Checkpoint::Hash(MachineSignature()) || !IsSupported(profile.Simd))
+        return std::nullopt;
+
+    return profile;
+}
+
+bool Autotune::Save(const Profile& profile, const std::filesystem::path& path)
+{
+    std::error_code ec;
+
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+    //Written under a temporary name, so that a concurrent run never reads half a profile
+    //Name is unique per run, concurrent tuning runs each rename a complete file
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", std::random_device{}());
+
+    std::filesystem::path temp = path;
+    temp += suffix;
+
+    {
+        std::ofstream file(temp);
+
+        file << "CFPROFILE " << ProfileVersion << '\n'
+             << "machine " << std::hex << Checkpoint::Hash(MachineSignature()) << std::dec << '\n'
+             << "simd " << SimdName(profile.Simd) << '\n'
+             << "threads " << profile.NumThreads << '\n'
+             << "tile " << profile.TileSize << '\n';
+
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, ec);
+
+    return !ec;
+}
+
+std::filesystem::path Autotune::DefaultPath()
+{
+    const std::filesystem::path name = "caffeinic-fractalitis";
+
+    if (const char* config = std::getenv("XDG_CONFIG_HOME"); config != nullptr && *config != '\0')
+        return std::filesystem::path(config) / name / "profile";
+
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+        return std::filesystem::path(home) / ".config" / name / "profile";
+
+    return name.string() + ".profile";
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <iostream>
+#include <filesystem>
+
+#include "SimdType.h"
+
+//Picks execution parameters of the tiled render path for the local machine
+//by timing short calibration renders, the result is kept in a profile file:
+//  CFPROFILE <version>
+//  machine <hash of cpu model and thread count>
+//  simd <Scalar|SSE|AVX>
+//  threads <count>
+//  tile <side length>
+namespace Autotune {
+
+    struct Profile{
+        SimdType Simd = SimdType::SSE;
+        uint32_t NumThreads = 1;
+        size_t TileSize = 64;
+    };
+
+    //Tunes one parameter at a time: simd width at all hardware threads,
+    //then thread count, then tile size, every measurement is printed to log
+    //A candidate replaces the current best only if it is faster by a clear margin,
+    //so that noise does not pick e.g. more threads than the machine can use
+    Profile Tune(std::ostream& log = std::cout);
+
+    //Profile tuned on a different machine (or by a different profile version) is ignored
+    std::optional<Profile> Load(const std::filesystem::path& path);
+    bool Save(const Profile& profile, const std::filesystem::path& path);
+
+    //$XDG_CONFIG_HOME/caffeinic-fractalitis/profile, or ~/.config/... when it is unset,
+    //or a file in the working directory when neither HOME is known
+    std::filesystem::path DefaultPath();
+
+    const char* SimdName(SimdType simd);
+}
@@ -0,0 +1,495 @@
+#include "Buddhabrot.h"
+#include "Formula.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <numbers>
+#include <algorithm>
+#include <type_traits>
+
+using namespace ComputeFractal;
+
+//Points c are drawn from [-SampleRadius, SampleRadius]^2, orbits leaving the disc of this radius escape
+static constexpr float SampleRadius = 2.0f;
+
+//Metropolis chains propose an independent uniform point with this probability,
+//so that they do not stay trapped in one contributing region
+static constexpr float LargeStepProbability = 0.25f;
+
+//Radius of small Metropolis steps, log-uniform between these fractions of the frame width
+static constexpr float MinStep = 1e-4f;
+static constexpr float MaxStep = 1e-1f;
+
+//SplitMix64, small and fast enough to not show up next to the orbits
+struct Random{
+    uint64_t State;
+
+    uint64_t Next()
+    {
+        uint64_t z = (State += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    //Uniform in [0, 1)
+    float Uniform()
+    {
+        return static_cast<float>(Next() >> 40) * 0x1.0p-24f;
+    }
+};
+
+//Maps orbit points to pixels, with the same orientation as GenData (row 0 at MaxY)
+struct Frame{
+    float MinX;
+    float MaxY;
+    float PixelsPerUnitX;
+    float PixelsPerUnitY;
+    float Width;
+    float Height;
+    size_t Stride;
+
+    //False for points outside of the frame and for NaNs
+    bool PixelOf(float x, float y, size_t& idx) const
+    {
+        const float fx = (x - MinX) * PixelsPerUnitX;
+        const float fy = (MaxY - y) * PixelsPerUnitY;
+
+        if (!(fx >= 0.0f && fx < Width && fy >= 0.0f && fy < Height))
+            return false;
+
+        idx = static_cast<size_t>(fy) * Stride + static_cast<size_t>(fx);
+        return true;
+    }
+};
+
+//Uniform samples are counted in integers, a float would stop counting at 2^24 hits of a pixel;
+//Metropolis weights are fractional and summed in double for the same reason
+
+//Thread's own histogram, plain additions
+template<typename C>
+struct PrivateHistogram{
+    using Count = C;
+
+    C* Data;
+
+    void Add(size_t idx, C weight) {Data[idx] += weight;}
+};
+
+//Histogram shared by several threads
+template<typename C>
+struct SharedHistogram{
+    using Count = C;
+
+    std::atomic<C>* Data;
+
+    void Add(size_t idx, C weight) {Data[idx].fetch_add(weight, std::memory_order_relaxed);}
+};
+
+template<SimdType T>
+constexpr size_t Lanes = sizeof(typename SimdFloat<T>::ValueType) / sizeof(float);
+
+//Points inside the main cardioid or the period 2 bulb of the Mandelbrot set never escape,
+//checking that is far cheaper than running them for the whole iteration budget
+template<typename F>
+static bool KnownInterior(float x, float y)
+{
+    if constexpr (std::is_same_v<F, Formula::Multibrot<2>>)
+    {
+        const float xq = x - 0.25f;
+        const float q = xq * xq + y * y;
+
+        return q * (q + xq) <= 0.25f * y * y || (x + 1.0f) * (x + 1.0f) + y * y <= 0.0625f;
+    }
+
+    else
+    {
+        return false;
+    }
+}
+
+//Number of iterations every lane stayed bounded, max_iter for lanes that did not escape
+template<typename F, SimdType T>
+static void CountIterations(const float* cx, const float* cy, uint32_t* out, uint32_t max_iter)
+{
+    constexpr float bail2 = SampleRadius * SampleRadius;
+
+    if constexpr (T == SimdType::Scalar)
+    {
+        using complex = Complex<SimdType::Scalar>;
+
+        const complex c(cx[0], cy[0]);
+        complex z(0.0f, 0.0f);
+
+        uint32_t k = 0;
+
+        for (; k < max_iter; k++)
+        {
+            z = F::Step(z, c);
+
+            if (complex::Len2(z).Value > bail2)
+                break;
+        }
+
+        ExecutedIterations += std::min(k + 1, max_iter);
+
+        out[0] = k;
+    }
+
+    else
+    {
+        using complex = Complex<T>;
+        using value = SimdFloat<T>;
+        using mask = typename value::ValueType;
+
+        constexpr size_t lanes = Lanes<T>;
+
+        complex c(0.0f, 0.0f);
+
+        if constexpr (T == SimdType::SSE)
+            c = complex(_mm_load_ps(cx), _mm_load_ps(cy));
+        else
+            c = complex(_mm256_load_ps(cx), _mm256_load_ps(cy));
+
+        complex z(0.0f, 0.0f);
+
+        value one, limit, iter;
+        one = 1.0f;
+        limit = bail2;
+        iter = 0.0f;
+
+        mask condition{};
+
+        uint32_t k = 0;
+
+        for (; k < max_iter; k++)
+        {
+            z = F::Step(z, c);
+
+            condition = value::mask_or(condition, value::greater(complex::Len2(z), limit));
+
+            iter = iter + value::and_not(condition, one);
+
+            if (value::all(condition))
+                break;
+        }
+
+        ExecutedIterations += std::min(k + 1, max_iter);
+
+        alignas(32) std::array<float, lanes> res;
+
+        if constexpr (T == SimdType::SSE)
+            _mm_store_ps(res.data(), iter.Value);
+        else
+            _mm256_store_ps(res.data(), iter.Value);
+
+        for (size_t i = 0; i < lanes; i++)
+            out[i] = static_cast<uint32_t>(res[i]);
+    }
+}
+
+//Replays the bounded part of the orbit of c, calling fn with the pixel of every point inside the frame
+//Kernels of all simd types give identical values, so this reproduces the orbit they counted
+template<typename F, typename Fn>
+static uint32_t VisitOrbit(float cx, float cy, uint32_t iterations, const Frame& frame, Fn&& fn)
+{
+    using complex = Complex<SimdType::Scalar>;
+
+    const complex c(cx, cy);
+    complex z(0.0f, 0.0f);
+
+    uint32_t visited = 0;
+
+    for (uint32_t k = 0; k < iterations; k++)
+    {
+        z = F::Step(z, c);
+
+        size_t idx;
+
+        if (frame.PixelOf(z.Re.Value, z.Im.Value, idx))
+        {
+            fn(idx);
+            visited++;
+        }
+    }
+
+    ExecutedIterations += iterations;
+
+    return visited;
+}
+
+//State of a Metropolis chain, Contribution of 0 means it has not found a contributing point yet
+struct Chain{
+    float X = 0.0f;
+    float Y = 0.0f;
+    uint32_t Iterations = 0;
+    uint32_t Contribution = 0;
+    //Number of steps the chain stayed at this point, its orbit is recorded with this weight once it moves on
+    uint32_t Dwell = 0;
+};
+
+template<typename F, SimdType T, typename H>
+static Buddhabrot::BuddhabrotStats RunWorker(H hist, const Frame& frame, float frame_width,
+                                             const Buddhabrot::BuddhabrotParams& b, uint64_t samples, Random rng)
+{
+    using namespace Buddhabrot;
+
+    constexpr size_t lanes = Lanes<T>;
+
+    alignas(32) std::array<float, lanes> cx, cy;
+    std::array<uint32_t, lanes> iterations;
+    std::array<Chain, lanes> chains;
+
+    BuddhabrotStats stats;
+
+    const bool metropolis = (b.Mode == Sampling::Metropolis);
+
+    auto DrawUniform = [&](float& x, float& y)
+    {
+        do {
+            x = SampleRadius * (2.0f * rng.Uniform() - 1.0f);
+            y = SampleRadius * (2.0f * rng.Uniform() - 1.0f);
+            stats.Samples++;
+        } while (KnownInterior<F>(x, y) && stats.Samples < samples);
+    };
+
+    auto Record = [&](const Chain& chain)
+    {
+        //Only instantiated for the floating point counters Metropolis sampling runs with
+        if constexpr (std::is_floating_point_v<typename H::Count>)
+        {
+            const double weight = static_cast<double>(chain.Dwell) / static_cast<double>(chain.Contribution);
+
+            VisitOrbit<F>(chain.X, chain.Y, chain.Iterations, frame, [&](size_t idx){hist.Add(idx, weight);});
+        }
+    };
+
+    while (stats.Samples < samples)
+    {
+        for (size_t i = 0; i < lanes; i++)
+        {
+            if (!metropolis || chains[i].Contribution == 0 || rng.Uniform() < LargeStepProbability)
+            {
+                DrawUniform(cx[i], cy[i]);
+                continue;
+            }
+
+            //Symmetric step in a random direction, so the acceptance ratio is just the ratio of contributions
+            const float angle = 2.0f * std::numbers::pi_v<float> * rng.Uniform();
+            const float radius = frame_width * MinStep * std::pow(MaxStep / MinStep, rng.Uniform());
+
+            cx[i] = chains[i].X + radius * std::cos(angle);
+            cy[i] = chains[i].Y + radius * std::sin(angle);
+
+            stats.Samples++;
+
+            //Outside of the sampled square the target density is zero, like inside of the set,
+            //such lanes are replaced by a point escaping right away to not hold up the others
+            if (std::abs(cx[i]) > SampleRadius || std::abs(cy[i]) > SampleRadius || KnownInterior<F>(cx[i], cy[i]))
+            {
+                cx[i] = 2.0f * SampleRadius;
+                cy[i] = 2.0f * SampleRadius;
+            }
+        }
+
+        CountIterations<F, T>(cx.data(), cy.data(), iterations.data(), b.MaxIterations);
+
+        for (size_t i = 0; i < lanes; i++)
+        {
+            const bool in_range = iterations[i] >= b.MinIterations && iterations[i] < b.MaxIterations;
+
+            if (!metropolis)
+            {
+                if (in_range && VisitOrbit<F>(cx[i], cy[i], iterations[i], frame, [&](size_t idx){hist.Add(idx, 1);}) > 0)
+                    stats.Contributing++;
+
+                continue;
+            }
+
+            const uint32_t contribution = in_range ? VisitOrbit<F>(cx[i], cy[i], iterations[i], frame, [](size_t){}) : 0;
+
+            if (contribution > 0)
+                stats.Contributing++;
+
+            Chain& chain = chains[i];
+
+            const bool accept = (chain.Contribution == 0)
+                              ? contribution > 0
+                              : rng.Uniform() * static_cast<float>(chain.Contribution) < static_cast<float>(contribution);
+
+            if (accept)
+            {
+                if (chain.Contribution > 0)
+                    Record(chain);
+
+                chain = Chain{cx[i], cy[i], iterations[i], contribution, 1};
+            }
+
+            else if (chain.Contribution > 0)
+            {
+                chain.Dwell++;
+            }
+        }
+    }
+
+    for (const Chain& chain : chains)
+        if (chain.Contribution > 0)
+            Record(chain);
+
+    return stats;
+}
+
+template<typename F, SimdType T, typename C>
+static Buddhabrot::BuddhabrotStats AccumulateCounts(std::span<float> density, GenData::FrameParams p,
+                                                    const Buddhabrot::BuddhabrotParams& b, GenData::ExecutionPolicy e)
+{
+    const Frame frame{
+        .MinX           = p.MinX,
+        .MaxY           = p.MaxY,
+        .PixelsPerUnitX = static_cast<float>(p.Width) / (p.MaxX - p.MinX),
+        .PixelsPerUnitY = static_cast<float>(p.Height) / (p.MaxY - p.MinY),
+        .Width          = static_cast<float>(p.Width),
+        .Height         = static_cast<float>(p.Height),
+        .Stride         = p.Width
+    };
+
+    const size_t num_threads = std::max<size_t>(1, e.NumJobs.has_value() ? e.NumJobs.value()
+                                                                         : std::thread::hardware_concurrency());
+
+    const size_t pixels = p.Width * p.Height;
+
+    std::vector<AlignedVector<C>> private_histograms(b.Shards == 0 ? num_threads : 0);
+    std::vector<std::atomic<C>> shared_histograms(size_t(b.Shards) * pixels);
+
+    std::vector<Buddhabrot::BuddhabrotStats> worker_stats(num_threads);
+
+    auto RunWorkers = [&](size_t start, size_t end)
+    {
+        for (size_t worker = start; worker < end; worker++)
+        {
+            TRACE_ZONE("Orbits", static_cast<int64_t>(worker));
+
+            const uint64_t samples = b.Samples * (worker + 1) / num_threads - b.Samples * worker / num_threads;
+
+            //Streams of different workers start from unrelated states
+            const Random rng{Random{b.Seed ^ (0x9e3779b97f4a7c15 * (worker + 1))}.Next()};
+
+            const float frame_width = p.MaxX - p.MinX;
+
+            if (b.Shards == 0)
+            {
+                //Allocated by the worker itself, so that its pages are first touched on its own node
+                private_histograms[worker] = AlignedVector<C>(pixels, C(0));
+
+                const PrivateHistogram<C> hist{private_histograms[worker].data()};
+                worker_stats[worker] = RunWorker<F, T>(hist, frame, frame_width, b, samples, rng);
+            }
+
+            else
+            {
+                const SharedHistogram<C> hist{&shared_histograms[(worker % b.Shards) * pixels]};
+                worker_stats[worker] = RunWorker<F, T>(hist, frame, frame_width, b, samples, rng);
+            }
+        }
+    };
+
+    GenData::SplitIntoJobs(num_threads, RunWorkers, num_threads, e.PinThreads);
+
+    //Every thread sums all histograms over its own range of pixels, no synchronization needed
+    auto Merge = [&](size_t start, size_t end)
+    {
+        TRACE_ZONE("Merge histograms");
+
+        //Summed in double, density only needs float precision relative to its own value
+        for (size_t i = start; i < end; i++)
+        {
+            double sum = 0.0;
+
+            for (const auto& hist : private_histograms)
+                sum += static_cast<double>(hist[i]);
+
+            for (size_t shard = 0; shard < b.Shards; shard++)
+                sum += static_cast<double>(shared_histograms[shard * pixels + i].load(std::memory_order_relaxed));
+
+            density[i] = static_cast<float>(sum);
+        }
+    };
+
+    GenData::SplitIntoJobs(pixels, Merge, num_threads, e.PinThreads);
+
+    Buddhabrot::BuddhabrotStats res;
+
+    for (const auto& stats : worker_stats)
+    {
+        res.Samples += stats.Samples;
+        res.Contributing += stats.Contributing;
+    }
+
+    return res;
+}
+
+template<typename F, SimdType T>
+static Buddhabrot::BuddhabrotStats AccumulateWith(std::span<float> density, GenData::FrameParams p,
+                                                  const Buddhabrot::BuddhabrotParams& b, GenData::ExecutionPolicy e)
+{
+    if (b.Mode == Buddhabrot::Sampling::Metropolis)
+        return AccumulateCounts<F, T, double>(density, p, b, e);
+
+    return AccumulateCounts<F, T, uint32_t>(density, p, b, e);
+}
+
+template<typename F>
+static Buddhabrot::BuddhabrotStats AccumulateFormula(std::span<float> density, GenData::FrameParams p,
+                                                     const Buddhabrot::BuddhabrotParams& b, GenData::ExecutionPolicy e)
+{
+    switch (e.Simd)
+    {
+        case SimdType::Scalar: return AccumulateWith<F, SimdType::Scalar>(density, p, b, e);
+        case SimdType::SSE:    return AccumulateWith<F, SimdType::SSE>(density, p, b, e);
+        case SimdType::AVX:    return AccumulateWith<F, SimdType::AVX>(density, p, b, e);
+    }
+
+    return {};
+}
+
+Buddhabrot::BuddhabrotStats Buddhabrot::Accumulate(std::span<float> density, FractalGenerator g, GenData::FrameParams p,
+                                                   const BuddhabrotParams& b, GenData::ExecutionPolicy e)
+{
+    using namespace Formula;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    BuddhabrotStats res;
+
+    switch (g)
+    {
+        case FractalGenerator::BurningShip: res = AccumulateFormula<BurningShip>(density, p, b, e);   break;
+        case FractalGenerator::Tricorn:     res = AccumulateFormula<Tricorn>(density, p, b, e);       break;
+        case FractalGenerator::Multibrot3:  res = AccumulateFormula<Multibrot<3>>(density, p, b, e);  break;
+        case FractalGenerator::Multibrot4:  res = AccumulateFormula<Multibrot<4>>(density, p, b, e);  break;
+        default:                            res = AccumulateFormula<Multibrot<2>>(density, p, b, e);  break;
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    res.Seconds = elapsed.count();
+
+    return res;
+}
+
+void Buddhabrot::Normalize(std::span<float> density, float output_scale, std::optional<uint32_t> num_jobs)
+{
+    const float max = density.empty() ? 0.0f : *std::max_element(density.begin(), density.end());
+    const float inv_max = (max > 0.0f) ? 1.0f / max : 0.0f;
+
+    auto NormalizeRange = [&](size_t start, size_t end)
+    {
+        for (size_t i = start; i < end; i++)
+            density[i] = output_scale * std::sqrt(density[i] * inv_max);
+    };
+
+    GenData::SplitIntoJobs(density.size(), NormalizeRange, num_jobs);
+}
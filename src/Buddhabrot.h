@@ -0,0 +1,58 @@
+#pragma once
+
+#include <span>
+#include <cstdint>
+#include <optional>
+
+#include "ComputeFractal.h"
+#include "GenData.h"
+
+//Orbit density rendering (Buddhabrot): instead of coloring every pixel by its own
+//escape time, random points c are iterated and every escaping orbit increments
+//the pixels it passes through, so the image is a histogram of orbit points
+//Points are escape tested in simd batches, orbits of the escaping ones are then
+//replayed one by one to record them
+namespace Buddhabrot {
+
+    enum class Sampling{
+        //Points c drawn uniformly from the square [-2, 2]^2
+        Uniform,
+        //Every simd lane runs a Metropolis chain, whose points are distributed proportionally
+        //to the number of orbit points they put inside the frame, and every recorded orbit
+        //is weighted by the inverse of that number, so that the expected image is the same
+        //as with uniform sampling; needed for zoomed frames, which few uniform orbits cross
+        Metropolis
+    };
+
+    struct BuddhabrotParams{
+        //Points c evaluated per frame, split evenly between threads
+        uint64_t Samples = 10'000'000;
+        //Only orbits escaping after [MinIterations, MaxIterations) iterations are recorded
+        uint32_t MinIterations = 20;
+        uint32_t MaxIterations = IterationBudget;
+        Sampling Mode = Sampling::Uniform;
+        //0 gives every thread a private histogram, summed once all threads are done;
+        //otherwise threads share this many histograms of atomic counters,
+        //so memory stays at Shards frames regardless of thread count
+        uint32_t Shards = 0;
+        uint64_t Seed = 1;
+    };
+
+    struct BuddhabrotStats{
+        uint64_t Samples = 0;
+        //Samples whose orbit escaped within the iteration range and crossed the frame
+        uint64_t Contributing = 0;
+        double Seconds = 0.0;
+    };
+
+    //Accumulates orbit density of generator g over frame p into density, p.Width*p.Height floats, row-major
+    //Julia generators have no orbits of varying c and are rendered as their base formula
+    //Results only depend on the seed, thread count and simd type, except with shared histograms
+    //(Shards > 0) and Metropolis sampling, where fractional weights are added atomically
+    //in whatever order threads get to them, so float rounding differs from run to run
+    BuddhabrotStats Accumulate(std::span<float> density, FractalGenerator g, GenData::FrameParams p,
+                               const BuddhabrotParams& b, GenData::ExecutionPolicy e);
+
+    //Maps density to [0, output_scale] as square root of its ratio to the densest pixel
+    void Normalize(std::span<float> density, float output_scale, std::optional<uint32_t> num_jobs = std::nullopt);
+}
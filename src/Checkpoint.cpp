@@ -0,0 +1,207 @@
+#include "Checkpoint.h"
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+static constexpr std::string_view JournalMagic = "CFCHECKPOINT";
+static constexpr uint32_t JournalVersion = 2;
+
+uint64_t Checkpoint::Hash(std::string_view text, uint64_t seed)
+{
+    uint64_t res = seed;
+
+    for (const char ch : text)
+    {
+        res ^= static_cast<uint8_t>(ch);
+        res *= 0x100000001b3ull;
+    }
+
+    return res;
+}
+
+//Hash of the whole content of a file, reports failure to read it through ec
+static uint64_t HashFile(const fs::path& path, std::error_code& ec)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return 0;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    uint64_t res = Checkpoint::Hash("");
+
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        res = Checkpoint::Hash(std::string_view(buffer.data(), static_cast<size_t>(file.gcount())), res);
+    }
+
+    return res;
+}
+
+Checkpoint::Journal::Journal(const fs::path& path, uint64_t config_hash)
+{
+    std::ifstream existing(path);
+
+    std::string line;
+    bool valid = false;
+
+    if (existing && std::getline(existing, line))
+    {
+        std::istringstream header(line);
+
+        std::string magic;
+        uint32_t version = 0;
+        uint64_t hash = 0;
+
+        header >> magic >> version >> std::hex >> hash;
+
+        valid = header && magic == JournalMagic && version == JournalVersion && hash == config_hash;
+
+        if (!valid)
+            std::cout << "Checkpoint " << path.string() << " belongs to a different configuration, starting over\n";
+    }
+
+    //Incomplete trailing line leaves the stream failed, so it is never counted
+    while (valid && std::getline(existing, line))
+    {
+        if (existing.eof())
+            break;
+
+        std::istringstream entry(line);
+
+        std::string kind;
+        uint32_t frame;
+
+        entry >> kind >> frame;
+
+        if (kind == "frame")
+        {
+            FrameRecord record;
+
+            if (entry >> record.Size >> std::hex >> record.Hash)
+                m_Frames[frame] = record;
+        }
+
+        else if (kind == "band")
+        {
+            BandRecord record;
+            Image::StreamState& state = record.State;
+
+            if (entry >> record.BandHeight >> record.TileSize >> state.Offset >> state.Rows >> state.AdlerA >> state.AdlerB)
+                m_Bands[frame] = record;
+        }
+    }
+
+    existing.close();
+
+    if (valid)
+    {
+        m_File.open(path, std::ios::app);
+
+        if (!m_Frames.empty())
+            std::cout << "Resuming from checkpoint, " << m_Frames.size() << " frames recorded\n";
+
+        return;
+    }
+
+    m_File.open(path, std::ios::trunc);
+
+    std::ostringstream header;
+    header << JournalMagic << ' ' << JournalVersion << ' ' << std::hex << config_hash;
+
+    Append(header.str());
+}
+
+bool Checkpoint::Journal::IsFrameDone(uint32_t frame, const fs::path& output) const
+{
+    const auto it = m_Frames.find(frame);
+
+    if (it == m_Frames.end())
+        return false;
+
+    std::error_code ec;
+    const uintmax_t size = fs::file_size(output, ec);
+
+    if (ec || size != it->second.Size)
+        return false;
+
+    const uint64_t hash = HashFile(output, ec);
+
+    return !ec && hash == it->second.Hash;
+}
+
+void Checkpoint::Journal::MarkFrameDone(uint32_t frame, const fs::path& output)
+{
+    std::error_code ec;
+    const uintmax_t size = fs::file_size(output, ec);
+
+    const uint64_t hash = ec ? 0 : HashFile(output, ec);
+
+    //Output that failed to write is not worth recording
+    if (ec)
+        return;
+
+    std::ostringstream line;
+    line << "frame " << frame << ' ' << size << ' ' << std::hex << hash;
+
+    Append(line.str());
+
+    std::lock_guard lock(m_Mutex);
+    m_Frames[frame] = FrameRecord{size, hash};
+}
+
+std::optional<Image::StreamState> Checkpoint::Journal::GetBandState(uint32_t frame, const Image::ImageInfo& info,
+                                                                    Image::StreamFormat format,
+                                                                    size_t band_height, size_t tile_size) const
+{
+    const auto it = m_Bands.find(frame);
+
+    if (it == m_Bands.end())
+        return std::nullopt;
+
+    const BandRecord& record = it->second;
+
+    //Rendering resumes at band RowsWritten / band_height, which only lines up
+    //with the written rows if bands are cut the same way as before
+    if (record.BandHeight != band_height || record.TileSize != tile_size || record.State.Rows % band_height != 0)
+    {
+        std::cout << "Bands of frame " << frame << " do not line up with the current band height or tile size, starting over\n";
+        return std::nullopt;
+    }
+
+    //Partial file may have been corrupted or replaced by another run since
+    if (!Image::StreamWriter::Verify(info, format, record.State))
+    {
+        std::cout << "Partial image of frame " << frame << " does not match its checkpoint, starting over\n";
+        return std::nullopt;
+    }
+
+    return record.State;
+}
+
+void Checkpoint::Journal::MarkBandDone(uint32_t frame, const Image::StreamState& state, size_t band_height, size_t tile_size)
+{
+    Append("band " + std::to_string(frame) + " " + std::to_string(band_height) + " " + std::to_string(tile_size)
+         + " " + std::to_string(state.Offset) + " " + std::to_string(state.Rows)
+         + " " + std::to_string(state.AdlerA) + " " + std::to_string(state.AdlerB));
+
+    std::lock_guard lock(m_Mutex);
+    m_Bands[frame] = BandRecord{band_height, tile_size, state};
+}
+
+void Checkpoint::Journal::Append(const std::string& line)
+{
+    std::lock_guard lock(m_Mutex);
+
+    //Flushed right away, every line is a point the run can restart from
+    m_File << line << '\n';
+    m_File.flush();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <filesystem>
+#include <string_view>
+
+#include "ImageStream.h"
+
+//Progress record of a long render, so that a restarted run skips finished work
+//Journal is a text file of appended lines, a line cut short by a crash is ignored:
+//  CFCHECKPOINT <version> <config hash>
+//  frame <index> <output size> <output hash>
+//  band <index> <band height> <tile size> <offset> <rows> <adler a> <adler b>
+//Outputs themselves are written atomically (see Image::SaveImage and StreamWriter),
+//so a recorded frame always refers to a complete file
+namespace Checkpoint {
+
+    //FNV-1a, identifies the configuration a journal belongs to
+    uint64_t Hash(std::string_view text, uint64_t seed = 0xcbf29ce484222325ull);
+
+    class Journal{
+    public:
+        //Journal of a different configuration is discarded
+        Journal(const std::filesystem::path& path, uint64_t config_hash);
+
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        //Frame counts as done only if its output still exists with the recorded size and content hash
+        bool IsFrameDone(uint32_t frame, const std::filesystem::path& output) const;
+        void MarkFrameDone(uint32_t frame, const std::filesystem::path& output);
+
+        //State of a partially streamed frame, if its partial file still holds exactly that data
+        //(checked against the recorded checksum) and it was written in whole bands of the same height,
+        //cut from tiles of the same size
+        std::optional<Image::StreamState> GetBandState(uint32_t frame, const Image::ImageInfo& info, Image::StreamFormat format,
+                                                       size_t band_height, size_t tile_size) const;
+        void MarkBandDone(uint32_t frame, const Image::StreamState& state, size_t band_height, size_t tile_size);
+
+        size_t NumFramesDone() const {return m_Frames.size();}
+
+    private:
+        void Append(const std::string& line);
+
+    private:
+        struct FrameRecord{
+            uintmax_t Size;
+            uint64_t Hash;
+        };
+
+        struct BandRecord{
+            size_t BandHeight;
+            size_t TileSize;
+            Image::StreamState State;
+        };
+
+        std::map<uint32_t, FrameRecord> m_Frames;
+        std::map<uint32_t, BandRecord> m_Bands;
+
+        std::mutex m_Mutex;
+        std::ofstream m_File;
+    };
+}
@@ -2,24 +2,54 @@
 
 #include "SmoothIter.h"
 #include "Gradient.h"
+#include "Formula.h"
 
 #include <map>
 
-GenFunction GetGeneratingFunction(FractalGenerator g)
+GenFunction GetGeneratingFunction(FractalGenerator g, FormulaParams params)
 {
     using namespace ComputeFractal;
+    using namespace ComputeFractal::Formula;
 
-    auto ReturnZero = [](float, float){return 0.0f;};
-    auto DoNothingSSE = [](float*, __m128, __m128){};
-    auto DoNothingAVX = [](float*, __m256, __m256){};
+    auto ReturnZero = [](float, float, const FormulaParams&){return 0.0f;};
+    auto DoNothingSSE = [](float*, __m128, __m128, const FormulaParams&){};
+    auto DoNothingAVX = [](float*, __m256, __m256, const FormulaParams&){};
 
     const std::map<FractalGenerator, GenFunction> gen_functions{
-        {FractalGenerator::None,       {ReturnZero, DoNothingSSE, DoNothingAVX}},
-        {FractalGenerator::SmoothIter, {SmoothIter, SmoothIterSSE, SmoothIterAVX}},
-        {FractalGenerator::Gradient,   {Gradient,   GradientSSE,   GradientAVX}},
+        {FractalGenerator::None,       {ReturnZero, DoNothingSSE, DoNothingAVX, {}}},
+        {FractalGenerator::SmoothIter, {SmoothIter, SmoothIterSSE, SmoothIterAVX, {}}},
+        {FractalGenerator::Gradient,   {Gradient,   GradientSSE,   GradientAVX,   {}}},
+
+        {FractalGenerator::BurningShip, MakeGenFunction<BurningShip>()},
+        {FractalGenerator::Tricorn,     MakeGenFunction<Tricorn>()},
+        {FractalGenerator::Multibrot3,  MakeGenFunction<Multibrot<3>>()},
+        {FractalGenerator::Multibrot4,  MakeGenFunction<Multibrot<4>>()},
+        {FractalGenerator::Julia,       MakeGenFunction<Julia<Multibrot<2>>>()},
     };
 
-    return gen_functions.at(g);
+    GenFunction res = gen_functions.at(g);
+    res.Params = params;
+
+    return res;
+}
+
+QuantizationRange GetValueRange(FractalGenerator g)
+{
+    //Smooth iteration count lies in [0, iter_max] up to the smoothing term,
+    //gradient is clamped to [0, 1] with -1 marking interior points
+    const std::map<FractalGenerator, QuantizationRange> ranges{
+        {FractalGenerator::None,       {0.0f, 1.0f}},
+        {FractalGenerator::SmoothIter, {-8.0f, 408.0f}},
+        {FractalGenerator::Gradient,   {-1.0f, 1.0f}},
+
+        {FractalGenerator::BurningShip, {-8.0f, 408.0f}},
+        {FractalGenerator::Tricorn,     {-8.0f, 408.0f}},
+        {FractalGenerator::Multibrot3,  {-8.0f, 408.0f}},
+        {FractalGenerator::Multibrot4,  {-8.0f, 408.0f}},
+        {FractalGenerator::Julia,       {-8.0f, 408.0f}},
+    };
+
+    return ranges.at(g);
 }
 
 
@@ -1,23 +1,60 @@
 #pragma once
 
+#include <cstdint>
+
 #include <xmmintrin.h>
 #include <smmintrin.h>
 #include <immintrin.h>
 
+#include "DataFormat.h"
+
+//Maximal number of iterations performed by all generators
+constexpr uint32_t IterationBudget = 400;
+
+//Version of the values produced by the kernels, stored with persisted output (tile cache, data dumps)
+//Bump whenever a change alters the output of any kernel, so stale results are not reused
+constexpr uint32_t KernelVersion = 3;
+
 enum class FractalGenerator{
     None,
     SmoothIter,
-    Gradient
+    Gradient,
+    //Generated by the formula engine (see Formula.h), smoothed iteration count like SmoothIter
+    BurningShip,
+    Tricorn,
+    Multibrot3,
+    Multibrot4,
+    Julia
 };
 
-typedef float (*ScalarFunction)(float, float);
-typedef void (*SSEFunction)(float*, __m128, __m128);
-typedef void (*AVXFunction)(float*, __m256, __m256);
+//Per-render inputs of the generators, passed to every kernel call
+//Generators with a fixed formula ignore them
+struct FormulaParams{
+    //Constant c of the Julia generator
+    float JuliaRe = -0.8f;
+    float JuliaIm = 0.156f;
+};
+
+typedef float (*ScalarFunction)(float, float, const FormulaParams&);
+typedef void (*SSEFunction)(float*, __m128, __m128, const FormulaParams&);
+typedef void (*AVXFunction)(float*, __m256, __m256, const FormulaParams&);
 
 struct GenFunction{
     ScalarFunction Scalar;
     SSEFunction SSE;
     AVXFunction AVX;
+
+    FormulaParams Params;
 };
 
-GenFunction GetGeneratingFunction(FractalGenerator g);
\ No newline at end of file
+GenFunction GetGeneratingFunction(FractalGenerator g, FormulaParams params = {});
+
+namespace ComputeFractal{
+    //Running total of iterations executed by kernels on this thread
+    //Vector kernels count an iteration once for all their lanes,
+    //since lanes keep iterating until the last of them bails out
+    inline thread_local uint64_t ExecutedIterations = 0;
+}
+
+//Range of values produced by given generator, used for quantized storage
+QuantizationRange GetValueRange(FractalGenerator g);
\ No newline at end of file
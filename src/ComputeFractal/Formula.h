@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "ComplexArithmetic.h"
+#include "ComputeFractal.h"
+
+//Escape time kernels generated from a formula written once against Complex<T>
+//A formula is a type with:
+//  static constexpr float Degree  - growth of |z| per iteration near infinity, for smoothing
+//  static constexpr bool IsJulia  - pixel is the starting z instead of c
+//  static Complex<T> Step(Complex<T> z, Complex<T> c) - one iteration, for any SimdType T
+//Julia formulas take the constant c from the FormulaParams of the render
+//Kernels return the smoothed iteration count, the same quantity SmoothIter does
+namespace ComputeFractal::Formula {
+
+    //z^D by repeated squaring, unrolled at compile time
+    template<uint32_t D, SimdType T>
+    Complex<T> Power(Complex<T> z)
+    {
+        static_assert(D >= 1);
+
+        if constexpr (D == 1)
+            return z;
+        else if constexpr (D % 2 == 0)
+        {
+            Complex<T> half = Power<D / 2>(z);
+            return half * half;
+        }
+        else
+            return Power<D - 1>(z) * z;
+    }
+
+    //z^D + c
+    template<uint32_t D>
+    struct Multibrot{
+        static constexpr float Degree = static_cast<float>(D);
+        static constexpr bool IsJulia = false;
+
+        template<SimdType T>
+        static Complex<T> Step(Complex<T> z, Complex<T> c)
+        {
+            return Power<D>(z) + c;
+        }
+    };
+
+    //(|Re z| + i|Im z|)^2 + c
+    struct BurningShip{
+        static constexpr float Degree = 2.0f;
+        static constexpr bool IsJulia = false;
+
+        template<SimdType T>
+        static Complex<T> Step(Complex<T> z, Complex<T> c)
+        {
+            Complex<T> a(SimdFloat<T>::abs(z.Re), SimdFloat<T>::abs(z.Im));
+            return a * a + c;
+        }
+    };
+
+    //conj(z)^2 + c
+    struct Tricorn{
+        static constexpr float Degree = 2.0f;
+        static constexpr bool IsJulia = false;
+
+        template<SimdType T>
+        static Complex<T> Step(Complex<T> z, Complex<T> c)
+        {
+            Complex<T> conj(z.Re, -1.0f * z.Im);
+            return conj * conj + c;
+        }
+    };
+
+    //Julia set of any of the above, for the constant FormulaParams::JuliaRe + i*JuliaIm
+    template<typename Base>
+    struct Julia : Base{
+        static constexpr bool IsJulia = true;
+    };
+
+    constexpr float Bailout = 100.0f;
+
+    //Smoothing term subtracted from the iteration count, given |z|^2 after bailout
+    template<typename F>
+    float Smoothing(float len2)
+    {
+        const float inv_log_bail = 1.0f / std::log(Bailout);
+        const float inv_log_deg = 1.0f / std::log(F::Degree);
+
+        return inv_log_deg * std::log(0.5f * inv_log_bail * std::log(len2));
+    }
+
+    template<typename F>
+    float EscapeTime(float x, float y, [[maybe_unused]] const FormulaParams& params)
+    {
+        using complex = Complex<SimdType::Scalar>;
+
+        const complex pixel(x, y);
+
+        complex z = pixel;
+        complex c = pixel;
+
+        if constexpr (F::IsJulia)
+            c = complex(params.JuliaRe, params.JuliaIm);
+        else
+            z = complex(0.0f, 0.0f);
+
+        float len2 = 0.0f;
+        float iterations = 0.0f;
+
+        size_t k = 0;
+
+        for (; k < IterationBudget; k++)
+        {
+            z = F::Step(z, c);
+
+            len2 = complex::Len2(z).Value;
+
+            if (len2 > Bailout*Bailout) break;
+
+            iterations += 1.0f;
+        }
+
+        ExecutedIterations += std::min<size_t>(k + 1, IterationBudget);
+
+        return iterations - Smoothing<F>(len2);
+    }
+
+    //Lanes keep iterating until all of them bail out,
+    //iteration count and |z|^2 of every lane are frozen at its own bailout
+    template<typename F, SimdType T>
+    void EscapeTime(float* mem_address, typename SimdFloat<T>::ValueType x, typename SimdFloat<T>::ValueType y,
+                    [[maybe_unused]] const FormulaParams& params)
+    {
+        using complex = Complex<T>;
+        using value = SimdFloat<T>;
+        using mask = typename value::ValueType;
+
+        constexpr size_t lanes = sizeof(mask) / sizeof(float);
+
+        const complex pixel(x, y);
+
+        complex z = pixel;
+        complex c = pixel;
+
+        if constexpr (F::IsJulia)
+            c = complex(params.JuliaRe, params.JuliaIm);
+        else
+            z = complex(0.0f, 0.0f);
+
+        value one, bail2, iter, final_len2;
+        one = 1.0f;
+        bail2 = Bailout*Bailout;
+        iter = 0.0f;
+        final_len2 = 0.0f;
+
+        //Lanes that already bailed out, none at first
+        mask condition{};
+
+        size_t k = 0;
+
+        for (; k < IterationBudget; k++)
+        {
+            z = F::Step(z, c);
+
+            const value len2 = complex::Len2(z);
+
+            final_len2 = value::blend(len2, final_len2, condition);
+
+            condition = value::mask_or(condition, value::greater(len2, bail2));
+
+            iter = iter + value::and_not(condition, one);
+
+            if (value::all(condition))
+                break;
+        }
+
+        ExecutedIterations += std::min<size_t>(k + 1, IterationBudget);
+
+        std::array<float, lanes> moduli;
+
+        if constexpr (T == SimdType::SSE)
+        {
+            _mm_store_ps(mem_address, iter.Value);
+            _mm_storeu_ps(moduli.data(), final_len2.Value);
+        }
+
+        else
+        {
+            _mm256_store_ps(mem_address, iter.Value);
+            _mm256_storeu_ps(moduli.data(), final_len2.Value);
+        }
+
+        for (size_t i = 0; i < lanes; i++)
+            mem_address[i] -= Smoothing<F>(moduli[i]);
+    }
+
+    //Kernels of formula F for every SimdType
+    template<typename F>
+    GenFunction MakeGenFunction()
+    {
+        return GenFunction{
+            EscapeTime<F>,
+            EscapeTime<F, SimdType::SSE>,
+            EscapeTime<F, SimdType::AVX>,
+            {}
+        };
+    }
+}
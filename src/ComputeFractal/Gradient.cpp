@@ -1,15 +1,17 @@
 #include "Gradient.h"
 
 #include <cmath>
+#include <algorithm>
 
 #include "ComplexArithmetic.h"
+#include "ComputeFractal.h"
 
-float ComputeFractal::Gradient(float x, float y)
+float ComputeFractal::Gradient(float x, float y, const FormulaParams&)
 {
     using enum SimdType;
 	using complex = Complex<Scalar>;
 
-    constexpr size_t iter_max = 400;
+    constexpr size_t iter_max = IterationBudget;
     constexpr float bailout = 100.0f;
     constexpr float light_height = 1.5f;
 
@@ -21,7 +23,9 @@ float ComputeFractal::Gradient(float x, float y)
 
     bool not_enough_iterations = true;
 
-	for (size_t k = 0; k < iter_max; k++)
+	size_t k = 0;
+
+	for (; k < iter_max; k++)
 	{
         const complex new_z = z*z + c;
         dz = 2.0f * z * dz + 1.0f;
@@ -36,6 +40,8 @@ float ComputeFractal::Gradient(float x, float y)
         }
 	}
 
+	ExecutedIterations += std::min(k + 1, iter_max);
+
     if (not_enough_iterations)
         return -1.0f;
 
@@ -47,12 +53,12 @@ float ComputeFractal::Gradient(float x, float y)
     return std::max(0.0f, std::min(dot/(1.0f + light_height), 1.0f));
 }
 
-void ComputeFractal::GradientSSE(float* mem_address, __m128 x, __m128 y)
+void ComputeFractal::GradientSSE(float* mem_address, __m128 x, __m128 y, const FormulaParams&)
 {
     using enum SimdType;
 	using complex = Complex<SSE>;
 
-    constexpr size_t iter_max = 400;
+    constexpr size_t iter_max = IterationBudget;
     constexpr float bailout = 100.0f;
     constexpr float light_height = 1.5f;
 
@@ -73,7 +79,9 @@ void ComputeFractal::GradientSSE(float* mem_address, __m128 x, __m128 y)
 	const __m128 bail2 = _mm_set1_ps(bailout*bailout);
     const __m128 lheight = _mm_set1_ps(light_height);
 
-	for (size_t k = 0; k < iter_max; k++)
+	size_t k = 0;
+
+	for (; k < iter_max; k++)
 	{
         const complex new_z = z*z + c;
         dz = 2.0f * z * dz + 1.0f;
@@ -91,6 +99,8 @@ void ComputeFractal::GradientSSE(float* mem_address, __m128 x, __m128 y)
 			break;
 	}
 
+	ExecutedIterations += std::min(k + 1, iter_max);
+
     complex u = final_z/final_dz;
     u /= complex::Len(u);
 
@@ -103,12 +113,12 @@ void ComputeFractal::GradientSSE(float* mem_address, __m128 x, __m128 y)
 	_mm_store_ps(mem_address, res);
 }
 
-void ComputeFractal::GradientAVX(float* mem_address, __m256 x, __m256 y)
+void ComputeFractal::GradientAVX(float* mem_address, __m256 x, __m256 y, const FormulaParams&)
 {
     using enum SimdType;
 	using complex = Complex<AVX>;
 
-    constexpr size_t iter_max = 400;
+    constexpr size_t iter_max = IterationBudget;
     constexpr float bailout = 100.0f;
     constexpr float light_height = 1.5f;
 
@@ -129,7 +139,9 @@ void ComputeFractal::GradientAVX(float* mem_address, __m256 x, __m256 y)
 	const __m256 bail2 = _mm256_set1_ps(bailout*bailout);
     const __m256 lheight = _mm256_set1_ps(light_height);
 
-	for (size_t k = 0; k < iter_max; k++)
+	size_t k = 0;
+
+	for (; k < iter_max; k++)
 	{
         const complex new_z = z*z + c;
         dz = 2.0f * z * dz + 1.0f;
@@ -143,10 +155,12 @@ void ComputeFractal::GradientAVX(float* mem_address, __m256 x, __m256 y)
 			
 		condition = _mm256_or_ps(condition, _mm256_cmp_ps(len2, bail2, _CMP_GT_OS));
 
-		if (_mm256_movemask_ps(condition) == 0x0f)
+		if (_mm256_movemask_ps(condition) == 0xff)
 			break;
 	}
 
+	ExecutedIterations += std::min(k + 1, iter_max);
+
     complex u = final_z/final_dz;
     u /= complex::Len(u);
 
@@ -41,6 +41,11 @@ struct SimdFloat<SimdType::Scalar>{
     {
         return SimdFloat<SimdType::Scalar>{std::sqrt(x.Value)};
     }
+
+    static SimdFloat<SimdType::Scalar> abs(SimdFloat<SimdType::Scalar> x)
+    {
+        return SimdFloat<SimdType::Scalar>{std::fabs(x.Value)};
+    }
 };
 
 inline SimdFloat<SimdType::Scalar> operator+(float x, const SimdFloat<SimdType::Scalar>& X)
@@ -109,6 +114,37 @@ struct SimdFloat<SimdType::SSE>{
             _mm_blendv_ps(x.Value, y.Value, condition)
         };
     }
+
+    static SimdFloat<SSE> abs(SimdFloat<SSE> x)
+    {
+        return SimdFloat<SSE>{
+            _mm_andnot_ps(_mm_set1_ps(-0.0f), x.Value)
+        };
+    }
+
+    //Lane masks, all bits set where the condition holds
+    static ValueType greater(SimdFloat<SSE> x, SimdFloat<SSE> y)
+    {
+        return _mm_cmpgt_ps(x.Value, y.Value);
+    }
+
+    static ValueType mask_or(ValueType x, ValueType y)
+    {
+        return _mm_or_ps(x, y);
+    }
+
+    //x in lanes where mask is not set, zero elsewhere
+    static SimdFloat<SSE> and_not(ValueType mask, SimdFloat<SSE> x)
+    {
+        return SimdFloat<SSE>{
+            _mm_andnot_ps(mask, x.Value)
+        };
+    }
+
+    static bool all(ValueType mask)
+    {
+        return _mm_movemask_ps(mask) == 0x0f;
+    }
 };
 
 inline SimdFloat<SimdType::SSE> operator*(const SimdFloat<SimdType::SSE>& lhs, const SimdFloat<SimdType::SSE>& rhs)
@@ -185,6 +221,37 @@ struct SimdFloat<SimdType::AVX>{
             _mm256_blendv_ps(x.Value, y.Value, condition)
         };
     }
+
+    static SimdFloat<AVX> abs(SimdFloat<AVX> x)
+    {
+        return SimdFloat<AVX>{
+            _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.Value)
+        };
+    }
+
+    //Lane masks, all bits set where the condition holds
+    static ValueType greater(SimdFloat<AVX> x, SimdFloat<AVX> y)
+    {
+        return _mm256_cmp_ps(x.Value, y.Value, _CMP_GT_OS);
+    }
+
+    static ValueType mask_or(ValueType x, ValueType y)
+    {
+        return _mm256_or_ps(x, y);
+    }
+
+    //x in lanes where mask is not set, zero elsewhere
+    static SimdFloat<AVX> and_not(ValueType mask, SimdFloat<AVX> x)
+    {
+        return SimdFloat<AVX>{
+            _mm256_andnot_ps(mask, x.Value)
+        };
+    }
+
+    static bool all(ValueType mask)
+    {
+        return _mm256_movemask_ps(mask) == 0xff;
+    }
 };
 
 inline SimdFloat<SimdType::AVX> operator*(const SimdFloat<SimdType::AVX>& lhs, const SimdFloat<SimdType::AVX>& rhs)
@@ -1,16 +1,18 @@
 #include "SmoothIter.h"
 
 #include <cmath>
+#include <algorithm>
 #include <array>
 
 #include "ComplexArithmetic.h"
+#include "ComputeFractal.h"
 
-float ComputeFractal::SmoothIter(float x, float y)
+float ComputeFractal::SmoothIter(float x, float y, const FormulaParams&)
 {
 	using enum SimdType;
 	using complex = Complex<Scalar>;
 
-    constexpr size_t iter_max = 400;
+    constexpr size_t iter_max = IterationBudget;
     constexpr float bailout = 8.0f;
 
 	const complex c(x, y);
@@ -20,7 +22,9 @@ float ComputeFractal::SmoothIter(float x, float y)
 	float len2 = 0.0f;
 	float iterations = 0.0f;
 
-	for (size_t k = 0; k < iter_max; k++)
+	size_t k = 0;
+
+	for (; k < iter_max; k++)
 	{
 		z = z*z + c;
 
@@ -31,6 +35,8 @@ float ComputeFractal::SmoothIter(float x, float y)
 		iterations += 1.0f;
 	}
 
+	ExecutedIterations += std::min(k + 1, iter_max);
+
 	constexpr float deg = 2.0f;
 	const float inv_log_bail = 1.0f / std::log(bailout);
 	const float sm_inv_denom = 1.0f / std::log(deg);
@@ -41,12 +47,12 @@ float ComputeFractal::SmoothIter(float x, float y)
 	return iterations - smoothing;
 }
 
-void ComputeFractal::SmoothIterSSE(float* mem_address, __m128  x, __m128 y)
+void ComputeFractal::SmoothIterSSE(float* mem_address, __m128  x, __m128 y, const FormulaParams&)
 {
 	using enum SimdType;
 	using complex = Complex<SSE>;
 
-    constexpr size_t iter_max = 400;
+    constexpr size_t iter_max = IterationBudget;
     constexpr float bailout = 100.0f;
 
 	const complex c(x, y);
@@ -64,7 +70,9 @@ void ComputeFractal::SmoothIterSSE(float* mem_address, __m128  x, __m128 y)
 	const __m128 one = _mm_set1_ps(1.0f);
 	const __m128 bail2 = _mm_set1_ps(bailout*bailout);
 
-	for (size_t k = 0; k < iter_max; k++)
+	size_t k = 0;
+
+	for (; k < iter_max; k++)
 	{
 		z = z*z + c;
 
@@ -80,6 +88,8 @@ void ComputeFractal::SmoothIterSSE(float* mem_address, __m128  x, __m128 y)
 		if (_mm_movemask_ps(condition) == 0x0f)
 			break;
 	}
+
+	ExecutedIterations += std::min(k + 1, iter_max);
 	
 	//Save result
 	_mm_store_ps(mem_address, iter);
@@ -101,12 +111,12 @@ void ComputeFractal::SmoothIterSSE(float* mem_address, __m128  x, __m128 y)
 	}
 }
 
-void ComputeFractal::SmoothIterAVX(float* mem_address, __m256  x, __m256 y)
+void ComputeFractal::SmoothIterAVX(float* mem_address, __m256  x, __m256 y, const FormulaParams&)
 {
 	using enum SimdType;
 	using complex = Complex<AVX>;
 
-    constexpr size_t iter_max = 400;
+    constexpr size_t iter_max = IterationBudget;
     constexpr float bailout = 100.0f;
 
 	const complex c(x, y);
@@ -124,7 +134,9 @@ void ComputeFractal::SmoothIterAVX(float* mem_address, __m256  x, __m256 y)
 	const __m256 one = _mm256_set1_ps(1.0f);
 	const __m256 bail2 = _mm256_set1_ps(bailout*bailout);
 
-	for (size_t k = 0; k < iter_max; k++)
+	size_t k = 0;
+
+	for (; k < iter_max; k++)
 	{
 		z = z*z + c;
 
@@ -137,9 +149,11 @@ void ComputeFractal::SmoothIterAVX(float* mem_address, __m256  x, __m256 y)
 
 		iter = _mm256_add_ps(iter, _mm256_andnot_ps(condition, one));
 
-		if (_mm256_movemask_ps(condition) == 0x0f)
+		if (_mm256_movemask_ps(condition) == 0xff)
 			break;
 	}
+
+	ExecutedIterations += std::min(k + 1, iter_max);
 	
 	//Save result
 	_mm256_store_ps(mem_address, iter);
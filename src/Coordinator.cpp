@@ -0,0 +1,387 @@
+#include "Coordinator.h"
+
+#include "Net.h"
+#include "Image.h"
+#include "ParseInput.h"
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <optional>
+#include <condition_variable>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+struct Chunk{
+    uint32_t First;
+    uint32_t Count;
+};
+
+struct WorkerStats{
+    uint32_t Frames = 0;
+    //Sum of job times reported by the worker
+    double ComputeMs = 0.0;
+    //Jobs the worker runs concurrently
+    size_t Jobs = 1;
+    uint32_t Losses = 0;
+    bool GivenUp = false;
+};
+
+//Chunks not yet assigned to any worker
+class Dispatcher{
+public:
+    Dispatcher(uint32_t num_frames, uint32_t frames_per_chunk)
+        : m_Remaining(num_frames)
+    {
+        for (uint32_t first = 0; first < num_frames; first += frames_per_chunk)
+            m_Pending.push_back(Chunk{first, std::min(frames_per_chunk, num_frames - first)});
+    }
+
+    std::optional<Chunk> TryTake()
+    {
+        std::lock_guard lock(m_Mutex);
+        return PopFront();
+    }
+
+    //Blocks until a chunk is available, returns nullopt once all frames are done
+    //Workers without chunks wait here, since chunks of lost workers may still come back
+    std::optional<Chunk> WaitTake()
+    {
+        std::unique_lock lock(m_Mutex);
+        m_Changed.wait(lock, [&]{return !m_Pending.empty() || IsFinished();});
+
+        return PopFront();
+    }
+
+    //Puts back frames a lost worker did not deliver, they are handed out first
+    void Return(Chunk chunk)
+    {
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Pending.push_front(chunk);
+        }
+
+        m_Changed.notify_one();
+    }
+
+    void FrameDone()
+    {
+        bool finished;
+
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Remaining--;
+            finished = IsFinished();
+        }
+
+        if (finished)
+            m_Changed.notify_all();
+    }
+
+    void Fail(const std::string& message)
+    {
+        {
+            std::lock_guard lock(m_Mutex);
+
+            if (!m_Error.has_value())
+                m_Error = message;
+        }
+
+        m_Changed.notify_all();
+    }
+
+    bool Finished()
+    {
+        std::lock_guard lock(m_Mutex);
+        return IsFinished();
+    }
+
+    uint32_t Remaining()
+    {
+        std::lock_guard lock(m_Mutex);
+        return m_Remaining;
+    }
+
+    std::optional<std::string> Error()
+    {
+        std::lock_guard lock(m_Mutex);
+        return m_Error;
+    }
+
+private:
+    bool IsFinished() const {return m_Remaining == 0 || m_Error.has_value();}
+
+    std::optional<Chunk> PopFront()
+    {
+        if (m_Pending.empty() || IsFinished())
+            return std::nullopt;
+
+        const Chunk chunk = m_Pending.front();
+        m_Pending.pop_front();
+
+        return chunk;
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Changed;
+
+    std::deque<Chunk> m_Pending;
+    uint32_t m_Remaining;
+    std::optional<std::string> m_Error;
+};
+
+struct InFlight{
+    Chunk Assigned;
+    uint32_t Received = 0;
+};
+
+//Dispatches chunks over one connection until all frames are done
+//Returns false if the connection was lost, unfinished frames are returned to the dispatcher
+static bool DriveConnection(Net::Connection& conn, const std::string& address, const json& config,
+                            Dispatcher& dispatcher, WorkerStats& stats, uint32_t& failures)
+{
+    std::map<uint32_t, InFlight> in_flight;
+
+    auto Lost = [&]()
+    {
+        for (const auto& [id, job] : in_flight)
+        {
+            if (job.Received < job.Assigned.Count)
+                dispatcher.Return(Chunk{job.Assigned.First + job.Received, job.Assigned.Count - job.Received});
+        }
+
+        return false;
+    };
+
+    std::string line;
+
+    if (!conn.Send(json{{"Info", true}}.dump()) || !conn.ReadLine(line))
+        return Lost();
+
+    const json info = json::parse(line, nullptr, false);
+
+    stats.Jobs = info.is_object() ? std::max<size_t>(1, info.value("Jobs", size_t(1))) : 1;
+
+    //One more than the worker runs, so that it never idles waiting for the next request
+    const size_t max_in_flight = stats.Jobs + 1;
+
+    const uint32_t width = config["Image Width"];
+    const uint32_t height = config["Image Height"];
+
+    std::vector<Image::Pixel> image(size_t(width) * size_t(height));
+
+    while (true)
+    {
+        while (in_flight.size() < max_in_flight)
+        {
+            const auto chunk = in_flight.empty() ? dispatcher.WaitTake() : dispatcher.TryTake();
+
+            if (!chunk.has_value())
+                break;
+
+            json job = config;
+            job["Id"] = chunk->First;
+            job["Output"] = "Raw";
+            job["First Frame"] = chunk->First;
+            job["Num Frames"] = chunk->Count;
+
+            in_flight[chunk->First] = InFlight{chunk.value()};
+
+            if (!conn.Send(job.dump()))
+                return Lost();
+        }
+
+        if (in_flight.empty())
+            return true;
+
+        if (!conn.ReadLine(line))
+            return Lost();
+
+        const json response = json::parse(line, nullptr, false);
+
+        if (!response.is_object() || !response.contains("Id") || !response["Id"].is_number()
+            || !in_flight.contains(response["Id"].get<uint32_t>()))
+        {
+            dispatcher.Fail(address + ": unexpected response " + line);
+            return Lost();
+        }
+
+        InFlight& job = in_flight[response["Id"].get<uint32_t>()];
+
+        if (response.contains("Bytes"))
+        {
+            if (response.value("Bytes", size_t(0)) != image.size() * sizeof(Image::Pixel))
+            {
+                dispatcher.Fail(address + ": frame of unexpected size");
+                return Lost();
+            }
+
+            if (!conn.ReadExact(image.data(), image.size() * sizeof(Image::Pixel)))
+                return Lost();
+
+            const uint32_t frame = response.value("Frame", job.Assigned.First + job.Received);
+
+            const Image::ImageInfo info{
+                .Width  = width,
+                .Height = height,
+                .Name   = std::to_string(frame) + ".png"
+            };
+
+            Image::SaveImage(image, info);
+
+            job.Received++;
+            stats.Frames++;
+
+            dispatcher.FrameDone();
+        }
+
+        else if (response.value("Status", "") == "Done")
+        {
+            stats.ComputeMs += response.value("Milliseconds", 0.0);
+            in_flight.erase(job.Assigned.First);
+
+            //Worker is healthy again
+            failures = 0;
+        }
+
+        //Errors concern the config itself, so other workers would fail as well
+        else
+        {
+            dispatcher.Fail(address + ": " + response.value("Message", line));
+            return Lost();
+        }
+    }
+}
+
+static void DriveWorker(const std::string& address, const json& config, uint32_t max_reconnects,
+                        std::chrono::milliseconds timeout, Dispatcher& dispatcher, WorkerStats& stats)
+{
+    uint32_t failures = 0;
+
+    while (!dispatcher.Finished())
+    {
+        const int fd = Net::Connect(address);
+
+        if (fd >= 0)
+        {
+            Net::Connection conn(fd, fd, true);
+
+            //Hung worker is handled like a disconnected one, its chunks go back to the dispatcher
+            conn.SetReceiveTimeout(timeout);
+
+            //Connection also ends when another worker reported an error
+            if (DriveConnection(conn, address, config, dispatcher, stats, failures) || dispatcher.Finished())
+                return;
+
+            stats.Losses++;
+
+            if (conn.TimedOut())
+                std::cerr << "Lost worker " << address << ", no response within " << timeout.count() << "[ms]\n";
+            else
+                std::cerr << "Lost worker " << address << '\n';
+        }
+
+        if (++failures > max_reconnects)
+        {
+            stats.GivenUp = true;
+            std::cerr << "Giving up on worker " << address << '\n';
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(250 * failures));
+    }
+}
+
+int Coordinator::Run(const CoordinatorParams& p)
+{
+    std::ifstream file(p.ConfigFile);
+
+    if (!file)
+    {
+        std::cerr << "Failed to open file " << p.ConfigFile << '\n';
+        return -1;
+    }
+
+    std::stringstream text;
+    text << file.rdbuf();
+
+    const ProgramArgs args = ParseConfig(text.str());
+
+    if (args.ExitMessage.has_value())
+    {
+        std::cerr << args.ExitMessage.value() << '\n';
+        return -1;
+    }
+
+    const json config = json::parse(text.str());
+
+    const uint32_t frames_per_chunk = std::max<uint32_t>(1, p.FramesPerChunk);
+
+    Dispatcher dispatcher(args.NumFrames, frames_per_chunk);
+
+    const double chunk_megapixels = double(args.Width) * double(args.Height) * frames_per_chunk * 1e-6;
+
+    const auto timeout = p.TimeoutBase + std::chrono::duration_cast<std::chrono::milliseconds>(
+        p.TimeoutPerMegapixel * chunk_megapixels);
+
+    std::vector<WorkerStats> stats(p.Workers.size());
+    std::vector<std::thread> threads;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < p.Workers.size(); i++)
+        threads.push_back(std::thread(DriveWorker, std::cref(p.Workers[i]), std::cref(config),
+                                      p.MaxReconnects, timeout, std::ref(dispatcher), std::ref(stats[i])));
+
+    //Threads of lost workers exit early, the rest finish once all frames are done
+    //If every worker is lost no thread is left to take the remaining frames
+    for (auto& thread : threads)
+        thread.join();
+
+    const std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - start;
+
+    double total_compute = 0.0;
+    size_t total_jobs = 0;
+
+    for (size_t i = 0; i < p.Workers.size(); i++)
+    {
+        const WorkerStats& s = stats[i];
+
+        //Busy fraction of the worker's concurrent job slots over the whole run
+        const double busy = s.ComputeMs / (wall.count() * double(s.Jobs));
+
+        std::cout << "Worker " << p.Workers[i] << ": " << s.Frames << " frames, "
+                  << 1000.0 * double(s.Frames) / wall.count() << " frames/s, "
+                  << 100.0 * busy << "% busy over " << s.Jobs << " concurrent jobs, "
+                  << s.Losses << " connections lost" << (s.GivenUp ? ", given up" : "") << '\n';
+
+        total_compute += s.ComputeMs;
+        total_jobs += s.Jobs;
+    }
+
+    std::cout << "Rendered " << args.NumFrames - dispatcher.Remaining() << " of " << args.NumFrames
+              << " frames in " << wall.count() << " ms, parallel efficiency "
+              << 100.0 * total_compute / (wall.count() * double(std::max<size_t>(1, total_jobs))) << "%\n";
+
+    if (const auto error = dispatcher.Error())
+    {
+        std::cerr << error.value() << '\n';
+        return -1;
+    }
+
+    if (dispatcher.Remaining() > 0)
+    {
+        std::cerr << "All workers lost, " << dispatcher.Remaining() << " frames not rendered\n";
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+//Distributes the frames of a config over render servers (see Server.h) reachable over TCP
+//Frames are handed out in small chunks, so faster workers take more of them, and every
+//worker gets enough chunks in flight to keep all of its concurrent jobs busy
+//Results come back as raw pixels and are saved locally as <frame>.png
+//Frames of a lost worker are put back into the queue and picked up by the others,
+//the lost worker is reconnected to a few times before it is given up
+//A worker that stays silent for longer than the response timeout counts as lost too
+namespace Coordinator {
+
+    struct CoordinatorParams{
+        //Addresses "<host>:<port>"
+        std::vector<std::string> Workers;
+        std::string ConfigFile;
+
+        uint32_t FramesPerChunk = 1;
+        uint32_t MaxReconnects = 3;
+
+        //Longest wait for the next message of a worker, base plus an allowance per megapixel
+        //of a chunk, since a worker may spend a whole chunk before sending anything
+        std::chrono::milliseconds TimeoutBase{10000};
+        std::chrono::milliseconds TimeoutPerMegapixel{10000};
+    };
+
+    //Returns process exit code, prints per worker statistics
+    int Run(const CoordinatorParams& p);
+}
@@ -0,0 +1,176 @@
+#include "DataDump.h"
+
+#include <fstream>
+#include <cstring>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static constexpr char DumpMagic[8] = {'C', 'F', 'D', 'U', 'M', 'P', '\0', '\0'};
+static constexpr uint32_t DumpVersion = 1;
+
+static bool IsKnownFormat(uint32_t format)
+{
+    switch (static_cast<DataFormat>(format))
+    {
+        case DataFormat::Float:
+        case DataFormat::Half:
+        case DataFormat::Quantized:
+            return true;
+    }
+
+    return false;
+}
+
+static size_t BytesPerValue(uint32_t format)
+{
+    return (static_cast<DataFormat>(format) == DataFormat::Float) ? sizeof(float) : sizeof(uint16_t);
+}
+
+DataDump::Header DataDump::MakeHeader(GenData::FrameParams p, FractalGenerator g, DataFormat format)
+{
+    const QuantizationRange range = GetValueRange(g);
+
+    Header header{};
+
+    std::memcpy(header.Magic, DumpMagic, sizeof(DumpMagic));
+
+    header.Version = DumpVersion;
+    header.Width = static_cast<uint32_t>(p.Width);
+    header.Height = static_cast<uint32_t>(p.Height);
+    header.Generator = static_cast<uint32_t>(g);
+    header.IterationBudget = IterationBudget;
+    header.Format = static_cast<uint32_t>(format);
+    header.MinX = p.MinX;
+    header.MaxX = p.MaxX;
+    header.MinY = p.MinY;
+    header.MaxY = p.MaxY;
+    header.RangeMin = range.Min;
+    header.RangeMax = range.Max;
+    header.KernelVersion = KernelVersion;
+
+    return header;
+}
+
+static void SaveBytes(const std::string& path, const DataDump::Header& header, const void* data, size_t bytes)
+{
+    std::ofstream file(path, std::ios::binary);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(static_cast<const char*>(data), bytes);
+}
+
+void DataDump::Save(const std::string& path, const Header& header, std::span<const float> data)
+{
+    SaveBytes(path, header, data.data(), data.size_bytes());
+}
+
+void DataDump::Save(const std::string& path, const Header& header, std::span<const uint16_t> data)
+{
+    SaveBytes(path, header, data.data(), data.size_bytes());
+}
+
+DataDump::MappedFile::MappedFile(const std::string& path)
+{
+#ifdef __unix__
+    const int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        m_Error = "Failed to open file " + path;
+        return;
+    }
+
+    struct stat info;
+    fstat(fd, &info);
+
+    m_Size = static_cast<size_t>(info.st_size);
+
+    if (m_Size >= sizeof(Header))
+    {
+        void* ptr = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (ptr != MAP_FAILED)
+        {
+            //Data is read front to back exactly once
+            madvise(ptr, m_Size, MADV_SEQUENTIAL);
+
+            m_Data = static_cast<const uint8_t*>(ptr);
+            m_Mapped = true;
+        }
+    }
+
+    close(fd);
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file)
+    {
+        m_Error = "Failed to open file " + path;
+        return;
+    }
+
+    m_Size = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    m_Fallback.resize(m_Size);
+    file.read(reinterpret_cast<char*>(m_Fallback.data()), m_Size);
+
+    m_Data = m_Fallback.data();
+#endif
+
+    if (m_Data == nullptr || m_Size < sizeof(Header))
+    {
+        m_Error = "File " + path + " is too small to be a data dump";
+        return;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(m_Data);
+
+    if (std::memcmp(header->Magic, DumpMagic, sizeof(DumpMagic)) != 0 || header->Version != DumpVersion)
+    {
+        m_Error = "File " + path + " is not a data dump";
+        return;
+    }
+
+    if (!IsKnownFormat(header->Format))
+    {
+        m_Error = "File " + path + " has an unknown data format";
+        return;
+    }
+
+    const size_t expected = sizeof(Header)
+        + size_t(header->Width) * size_t(header->Height) * BytesPerValue(header->Format);
+
+    if (m_Size < expected)
+    {
+        m_Error = "File " + path + " is truncated";
+        return;
+    }
+
+    m_Header = header;
+}
+
+DataDump::MappedFile::~MappedFile()
+{
+#ifdef __unix__
+    if (m_Mapped)
+        munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+}
+
+std::span<const float> DataDump::MappedFile::Floats() const
+{
+    const size_t count = size_t(m_Header->Width) * size_t(m_Header->Height);
+    return std::span<const float>(reinterpret_cast<const float*>(m_Data + sizeof(Header)), count);
+}
+
+std::span<const uint16_t> DataDump::MappedFile::Compact() const
+{
+    const size_t count = size_t(m_Header->Width) * size_t(m_Header->Height);
+    return std::span<const uint16_t>(reinterpret_cast<const uint16_t*>(m_Data + sizeof(Header)), count);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "ComputeFractal.h"
+#include "DataFormat.h"
+#include "GenData.h"
+
+//Raw generator output saved to disk, so that frames can be recolored
+//without recomputing them
+//File layout: 64 byte header followed by Width*Height values
+//in the format given by the header, stored in native byte order
+namespace DataDump {
+
+    struct Header{
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t Generator;
+        uint32_t IterationBudget;
+        uint32_t Format;
+        float MinX;
+        float MaxX;
+        float MinY;
+        float MaxY;
+        float RangeMin;
+        float RangeMax;
+        uint32_t KernelVersion;
+        uint32_t Reserved;
+    };
+
+    static_assert(sizeof(Header) == 64, "Header size keeps the data cache line aligned");
+
+    Header MakeHeader(GenData::FrameParams p, FractalGenerator g, DataFormat format);
+
+    void Save(const std::string& path, const Header& header, std::span<const float> data);
+    void Save(const std::string& path, const Header& header, std::span<const uint16_t> data);
+
+    //Read-only memory mapping of a dump file
+    //Falls back to reading the whole file on platforms without mmap
+    class MappedFile{
+    public:
+        MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool IsValid() const {return m_Header != nullptr;}
+        const std::string& Error() const {return m_Error;}
+
+        const Header& GetHeader() const {return *m_Header;}
+
+        std::span<const float> Floats() const;
+        std::span<const uint16_t> Compact() const;
+
+    private:
+        const Header* m_Header = nullptr;
+        const uint8_t* m_Data = nullptr;
+        size_t m_Size = 0;
+
+        bool m_Mapped = false;
+        std::vector<uint8_t> m_Fallback;
+
+        std::string m_Error;
+    };
+}
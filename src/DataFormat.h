@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include <immintrin.h>
+
+//Storage format of the generator output buffer
+//Compact formats halve memory and bandwidth of the intermediate buffer
+//
+//Worst case color error (in 8 bit levels) compared to Float storage:
+//  IterToColorIQ   (SmoothIter, iter <= 400): Half 2.4, Quantized 0.06
+//  ColorHSV        (SmoothIter, iter <= 400): Half 1.0, Quantized 0.03
+//  NormedGrayscale (Gradient, value in [0,1]): Half 0.07, Quantized 0.004
+//Half error grows with magnitude (11 bit mantissa, spacing 0.25 for iter in [256,512)),
+//Quantized error is uniform over the generator value range
+//Truncation to 8 bits can turn any nonzero error into one additional level
+enum class DataFormat{
+    Float,
+    Half,
+    Quantized
+};
+
+//Range of values mapped onto [1, 65535] by quantized storage,
+//code 0 is reserved for NaN, which generators produce for some interior points
+struct QuantizationRange{
+    float Min;
+    float Max;
+};
+
+inline uint16_t EncodeHalf(float value)
+{
+    return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+}
+
+inline float DecodeHalf(uint16_t value)
+{
+    return _cvtsh_ss(value);
+}
+
+inline uint16_t EncodeQuantized(float value, QuantizationRange r)
+{
+    if (std::isnan(value))
+        return 0;
+
+    const float scale = 65534.0f / (r.Max - r.Min);
+    const float q = (value - r.Min) * scale + 1.5f;
+
+    return static_cast<uint16_t>(std::clamp(q, 1.0f, 65535.0f));
+}
+
+inline float DecodeQuantized(uint16_t value, QuantizationRange r)
+{
+    if (value == 0)
+        return std::nanf("");
+
+    const float step = (r.Max - r.Min) / 65534.0f;
+    return r.Min + step * static_cast<float>(value - 1);
+}
@@ -0,0 +1,354 @@
+#include "DataLayout.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include <immintrin.h>
+
+struct TileBounds{
+    size_t X;
+    size_t Y;
+    size_t Width;
+    size_t Height;
+};
+
+static TileBounds GetTile(size_t tile, size_t width, size_t height)
+{
+    const size_t x = (tile % Layout::NumTilesX(width)) * Layout::TileSide;
+    const size_t y = (tile / Layout::NumTilesX(width)) * Layout::TileSide;
+
+    return TileBounds{
+        .X      = x,
+        .Y      = y,
+        .Width  = std::min(Layout::TileSide, width - x),
+        .Height = std::min(Layout::TileSide, height - y)
+    };
+}
+
+static size_t NumTiles(size_t width, size_t height)
+{
+    return Layout::NumTilesX(width) * ((height + Layout::TileSide - 1) / Layout::TileSide);
+}
+
+size_t Layout::BufferSize(DataLayout l, size_t width, size_t height)
+{
+    if (l == DataLayout::RowMajor)
+        return width * height;
+    else
+        return NumTiles(width, height) * TileArea;
+}
+
+void Layout::GenerateFractal(std::span<float> data, DataLayout l, GenFunction f,
+                             GenData::FrameParams p, GenData::ExecutionPolicy e)
+{
+    if (l == DataLayout::RowMajor)
+    {
+        GenData::GenerateFractal(data.first(p.Width * p.Height), f, p, e);
+        return;
+    }
+
+    auto GenerateTiles = [&](size_t start, size_t end)
+    {
+        AlignedVector<float> scratch(TileArea);
+
+        for (size_t t = start; t < end; t++)
+        {
+            const TileBounds b = GetTile(t, p.Width, p.Height);
+
+            const GenData::TileRect rect{
+                .X      = b.X,
+                .Y      = b.Y,
+                .Width  = b.Width,
+                .Height = b.Height
+            };
+
+            float* tile = &data[t * TileArea];
+
+            //Tiles spanning the whole tile width are already in tiled order
+            if (l == DataLayout::Tiled && b.Width == TileSide)
+            {
+                GenData::GenerateTile(tile, f, p, rect, e.Simd);
+                continue;
+            }
+
+            GenData::GenerateTile(scratch.data(), f, p, rect, e.Simd);
+
+            for (size_t j = 0; j < b.Height; j++)
+            {
+                for (size_t i = 0; i < b.Width; i++)
+                {
+                    const size_t local = (l == DataLayout::Tiled) ? j * TileSide + i
+                                       : (MortonSpread[i] | (MortonSpread[j] << 1));
+
+                    tile[local] = scratch[j * b.Width + i];
+                }
+            }
+        }
+    };
+
+    GenData::SplitIntoJobs(NumTiles(p.Width, p.Height), GenerateTiles, e.NumJobs, e.PinThreads);
+}
+
+//Morton tile to row-major, in blocks of 4x2 pixels, which are 8 consecutive values:
+//  x0 y0 | x1 y0 | x0 y1 | x1 y1 | x2 y0 | x3 y0 | x2 y1 | x3 y1
+//Two aligned loads and two shuffles give both rows of the block
+static void DetileMorton(const float* tile, float* dst, size_t stride, const TileBounds& b)
+{
+    for (size_t y = 0; y < b.Height; y += 2)
+    {
+        for (size_t x = 0; x < b.Width; x += 4)
+        {
+            const float* block = tile + (Layout::MortonSpread[x] | (Layout::MortonSpread[y] << 1));
+
+            float* row0 = dst + y * stride + x;
+
+            if (x + 4 <= b.Width && y + 2 <= b.Height)
+            {
+                const __m128 lo = _mm_load_ps(block);
+                const __m128 hi = _mm_load_ps(block + 4);
+
+                _mm_storeu_ps(row0,          _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(1, 0, 1, 0)));
+                _mm_storeu_ps(row0 + stride, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 2, 3, 2)));
+            }
+
+            else
+            {
+                for (size_t dy = 0; dy < 2 && y + dy < b.Height; dy++)
+                    for (size_t dx = 0; dx < 4 && x + dx < b.Width; dx++)
+                        row0[dy * stride + dx] = block[(dx & 1) | (dy << 1) | ((dx >> 1) << 2)];
+            }
+        }
+    }
+}
+
+void Layout::ToRowMajor(std::span<const float> src, DataLayout l, std::span<float> dst,
+                        size_t width, size_t height, std::optional<uint32_t> num_jobs)
+{
+    if (l == DataLayout::RowMajor)
+    {
+        auto CopyRows = [&](size_t start, size_t end)
+        {
+            std::memcpy(&dst[start * width], &src[start * width], (end - start) * width * sizeof(float));
+        };
+
+        GenData::SplitIntoJobs(height, CopyRows, num_jobs);
+        return;
+    }
+
+    auto DetileRange = [&](size_t start, size_t end)
+    {
+        for (size_t t = start; t < end; t++)
+        {
+            const TileBounds b = GetTile(t, width, height);
+
+            const float* tile = &src[t * TileArea];
+            float* out = &dst[b.Y * width + b.X];
+
+            if (l == DataLayout::Tiled)
+            {
+                for (size_t j = 0; j < b.Height; j++)
+                    std::memcpy(out + j * width, tile + j * TileSide, b.Width * sizeof(float));
+            }
+
+            else
+            {
+                DetileMorton(tile, out, width, b);
+            }
+        }
+    };
+
+    GenData::SplitIntoJobs(NumTiles(width, height), DetileRange, num_jobs);
+}
+
+//Index of pixel (i, j) of a tile, relative to the start of the tile
+template<DataLayout L>
+static size_t LocalIndex(size_t i, size_t j)
+{
+    if constexpr (L == DataLayout::Tiled)
+        return j * Layout::TileSide + i;
+    else
+        return Layout::MortonSpread[i] | (Layout::MortonSpread[j] << 1);
+}
+
+static float Variance(const std::array<float, 9>& v)
+{
+    float sum = 0.0f, sum2 = 0.0f;
+
+    for (const float x : v)
+    {
+        sum += x;
+        sum2 += x * x;
+    }
+
+    const float mean = sum / 9.0f;
+
+    return std::max(0.0f, sum2 / 9.0f - mean * mean);
+}
+
+//Rows for the row-major layout, tiles otherwise, so that the frame is walked in the order it is stored
+template<DataLayout L>
+static void LocalVarianceIn(std::span<const float> src, std::span<float> dst,
+                            size_t width, size_t height, std::optional<uint32_t> num_jobs)
+{
+    //Neighbourhood clamped at frame edges
+    auto Clamped = [&](size_t x, size_t y)
+    {
+        std::array<float, 9> v;
+
+        const std::array<size_t, 3> xs{(x > 0) ? x - 1 : 0, x, std::min(x + 1, width - 1)};
+        const std::array<size_t, 3> ys{(y > 0) ? y - 1 : 0, y, std::min(y + 1, height - 1)};
+
+        for (size_t j = 0; j < 3; j++)
+            for (size_t i = 0; i < 3; i++)
+                v[j * 3 + i] = src[Layout::Index(L, xs[i], ys[j], width)];
+
+        return v;
+    };
+
+    auto VarianceRange = [&](size_t start, size_t end)
+    {
+        for (size_t r = start; r < end; r++)
+        {
+            if constexpr (L == DataLayout::RowMajor)
+            {
+                const size_t y = r;
+
+                for (size_t x = 0; x < width; x++)
+                {
+                    std::array<float, 9> v;
+
+                    if (x > 0 && y > 0 && x + 1 < width && y + 1 < height)
+                    {
+                        for (size_t j = 0; j < 3; j++)
+                            for (size_t i = 0; i < 3; i++)
+                                v[j * 3 + i] = src[(y + j - 1) * width + x + i - 1];
+                    }
+
+                    else
+                    {
+                        v = Clamped(x, y);
+                    }
+
+                    dst[y * width + x] = Variance(v);
+                }
+            }
+
+            else
+            {
+                const TileBounds b = GetTile(r, width, height);
+
+                const float* tile = &src[r * Layout::TileArea];
+                float* out = &dst[r * Layout::TileArea];
+
+                //Inner pixels of a tile only read the tile itself
+                for (size_t j = 0; j < b.Height; j++)
+                {
+                    for (size_t i = 0; i < b.Width; i++)
+                    {
+                        std::array<float, 9> v;
+
+                        if (i > 0 && j > 0 && i + 1 < b.Width && j + 1 < b.Height)
+                        {
+                            for (size_t dj = 0; dj < 3; dj++)
+                                for (size_t di = 0; di < 3; di++)
+                                    v[dj * 3 + di] = tile[LocalIndex<L>(i + di - 1, j + dj - 1)];
+                        }
+
+                        else
+                        {
+                            v = Clamped(b.X + i, b.Y + j);
+                        }
+
+                        out[LocalIndex<L>(i, j)] = Variance(v);
+                    }
+                }
+            }
+        }
+    };
+
+    const size_t num_ranges = (L == DataLayout::RowMajor) ? height : NumTiles(width, height);
+
+    GenData::SplitIntoJobs(num_ranges, VarianceRange, num_jobs);
+}
+
+template<DataLayout L>
+static void DownsampleIn(std::span<const float> src, std::span<float> dst,
+                         size_t width, size_t height, std::optional<uint32_t> num_jobs)
+{
+    const size_t half_width = width / 2, half_height = height / 2;
+
+    auto DownsampleRange = [&](size_t start, size_t end)
+    {
+        for (size_t r = start; r < end; r++)
+        {
+            if constexpr (L == DataLayout::RowMajor)
+            {
+                const float* row0 = &src[2 * r * width];
+                const float* row1 = row0 + width;
+
+                for (size_t x = 0; x < half_width; x++)
+                    dst[r * half_width + x] = 0.25f * (row0[2*x] + row0[2*x + 1] + row1[2*x] + row1[2*x + 1]);
+            }
+
+            else
+            {
+                //Tiles have even sides, so blocks never cross them,
+                //an odd last row or column of the frame has no block of its own
+                const TileBounds b = GetTile(r, width, height);
+
+                const float* tile = &src[r * Layout::TileArea];
+
+                const size_t cols = std::min(b.Width, 2 * half_width - b.X) / 2;
+                const size_t rows = std::min(b.Height, 2 * half_height - b.Y) / 2;
+
+                for (size_t j = 0; j < rows; j++)
+                {
+                    float* out = &dst[(b.Y / 2 + j) * half_width + b.X / 2];
+
+                    for (size_t i = 0; i < cols; i++)
+                    {
+                        //In Morton order, a 2x2 block is four consecutive values
+                        if constexpr (L == DataLayout::Morton)
+                        {
+                            const float* block = tile + LocalIndex<L>(2 * i, 2 * j);
+                            out[i] = 0.25f * (block[0] + block[1] + block[2] + block[3]);
+                        }
+
+                        else
+                        {
+                            const float* row0 = tile + LocalIndex<L>(2 * i, 2 * j);
+                            const float* row1 = row0 + Layout::TileSide;
+                            out[i] = 0.25f * (row0[0] + row0[1] + row1[0] + row1[1]);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    const size_t num_ranges = (L == DataLayout::RowMajor) ? half_height : NumTiles(width, height);
+
+    GenData::SplitIntoJobs(num_ranges, DownsampleRange, num_jobs);
+}
+
+void Layout::LocalVariance(std::span<const float> src, std::span<float> dst, DataLayout l,
+                           size_t width, size_t height, std::optional<uint32_t> num_jobs)
+{
+    switch (l)
+    {
+        case DataLayout::RowMajor: LocalVarianceIn<DataLayout::RowMajor>(src, dst, width, height, num_jobs); break;
+        case DataLayout::Tiled:    LocalVarianceIn<DataLayout::Tiled>(src, dst, width, height, num_jobs);    break;
+        case DataLayout::Morton:   LocalVarianceIn<DataLayout::Morton>(src, dst, width, height, num_jobs);   break;
+    }
+}
+
+void Layout::Downsample(std::span<const float> src, DataLayout l, std::span<float> dst,
+                        size_t width, size_t height, std::optional<uint32_t> num_jobs)
+{
+    switch (l)
+    {
+        case DataLayout::RowMajor: DownsampleIn<DataLayout::RowMajor>(src, dst, width, height, num_jobs); break;
+        case DataLayout::Tiled:    DownsampleIn<DataLayout::Tiled>(src, dst, width, height, num_jobs);    break;
+        case DataLayout::Morton:   DownsampleIn<DataLayout::Morton>(src, dst, width, height, num_jobs);   break;
+    }
+}
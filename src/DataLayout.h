@@ -0,0 +1,82 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "GenData.h"
+
+//Order of pixels in the generator output buffer
+//Row-major keeps rows contiguous, so every 2D neighbourhood strides over whole rows;
+//tiled layouts keep each TileSide x TileSide block of the frame in one contiguous 16kB run,
+//so neighbourhoods of a whole tile fit in L1 and a tile maps to only four pages
+enum class DataLayout{
+    RowMajor,
+    //Tiles in row-major order, pixels row-major inside of a tile
+    Tiled,
+    //Tiles in row-major order, pixels in Morton (Z) order inside of a tile,
+    //so that every 2x2, 4x4, ... aligned block is contiguous as well
+    Morton
+};
+
+//Generation and 2D post-processing run natively in any layout,
+//a single de-tiling pass converts the result to row-major at output time
+namespace Layout {
+
+    constexpr size_t TileSide = 64;
+    constexpr size_t TileArea = TileSide * TileSide;
+
+    //Bits of a coordinate inside of a tile spread to even positions
+    constexpr std::array<uint16_t, TileSide> MortonSpread = [](){
+        std::array<uint16_t, TileSide> res{};
+
+        for (size_t v = 0; v < TileSide; v++)
+            for (size_t bit = 0; bit < 6; bit++)
+                res[v] |= static_cast<uint16_t>(((v >> bit) & 1) << (2 * bit));
+
+        return res;
+    }();
+
+    inline size_t NumTilesX(size_t width)
+    {
+        return (width + TileSide - 1) / TileSide;
+    }
+
+    //Number of floats a frame takes, tiled layouts pad the frame to whole tiles
+    size_t BufferSize(DataLayout l, size_t width, size_t height);
+
+    inline size_t Index(DataLayout l, size_t x, size_t y, size_t width)
+    {
+        if (l == DataLayout::RowMajor)
+            return y * width + x;
+
+        const size_t tile = (y / TileSide) * NumTilesX(width) + x / TileSide;
+        const size_t tx = x % TileSide, ty = y % TileSide;
+
+        if (l == DataLayout::Tiled)
+            return tile * TileArea + ty * TileSide + tx;
+        else
+            return tile * TileArea + (MortonSpread[tx] | (MortonSpread[ty] << 1));
+    }
+
+    //Generates the frame directly in layout l, tiles are split between jobs
+    //Data must hold BufferSize floats and be aligned at least to 32 bytes
+    void GenerateFractal(std::span<float> data, DataLayout l, GenFunction f,
+                         GenData::FrameParams p, GenData::ExecutionPolicy e);
+
+    //De-tiling pass, dst receives the frame as width*height row-major floats
+    void ToRowMajor(std::span<const float> src, DataLayout l, std::span<float> dst,
+                    size_t width, size_t height, std::optional<uint32_t> num_jobs = std::nullopt);
+
+    //Variance of every pixel's 3x3 neighbourhood (clamped at frame edges) into dst,
+    //in the same layout as src, high variance marks pixels worth supersampling
+    //Pixels are visited in storage order, tile by tile for tiled layouts
+    void LocalVariance(std::span<const float> src, std::span<float> dst, DataLayout l,
+                       size_t width, size_t height, std::optional<uint32_t> num_jobs = std::nullopt);
+
+    //Average of every 2x2 block into a row-major frame of (width/2)*(height/2) floats
+    void Downsample(std::span<const float> src, DataLayout l, std::span<float> dst,
+                    size_t width, size_t height, std::optional<uint32_t> num_jobs = std::nullopt);
+}
@@ -0,0 +1,71 @@
+#include "Engine.h"
+
+#include <algorithm>
+
+Engine::Renderer::Renderer(ThreadPool& pool, size_t max_width)
+    : m_Pool(pool), m_MaxWidth(std::max<size_t>(max_width, 8))
+{
+    for (size_t i = 0; i < m_Pool.NumThreads(); i++)
+        m_Scratch.emplace_back(m_MaxWidth);
+}
+
+//Generates one row segment [x, x + width) of the request into dst
+static void GenerateSegment(float* dst, const Engine::Request& req, size_t row, size_t x, size_t width)
+{
+    const GenData::TileRect segment{
+        .X = req.Rect.X + x,
+        .Y = req.Rect.Y + row,
+        .Width = width,
+        .Height = 1
+    };
+
+    GenData::GenerateTile(dst, req.Function, req.Frame, segment, req.Simd);
+}
+
+void Engine::Renderer::RenderData(float* out, size_t stride, const Request& req)
+{
+    //Kernels use aligned stores relative to the start of the row
+    const bool direct = (reinterpret_cast<uintptr_t>(out) % 32 == 0) && (stride % 8 == 0);
+
+    auto RenderRow = [&](size_t row, size_t thread_id)
+    {
+        float* dst = out + row * stride;
+
+        if (direct)
+        {
+            GenerateSegment(dst, req, row, 0, req.Rect.Width);
+            return;
+        }
+
+        float* scratch = m_Scratch[thread_id].data();
+
+        for (size_t x = 0; x < req.Rect.Width; x += m_MaxWidth)
+        {
+            const size_t width = std::min(m_MaxWidth, req.Rect.Width - x);
+
+            GenerateSegment(scratch, req, row, x, width);
+            std::copy(scratch, scratch + width, dst + x);
+        }
+    };
+
+    m_Pool.ParallelFor(req.Rect.Height, RenderRow);
+}
+
+void Engine::Renderer::RenderPixels(Image::Pixel* out, size_t stride, const Request& req, const Image::ColoringFn& c)
+{
+    auto RenderRow = [&](size_t row, size_t thread_id)
+    {
+        Image::Pixel* dst = out + row * stride;
+        float* scratch = m_Scratch[thread_id].data();
+
+        for (size_t x = 0; x < req.Rect.Width; x += m_MaxWidth)
+        {
+            const size_t width = std::min(m_MaxWidth, req.Rect.Width - x);
+
+            GenerateSegment(scratch, req, row, x, width);
+            std::transform(scratch, scratch + width, dst + x, c);
+        }
+    };
+
+    m_Pool.ParallelFor(req.Rect.Height, RenderRow);
+}
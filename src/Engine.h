@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "ComputeFractal.h"
+#include "GenData.h"
+#include "Image.h"
+#include "SimdType.h"
+#include "ThreadPool.h"
+
+//Entry point for embedding the renderer in other programs
+//Renders arbitrary viewports or tiles straight into caller-owned memory,
+//using caller-owned threads, without allocating per call
+namespace Engine {
+
+    struct Request{
+        GenFunction Function;
+        SimdType Simd = SimdType::AVX;
+        //Whole viewport, defines mapping of pixels onto the complex plane
+        GenData::FrameParams Frame;
+        //Part of the viewport to render, use {0, 0, Frame.Width, Frame.Height} for all of it
+        GenData::TileRect Rect;
+    };
+
+    class Renderer{
+    public:
+        //Scratch memory is allocated here, once, wider rows are processed in max_width pieces
+        Renderer(ThreadPool& pool, size_t max_width);
+
+        //Writes Rect.Height rows of Rect.Width values, rows start stride elements apart
+        //When out is 32 byte aligned and stride a multiple of 8, kernels store
+        //straight into it, otherwise rows go through scratch memory first
+        void RenderData(float* out, size_t stride, const Request& req);
+
+        //Same as above, but colors values into pixels, stride is in pixels
+        void RenderPixels(Image::Pixel* out, size_t stride, const Request& req, const Image::ColoringFn& c);
+
+    private:
+        ThreadPool& m_Pool;
+        size_t m_MaxWidth;
+
+        //One row per thread of the pool
+        std::vector<AlignedVector<float>> m_Scratch;
+    };
+}
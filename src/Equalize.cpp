@@ -0,0 +1,182 @@
+#include "Equalize.h"
+#include "GenData.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <smmintrin.h>
+
+typedef std::array<uint32_t, Equalize::NumBins> Histogram;
+
+//Position of values in units of bins, clamped to [0, NumBins)
+//NaNs end up in the last bin, callers mask them out
+struct BinScale{
+    __m128 Min;
+    __m128 Scale;
+    __m128 Upper;
+
+    explicit BinScale(QuantizationRange r)
+        : Min(_mm_set1_ps(r.Min)),
+          Scale(_mm_set1_ps(static_cast<float>(Equalize::NumBins) / (r.Max - r.Min))),
+          Upper(_mm_set1_ps(std::nextafter(static_cast<float>(Equalize::NumBins), 0.0f)))
+    {}
+
+    __m128 Position(__m128 v) const
+    {
+        const __m128 x = _mm_mul_ps(_mm_sub_ps(v, Min), Scale);
+
+        return _mm_max_ps(_mm_min_ps(x, Upper), _mm_setzero_ps());
+    }
+};
+
+Equalize::Equalizer::Equalizer(EqualizeParams p)
+    : m_Params(p)
+{
+    for (size_t i = 0; i <= NumBins; i++)
+        m_Cdf[i] = static_cast<float>(i) / static_cast<float>(NumBins);
+}
+
+static void CountValues(const float* data, size_t count, Histogram& hist, const BinScale& scale)
+{
+    alignas(16) std::array<int32_t, 4> bins;
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 v = _mm_loadu_ps(data + i);
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(bins.data()), _mm_cvttps_epi32(scale.Position(v)));
+
+        const int ordered = _mm_movemask_ps(_mm_cmpord_ps(v, v));
+
+        for (size_t lane = 0; lane < 4; lane++)
+            if (ordered & (1 << lane))
+                hist[bins[lane]]++;
+    }
+
+    for (; i < count; i++)
+    {
+        const __m128 v = _mm_set_ss(data[i]);
+
+        if (!std::isnan(data[i]))
+            hist[_mm_cvtt_ss2si(scale.Position(v))]++;
+    }
+}
+
+void Equalize::Equalizer::Update(std::span<const float> data, std::optional<uint32_t> num_jobs, bool pin_threads)
+{
+    TRACE_ZONE("Histogram");
+
+    const size_t num_threads = std::max<size_t>(1, num_jobs.has_value() ? num_jobs.value()
+                                                                         : std::thread::hardware_concurrency());
+
+    const BinScale scale(m_Params.Range);
+
+    std::vector<Histogram> histograms(num_threads);
+
+    //Every thread counts its own range of pixels into its own histogram
+    auto CountRanges = [&](size_t start, size_t end)
+    {
+        for (size_t worker = start; worker < end; worker++)
+        {
+            const size_t first = worker * data.size() / num_threads;
+            const size_t last = (worker + 1) * data.size() / num_threads;
+
+            CountValues(&data[first], last - first, histograms[worker], scale);
+        }
+    };
+
+    GenData::SplitIntoJobs(num_threads, CountRanges, num_threads, pin_threads);
+
+    //Merge costs NumBins additions per thread, regardless of the frame size
+    std::array<uint64_t, NumBins> merged{};
+
+    for (const Histogram& hist : histograms)
+        for (size_t b = 0; b < NumBins; b++)
+            merged[b] += hist[b];
+
+    uint64_t total = 0;
+
+    for (const uint64_t count : merged)
+        total += count;
+
+    //Nothing but interior points, the previous distribution stays
+    if (total == 0)
+        return;
+
+    const float weight = m_HasFrame ? std::clamp(m_Params.Smoothing, 0.0f, 1.0f) : 0.0f;
+
+    uint64_t running = 0;
+
+    for (size_t b = 0; b < NumBins; b++)
+    {
+        running += merged[b];
+
+        const float cdf = static_cast<float>(static_cast<double>(running) / static_cast<double>(total));
+
+        m_Cdf[b + 1] = weight * m_Cdf[b + 1] + (1.0f - weight) * cdf;
+    }
+
+    m_Cdf[0] = 0.0f;
+
+    m_HasFrame = true;
+}
+
+void Equalize::Equalizer::Apply(std::span<const float> data, std::span<float> out, std::optional<uint32_t> num_jobs,
+                                bool pin_threads) const
+{
+    TRACE_ZONE("Equalize");
+
+    const BinScale scale(m_Params.Range);
+    const __m128 output_scale = _mm_set1_ps(m_Params.OutputScale);
+
+    const float* cdf = m_Cdf.data();
+
+    //Bin positions are computed four at a time, the two table entries around every one
+    //are fetched with scalar loads (there is no gather below AVX2) and interpolated in simd again
+    auto ApplyRange = [&](size_t start, size_t end)
+    {
+        alignas(16) std::array<int32_t, 4> bins;
+
+        size_t i = start;
+
+        for (; i + 4 <= end; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(&data[i]);
+            const __m128 x = scale.Position(v);
+            const __m128i bin = _mm_cvttps_epi32(x);
+
+            _mm_store_si128(reinterpret_cast<__m128i*>(bins.data()), bin);
+
+            const __m128 lo = _mm_setr_ps(cdf[bins[0]], cdf[bins[1]], cdf[bins[2]], cdf[bins[3]]);
+            const __m128 hi = _mm_setr_ps(cdf[bins[0] + 1], cdf[bins[1] + 1], cdf[bins[2] + 1], cdf[bins[3] + 1]);
+
+            const __m128 frac = _mm_sub_ps(x, _mm_cvtepi32_ps(bin));
+            const __m128 t = _mm_add_ps(lo, _mm_mul_ps(frac, _mm_sub_ps(hi, lo)));
+
+            const __m128 res = _mm_blendv_ps(_mm_mul_ps(t, output_scale), v, _mm_cmpunord_ps(v, v));
+
+            _mm_storeu_ps(&out[i], res);
+        }
+
+        for (; i < end; i++)
+        {
+            if (std::isnan(data[i]))
+            {
+                out[i] = data[i];
+                continue;
+            }
+
+            const float x = _mm_cvtss_f32(scale.Position(_mm_set_ss(data[i])));
+            const size_t b = static_cast<size_t>(x);
+
+            out[i] = m_Params.OutputScale * (cdf[b] + (x - static_cast<float>(b)) * (cdf[b + 1] - cdf[b]));
+        }
+    };
+
+    GenData::SplitIntoJobs(data.size(), ApplyRange, num_jobs, pin_threads);
+}
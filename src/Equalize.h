@@ -0,0 +1,52 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "DataFormat.h"
+
+//Histogram equalization of generator output before coloring
+//Every value is replaced by the fraction of the frame's pixels with lower values,
+//so palette colors are spread evenly over the pixels of every frame, no matter
+//how far the range of iteration counts drifted during a zoom
+namespace Equalize {
+
+    //Bins span the value range of the generator uniformly,
+    //values are interpolated linearly inside of a bin
+    constexpr size_t NumBins = 8192;
+
+    struct EqualizeParams{
+        //Values outside of the range fall into the first or the last bin
+        QuantizationRange Range{0.0f, 1.0f};
+        //Equalized values span [0, OutputScale]
+        float OutputScale = 1.0f;
+        //Weight of the distribution of earlier frames in [0, 1), 0 equalizes every frame on its own
+        //Higher values keep colors of consecutive frames stable, at the price of slower adaptation
+        float Smoothing = 0.0f;
+    };
+
+    class Equalizer{
+    public:
+        explicit Equalizer(EqualizeParams p);
+
+        //Counts values of the frame into one histogram per thread, then merges them into the
+        //cumulative distribution, blended with the one of earlier frames
+        //NaNs (interior points) are not counted
+        void Update(std::span<const float> data, std::optional<uint32_t> num_jobs = std::nullopt,
+                    bool pin_threads = false);
+
+        //Writes equalized data into out, NaNs are passed through unchanged
+        void Apply(std::span<const float> data, std::span<float> out, std::optional<uint32_t> num_jobs = std::nullopt,
+                   bool pin_threads = false) const;
+
+    private:
+        EqualizeParams m_Params;
+
+        //Cumulative distribution at bin edges, rises from 0 to 1
+        std::array<float, NumBins + 1> m_Cdf;
+        bool m_HasFrame = false;
+    };
+}
@@ -0,0 +1,202 @@
+#include "ExpMap.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <algorithm>
+
+#include <smmintrin.h>
+
+GenData::LogPolarParams ExpMap::GetStripParams(SequenceParams p)
+{
+    const float aspect_ratio = static_cast<float>(p.Height)/static_cast<float>(p.Width);
+    const float corner_factor = std::sqrt(1.0f + aspect_ratio*aspect_ratio);
+
+    const float first_half_ext = 0.5f * p.InitialWidth;
+    const float last_half_ext = first_half_ext
+        * std::pow(p.ZoomSpeed, static_cast<float>(std::max(p.NumFrames, 1u) - 1));
+
+    //Outermost sample lies at the corner of the largest frame,
+    //innermost one is a single pixel away from the center of the smallest
+    const float largest = std::max(first_half_ext, last_half_ext);
+    const float smallest = std::min(first_half_ext, last_half_ext);
+
+    const float max_log_radius = std::log(largest * corner_factor);
+    const float min_log_radius = std::log(2.0f * smallest / static_cast<float>(p.Width));
+
+    //Angular resolution matches pixel size at the corner of a frame,
+    //radial step is chosen so that strip samples are square (the map is conformal)
+    const float circumference = std::numbers::pi_v<float> * static_cast<float>(p.Width) * corner_factor;
+    const size_t width = 8 * static_cast<size_t>(std::ceil(circumference / 8.0f));
+
+    const float log_step = 2.0f * std::numbers::pi_v<float> / static_cast<float>(width);
+    const size_t height = static_cast<size_t>(std::ceil((max_log_radius - min_log_radius) / log_step)) + 2;
+
+    return GenData::LogPolarParams{
+        .CenterX = p.CenterX,
+        .CenterY = p.CenterY,
+        .MinLogRadius = min_log_radius,
+        .LogStep = log_step,
+        .Width = width,
+        .Height = height
+    };
+}
+
+ExpMap::Strip ExpMap::GenerateStrip(GenFunction f, SequenceParams p, GenData::ExecutionPolicy e)
+{
+    Strip strip;
+
+    strip.Params = GetStripParams(p);
+    strip.Data.resize(strip.Params.Width * strip.Params.Height);
+
+    GenData::GenerateLogPolar(strip.Data, f, strip.Params, e);
+
+    return strip;
+}
+
+ExpMap::FrameMapper::FrameMapper(const Strip& strip, SequenceParams p)
+    : m_Strip(strip), m_Column(p.Width * p.Height), m_Row(p.Width * p.Height)
+{
+    const GenData::LogPolarParams& sp = m_Strip.Params;
+
+    const float aspect_ratio = static_cast<float>(p.Height)/static_cast<float>(p.Width);
+    const float inv_width  = 1.0f/static_cast<float>(p.Width);
+    const float inv_height = 1.0f/static_cast<float>(p.Height);
+
+    const float inv_log_step = 1.0f / sp.LogStep;
+    const float columns_per_radian = static_cast<float>(sp.Width) / (2.0f * std::numbers::pi_v<float>);
+
+    const float log_half_ext = std::log(0.5f * p.InitialWidth);
+
+    //Pixels closer to the center than the innermost strip row are clamped to it
+    constexpr float min_log_distance = -30.0f;
+
+    for (size_t id = 0; id < m_Column.size(); id++)
+    {
+        //Same pixel placement as in GenData::GenerateFractal,
+        //expressed relative to the center in units of half extent
+        const float u = 2.0f * static_cast<float>(id % p.Width) * inv_width - 1.0f;
+        const float v = aspect_ratio * (2.0f * static_cast<float>(p.Height - id / p.Width) * inv_height - 1.0f);
+
+        float angle = std::atan2(v, u);
+
+        if (angle < 0.0f)
+            angle += 2.0f * std::numbers::pi_v<float>;
+
+        const float log_distance = std::max(0.5f * std::log(u*u + v*v), min_log_distance);
+
+        m_Column[id] = angle * columns_per_radian;
+        m_Row[id] = (log_half_ext + log_distance - sp.MinLogRadius) * inv_log_step;
+    }
+
+    m_RowsPerFrame = std::log(p.ZoomSpeed) * inv_log_step;
+}
+
+void ExpMap::FrameMapper::MapFrame(std::span<float> data, uint32_t frame, std::optional<uint32_t> num_jobs) const
+{
+    const GenData::LogPolarParams& sp = m_Strip.Params;
+
+    const float row_offset = m_RowsPerFrame * static_cast<float>(frame);
+    const float max_row = static_cast<float>(sp.Height - 1);
+
+    const float* strip = m_Strip.Data.data();
+
+    auto MapPixel = [&](size_t i)
+    {
+        const float row = std::clamp(m_Row[i] + row_offset, 0.0f, max_row);
+        const float col = m_Column[i];
+
+        const float row_floor = std::floor(row);
+        const float col_floor = std::floor(col);
+
+        const float fr = row - row_floor;
+        const float fc = col - col_floor;
+
+        const size_t r0 = static_cast<size_t>(row_floor);
+        const size_t r1 = std::min(r0 + 1, sp.Height - 1);
+
+        //Angle is periodic, so columns wrap around
+        const size_t c0 = static_cast<size_t>(col_floor) % sp.Width;
+        const size_t c1 = (c0 + 1) % sp.Width;
+
+        const float top    = strip[r0 * sp.Width + c0] + fc * (strip[r0 * sp.Width + c1] - strip[r0 * sp.Width + c0]);
+        const float bottom = strip[r1 * sp.Width + c0] + fc * (strip[r1 * sp.Width + c1] - strip[r1 * sp.Width + c0]);
+
+        data[i] = top + fr * (bottom - top);
+    };
+
+    //Strip offsets are computed in 32 bit lanes
+    const bool fits_lanes = sp.Width * sp.Height <= static_cast<size_t>(std::numeric_limits<int32_t>::max());
+
+    //Coordinates, weights and strip offsets are computed four pixels at a time, without the two
+    //integer divisions of the scalar wrap-around; the four neighbours of every pixel are fetched
+    //with scalar loads (there is no gather below AVX2) and interpolated in simd again
+    //Operations are the same as in MapPixel, so results are identical
+    auto MapPixels = [&](size_t start, size_t end)
+    {
+        size_t i = start;
+
+        if (fits_lanes)
+        {
+            const __m128 offset = _mm_set1_ps(row_offset);
+            const __m128 upper = _mm_set1_ps(max_row);
+
+            const __m128i width = _mm_set1_epi32(static_cast<int32_t>(sp.Width));
+            const __m128i last_row = _mm_set1_epi32(static_cast<int32_t>(sp.Height - 1));
+            const __m128i one = _mm_set1_epi32(1);
+
+            alignas(16) std::array<int32_t, 4> i00, i01, i10, i11;
+
+            for (; i + 4 <= end; i += 4)
+            {
+                const __m128 row = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(&m_Row[i]), offset), _mm_setzero_ps()), upper);
+                const __m128 col = _mm_loadu_ps(&m_Column[i]);
+
+                const __m128 row_floor = _mm_floor_ps(row);
+                const __m128 col_floor = _mm_floor_ps(col);
+
+                const __m128 fr = _mm_sub_ps(row, row_floor);
+                const __m128 fc = _mm_sub_ps(col, col_floor);
+
+                const __m128i r0 = _mm_cvttps_epi32(row_floor);
+                const __m128i r1 = _mm_min_epi32(_mm_add_epi32(r0, one), last_row);
+
+                //Angles lie in [0, 2pi], so columns wrap at most once
+                __m128i c0 = _mm_cvttps_epi32(col_floor);
+                c0 = _mm_sub_epi32(c0, _mm_andnot_si128(_mm_cmplt_epi32(c0, width), width));
+
+                __m128i c1 = _mm_add_epi32(c0, one);
+                c1 = _mm_andnot_si128(_mm_cmpeq_epi32(c1, width), c1);
+
+                const __m128i base0 = _mm_mullo_epi32(r0, width);
+                const __m128i base1 = _mm_mullo_epi32(r1, width);
+
+                _mm_store_si128(reinterpret_cast<__m128i*>(i00.data()), _mm_add_epi32(base0, c0));
+                _mm_store_si128(reinterpret_cast<__m128i*>(i01.data()), _mm_add_epi32(base0, c1));
+                _mm_store_si128(reinterpret_cast<__m128i*>(i10.data()), _mm_add_epi32(base1, c0));
+                _mm_store_si128(reinterpret_cast<__m128i*>(i11.data()), _mm_add_epi32(base1, c1));
+
+                auto Fetch = [&](const std::array<int32_t, 4>& idx)
+                {
+                    return _mm_setr_ps(strip[idx[0]], strip[idx[1]], strip[idx[2]], strip[idx[3]]);
+                };
+
+                const __m128 v00 = Fetch(i00);
+                const __m128 v01 = Fetch(i01);
+                const __m128 v10 = Fetch(i10);
+                const __m128 v11 = Fetch(i11);
+
+                const __m128 top    = _mm_add_ps(v00, _mm_mul_ps(fc, _mm_sub_ps(v01, v00)));
+                const __m128 bottom = _mm_add_ps(v10, _mm_mul_ps(fc, _mm_sub_ps(v11, v10)));
+
+                _mm_storeu_ps(&data[i], _mm_add_ps(top, _mm_mul_ps(fr, _mm_sub_ps(bottom, top))));
+            }
+        }
+
+        for (; i < end; i++)
+            MapPixel(i);
+    };
+
+    GenData::SplitIntoJobs(data.size(), MapPixels, num_jobs);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "AlignedAllocator.h"
+#include "ComputeFractal.h"
+#include "GenData.h"
+
+//Exponential map rendering of zoom sequences
+//Instead of computing every frame separately, a single log-polar strip
+//covering the whole zoom depth is generated, and each frame is then
+//reconstructed from it by an inverse mapping.
+namespace ExpMap {
+
+    struct SequenceParams{
+        float CenterX;
+        float CenterY;
+        float InitialWidth;
+        float ZoomSpeed;
+        uint32_t NumFrames;
+        size_t Width;
+        size_t Height;
+    };
+
+    struct Strip{
+        AlignedVector<float> Data;
+        GenData::LogPolarParams Params;
+    };
+
+    //Chooses strip resolution, so that one strip sample is not larger
+    //than one pixel of any frame in the sequence
+    GenData::LogPolarParams GetStripParams(SequenceParams p);
+
+    Strip GenerateStrip(GenFunction f, SequenceParams p, GenData::ExecutionPolicy e);
+
+    //Precomputes per-pixel strip coordinates of the first frame,
+    //all later frames only differ by a constant offset in log radius,
+    //so mapping a frame is just an addition and a bilinear fetch per pixel,
+    //done four pixels at a time with SSE
+    class FrameMapper{
+    public:
+        FrameMapper(const Strip& strip, SequenceParams p);
+
+        void MapFrame(std::span<float> data, uint32_t frame, std::optional<uint32_t> num_jobs) const;
+
+    private:
+        const Strip& m_Strip;
+
+        AlignedVector<float> m_Column;
+        AlignedVector<float> m_Row;
+
+        float m_RowsPerFrame;
+    };
+}
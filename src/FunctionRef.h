@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+//Non-owning reference to a callable, a lightweight replacement for std::function
+//in hot paths: it never allocates and costs a single indirect call
+//Referenced callable must outlive the FunctionRef
+template<typename Signature> class FunctionRef;
+
+template<typename Ret, typename... Args>
+class FunctionRef<Ret(Args...)>{
+public:
+    template<typename Fn>
+        requires(!std::is_same_v<std::remove_cvref_t<Fn>, FunctionRef> && std::is_invocable_r_v<Ret, Fn&, Args...>)
+    FunctionRef(Fn&& fn)
+        : m_Object(const_cast<void*>(static_cast<const void*>(std::addressof(fn)))),
+          m_Call([](void* object, Args... args) -> Ret {
+              return (*static_cast<std::remove_reference_t<Fn>*>(object))(std::forward<Args>(args)...);
+          })
+    {}
+
+    Ret operator()(Args... args) const
+    {
+        return m_Call(m_Object, std::forward<Args>(args)...);
+    }
+
+private:
+    void* m_Object;
+    Ret (*m_Call)(void*, Args...);
+};
@@ -1,17 +1,31 @@
 #include "GenData.h"
 
+#include "FunctionRef.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Topology.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numbers>
 #include <functional>
 
 namespace GenData {
 
-    typedef std::function<float(size_t)> CoordFunction;
+    typedef FunctionRef<float(size_t)> CoordFunction;
 
-    static void InnerLoop(AlignedVector<float>& data, GenFunction f,
+    //If cost is given, iterations executed for every pixel are stored in it
+    static void InnerLoop(float* data, GenFunction f,
         CoordFunction get_x, CoordFunction get_y,
         size_t start, size_t end,
-        SimdType simd);
+        SimdType simd, uint16_t* cost = nullptr);
 
-    void GenerateFractal(AlignedVector<float>& data, GenFunction f, FrameParams p, ExecutionPolicy e)
+    static void ConvertToCompact(const float* src, uint16_t* dst, size_t count,
+        DataFormat format, QuantizationRange range, SimdType simd);
+
+    void GenerateFractal(std::span<float> data, GenFunction f, FrameParams p, ExecutionPolicy e)
     {
         auto IterateImage = [&](size_t start, size_t end)
         {
@@ -33,28 +47,420 @@ namespace GenData {
         		return extents_y * idy * inv_height + p.MinY;
         	};
 
-            InnerLoop(data, f, getX, getY, start, end, e.Simd);
+            InnerLoop(data.data(), f, getX, getY, start, end, e.Simd);
         };
 
+        SplitIntoJobs(data.size(), IterateImage, e.NumJobs, e.PinThreads);
+    }
+
+    void GenerateFractal(std::span<float> data, GenFunction f, FrameParams p, ExecutionPolicy e, CostMap& cost)
+    {
+        const size_t num_jobs = std::max<size_t>(1, e.NumJobs.has_value() ? e.NumJobs.value()
+                                                                         : std::thread::hardware_concurrency());
+
+        std::vector<size_t> bounds;
+
+        if (cost.Iterations.empty())
+        {
+            for (size_t i = 0; i <= num_jobs; i++)
+                bounds.push_back(i * data.size() / num_jobs);
+        }
+
+        else
+        {
+            bounds = PredictPartition(cost, p, num_jobs);
+        }
+
+        //Prediction is done, the map can be overwritten with this frame
+        cost.Params = p;
+        cost.Iterations.resize(data.size());
+
+        auto IterateImage = [&](size_t start, size_t end)
+        {
+            const float inv_width  = 1.0f/static_cast<float>(p.Width);
+            const float inv_height = 1.0f/static_cast<float>(p.Height);
+
+            const float extents_x = p.MaxX - p.MinX;
+            const float extents_y = p.MaxY - p.MinY;
+
+            auto getX = [&](size_t id)
+            {
+                const float idx = static_cast<float>(id % p.Width);
+                return extents_x * idx * inv_width + p.MinX;
+            };
+
+            auto getY = [&](size_t id)
+            {
+                const float idy = static_cast<float>(p.Height - id / p.Width);
+                return extents_y * idy * inv_height + p.MinY;
+            };
+
+            InnerLoop(data.data(), f, getX, getY, start, end, e.Simd, cost.Iterations.data());
+        };
+
+        SplitAtBounds(bounds, IterateImage, e.PinThreads);
+    }
+
+    std::vector<size_t> PredictPartition(const CostMap& prev, FrameParams p, size_t num_jobs)
+    {
+        const FrameParams& q = prev.Params;
+
+        double total_prev = 0.0;
+
+        for (const uint16_t c : prev.Iterations)
+            total_prev += c;
+
+        const double mean = total_prev / static_cast<double>(std::max<size_t>(1, prev.Iterations.size()));
+
+        //Viewport of p in pixel coordinates of the earlier frame
+        const double scale_x = static_cast<double>(q.Width) / static_cast<double>(q.MaxX - q.MinX);
+        const double scale_y = static_cast<double>(q.Height) / static_cast<double>(q.MaxY - q.MinY);
+
+        const double col_begin = std::clamp((static_cast<double>(p.MinX) - q.MinX) * scale_x, 0.0, double(q.Width));
+        const double col_end   = std::clamp((static_cast<double>(p.MaxX) - q.MinX) * scale_x, 0.0, double(q.Width));
+
+        const size_t c0 = static_cast<size_t>(col_begin);
+        const size_t c1 = std::max(c0, static_cast<size_t>(std::ceil(col_end)));
+
+        //Predicted cost of every row of p, plus one so that empty rows still count
+        std::vector<double> row_cost(p.Height);
+
+        for (size_t j = 0; j < p.Height; j++)
+        {
+            const double y = static_cast<double>(p.MaxY - p.MinY) * static_cast<double>(p.Height - j)
+                           / static_cast<double>(p.Height) + p.MinY;
+
+            const double prev_row = static_cast<double>(q.Height) - (y - q.MinY) * scale_y;
+
+            double cost = mean;
+
+            if (prev_row >= 0.0 && prev_row < static_cast<double>(q.Height) && c1 > c0)
+            {
+                const uint16_t* row = &prev.Iterations[static_cast<size_t>(prev_row) * q.Width];
+
+                double sum = 0.0;
+
+                for (size_t i = c0; i < c1; i++)
+                    sum += row[i];
+
+                cost = sum / static_cast<double>(c1 - c0);
+            }
+
+            row_cost[j] = (cost + 1.0) * static_cast<double>(p.Width);
+        }
+
+        double total = 0.0;
+
+        for (const double c : row_cost)
+            total += c;
+
+        std::vector<size_t> bounds{0};
+
+        double accumulated = 0.0;
+        size_t row = 0;
+
+        for (size_t k = 1; k < num_jobs; k++)
+        {
+            const double target = total * static_cast<double>(k) / static_cast<double>(num_jobs);
+
+            while (row < p.Height && accumulated + 0.5 * row_cost[row] < target)
+                accumulated += row_cost[row++];
+
+            //Multiples of 8 keep every job on whole vectors, so results do not depend on the split
+            bounds.push_back(std::max(bounds.back(), (row * p.Width) & ~size_t(7)));
+        }
+
+        bounds.push_back(p.Width * p.Height);
+
+        return bounds;
+    }
+
+    void GenerateFractal(std::span<uint16_t> data, GenFunction f, FrameParams p, ExecutionPolicy e,
+                         DataFormat format, QuantizationRange range)
+    {
+        auto IterateImage = [&](size_t start, size_t end)
+        {
+            const float inv_width  = 1.0f/static_cast<float>(p.Width);
+            const float inv_height = 1.0f/static_cast<float>(p.Height);
+
+            const float extents_x = p.MaxX - p.MinX;
+            const float extents_y = p.MaxY - p.MinY;
+
+            //Kernels write floats into a small scratch buffer,
+            //which is converted to the compact format before moving on
+            constexpr size_t chunk_size = 512;
+            AlignedVector<float> scratch(chunk_size);
+
+            for (size_t chunk_start = start; chunk_start < end; chunk_start += chunk_size)
+            {
+                const size_t count = std::min(chunk_size, end - chunk_start);
+
+                auto getX = [&](size_t id)
+                {
+                    const float idx = static_cast<float>((chunk_start + id) % p.Width);
+                    return extents_x * idx * inv_width + p.MinX;
+                };
+
+                auto getY = [&](size_t id)
+                {
+                    const float idy = static_cast<float>(p.Height - (chunk_start + id) / p.Width);
+                    return extents_y * idy * inv_height + p.MinY;
+                };
+
+                InnerLoop(scratch.data(), f, getX, getY, 0, count, e.Simd);
+
+                ConvertToCompact(scratch.data(), &data[chunk_start], count, format, range, e.Simd);
+            }
+        };
+
+        SplitIntoJobs(data.size(), IterateImage, e.NumJobs, e.PinThreads);
+    }
+
+    void GenerateTile(float* tile, GenFunction f, FrameParams p, TileRect r, SimdType simd)
+    {
+        const float inv_width  = 1.0f/static_cast<float>(p.Width);
+        const float inv_height = 1.0f/static_cast<float>(p.Height);
+
+        const float extents_x = p.MaxX - p.MinX;
+        const float extents_y = p.MaxY - p.MinY;
+
+        //Same pixel placement as in GenerateFractal, but indices are local to the tile
+        auto getX = [&](size_t id)
+        {
+            const float idx = static_cast<float>(r.X + id % r.Width);
+            return extents_x * idx * inv_width + p.MinX;
+        };
+
+        auto getY = [&](size_t id)
+        {
+            const float idy = static_cast<float>(p.Height - (r.Y + id / r.Width));
+            return extents_y * idy * inv_height + p.MinY;
+        };
+
+        InnerLoop(tile, f, getX, getY, 0, r.Width * r.Height, simd);
+    }
+
+    void GenerateSubgrid(float* out, GenFunction f, FrameParams p, TileRect r,
+                         size_t step, size_t ox, size_t oy, SimdType simd)
+    {
+        if (r.Width <= ox || r.Height <= oy)
+            return;
+
+        const size_t nx = (r.Width - ox + step - 1) / step;
+        const size_t ny = (r.Height - oy + step - 1) / step;
+
+        const float inv_width  = 1.0f/static_cast<float>(p.Width);
+        const float inv_height = 1.0f/static_cast<float>(p.Height);
+
+        const float extents_x = p.MaxX - p.MinX;
+        const float extents_y = p.MaxY - p.MinY;
+
+        auto getX = [&](size_t id)
+        {
+            const float idx = static_cast<float>(r.X + ox + (id % nx) * step);
+            return extents_x * idx * inv_width + p.MinX;
+        };
+
+        auto getY = [&](size_t id)
+        {
+            const float idy = static_cast<float>(p.Height - (r.Y + oy + (id / nx) * step));
+            return extents_y * idy * inv_height + p.MinY;
+        };
+
+        InnerLoop(out, f, getX, getY, 0, nx * ny, simd);
+    }
+
+    size_t GeneratePanned(std::span<float> data, GenFunction f, FrameParams prev, FrameParams p, ExecutionPolicy e)
+    {
+        const float scale = (p.MaxX - p.MinX) / static_cast<float>(p.Width);
+        const float prev_scale = (prev.MaxX - prev.MinX) / static_cast<float>(prev.Width);
+
+        //Shift in pixels, new[r][c] = old[r - shift_rows][c + shift_cols]
+        const float exact_cols = (p.MinX - prev.MinX) / scale;
+        const float exact_rows = (p.MinY - prev.MinY) / scale;
+
+        const int64_t shift_cols = std::llround(exact_cols);
+        const int64_t shift_rows = std::llround(exact_rows);
+
+        constexpr float tolerance = 1e-3f;
+
+        const int64_t width = static_cast<int64_t>(p.Width);
+        const int64_t height = static_cast<int64_t>(p.Height);
+
+        const bool compatible = p.Width == prev.Width && p.Height == prev.Height
+            && std::abs(scale - prev_scale) * static_cast<float>(p.Width) < tolerance * scale
+            && std::abs(exact_cols - static_cast<float>(shift_cols)) < tolerance
+            && std::abs(exact_rows - static_cast<float>(shift_rows)) < tolerance
+            && std::abs(shift_cols) < width && std::abs(shift_rows) < height;
+
+        if (!compatible)
+        {
+            GenerateFractal(data, f, p, e);
+            return data.size();
+        }
+
+        //Valid region of the new frame
+        const int64_t row_begin = std::max<int64_t>(0, shift_rows);
+        const int64_t row_end = std::min<int64_t>(height, height + shift_rows);
+        const int64_t col_begin = std::max<int64_t>(0, -shift_cols);
+        const int64_t col_end = std::min<int64_t>(width, width - shift_cols);
+
+        //Rows are visited in order that never overwrites a source row before it is read
+        const size_t row_bytes = static_cast<size_t>(col_end - col_begin) * sizeof(float);
+
+        auto MoveRow = [&](int64_t r)
+        {
+            float* dst = &data[r * width + col_begin];
+            const float* src = &data[(r - shift_rows) * width + col_begin + shift_cols];
+            std::memmove(dst, src, row_bytes);
+        };
+
+        if (shift_rows > 0)
+        {
+            for (int64_t r = row_end - 1; r >= row_begin; r--)
+                MoveRow(r);
+        }
+
+        else
+        {
+            for (int64_t r = row_begin; r < row_end; r++)
+                MoveRow(r);
+        }
+
+        //Exposed area: full rows above and below the valid region,
+        //and columns left and right of it, cut into tile-sized pieces
+        const size_t tile_size = std::max<size_t>(8, e.TileSize);
+
+        std::vector<TileRect> rects;
+
+        auto AddRegion = [&](int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+        {
+            for (int64_t y = y0; y < y1; y += tile_size)
+            {
+                for (int64_t x = x0; x < x1; x += tile_size)
+                {
+                    rects.push_back(TileRect{
+                        .X      = static_cast<size_t>(x),
+                        .Y      = static_cast<size_t>(y),
+                        .Width  = std::min<size_t>(tile_size, x1 - x),
+                        .Height = std::min<size_t>(tile_size, y1 - y)
+                    });
+                }
+            }
+        };
+
+        AddRegion(0, 0, width, row_begin);
+        AddRegion(0, row_end, width, height);
+        AddRegion(0, row_begin, col_begin, row_end);
+        AddRegion(col_end, row_begin, width, row_end);
+
+        auto GenerateRects = [&](size_t start, size_t end)
+        {
+            AlignedVector<float> tile(tile_size * tile_size);
+
+            for (size_t i = start; i < end; i++)
+            {
+                const TileRect& r = rects[i];
+
+                GenerateTile(tile.data(), f, p, r, e.Simd);
+
+                for (size_t j = 0; j < r.Height; j++)
+                {
+                    const float* src = &tile[j * r.Width];
+                    std::copy(src, src + r.Width, &data[(r.Y + j) * p.Width + r.X]);
+                }
+            }
+        };
+
+        SplitIntoJobs(rects.size(), GenerateRects, e.NumJobs, e.PinThreads);
+
+        size_t generated = 0;
+
+        for (const auto& r : rects)
+            generated += r.Width * r.Height;
+
+        return generated;
+    }
+
+    void GenerateLogPolar(std::span<float> data, GenFunction f, LogPolarParams p, ExecutionPolicy e)
+    {
+        auto IterateStrip = [&](size_t start, size_t end)
+        {
+            const float angle_step = 2.0f * std::numbers::pi_v<float> / static_cast<float>(p.Width);
+
+            //Both coordinates depend on the angle and the radius,
+            //trigonometric functions are evaluated once per column
+            std::vector<float> cosines(p.Width), sines(p.Width);
+
+            for (size_t i = 0; i < p.Width; i++)
+            {
+                const float angle = angle_step * static_cast<float>(i);
+                cosines[i] = std::cos(angle);
+                sines[i] = std::sin(angle);
+            }
+
+            auto getRadius = [&](size_t id)
+            {
+                const float idy = static_cast<float>(id / p.Width);
+                return std::exp(p.MinLogRadius + p.LogStep * idy);
+            };
+
+            auto getX = [&](size_t id)
+            {
+                return p.CenterX + getRadius(id) * cosines[id % p.Width];
+            };
+
+            auto getY = [&](size_t id)
+            {
+                return p.CenterY + getRadius(id) * sines[id % p.Width];
+            };
+
+            InnerLoop(data.data(), f, getX, getY, start, end, e.Simd);
+        };
+
+        SplitIntoJobs(data.size(), IterateStrip, e.NumJobs, e.PinThreads);
+    }
+
+    void SplitIntoJobs(size_t total, RangeFunction fn, std::optional<uint32_t> num_jobs, bool pin_threads)
+    {
         const size_t num_threads = [&](){
-            if (e.NumJobs.has_value())
-                return e.NumJobs.value();
+            if (num_jobs.has_value())
+                return num_jobs.value();
             else
                 return std::thread::hardware_concurrency();
         }();
 
+        std::vector<size_t> bounds{0};
+
+        for (size_t i = 1; i <= std::max<size_t>(1, num_threads); i++)
+            bounds.push_back(i * total / std::max<size_t>(1, num_threads));
+
+        SplitAtBounds(bounds, fn, pin_threads);
+    }
+
+    void SplitAtBounds(std::span<const size_t> bounds, RangeFunction fn, bool pin_threads)
+    {
+        const size_t num_threads = bounds.size() - 1;
+
         if (num_threads > 1)
         {
-	        const size_t total = data.size();
-
 	        std::vector<std::thread> threads;
 
 	        for (size_t i = 0; i < num_threads; i++)
 	        {
-	    	    const size_t start =   i * total / num_threads;
-	    	    const size_t end = (i+1) * total / num_threads;
+	    	    const size_t start = bounds[i];
+	    	    const size_t end = bounds[i+1];
+
+	    	    threads.push_back(std::thread([&fn, i, start, end, num_threads, pin_threads]()
+	    	    {
+	    	        if (pin_threads)
+	    	            Topology::PinWorker(i, num_threads);
 
-	    	    threads.push_back(std::thread(IterateImage, start, end));
+	    	        TRACE_ZONE("Job", static_cast<int64_t>(i));
+	    	        Perf::ThreadScope counters(i);
+
+	    	        fn(start, end);
+	    	    }));
 	        }
 
 	        for (auto& thread : threads)
@@ -63,26 +469,89 @@ namespace GenData {
 
         else
         {
-            IterateImage(0, data.size());
+            TRACE_ZONE("Job", 0);
+            fn(bounds.front(), bounds.back());
         }
     }
 
-
-    static void InnerLoop(AlignedVector<float>& data, GenFunction f,
+    static void InnerLoop(float* data, GenFunction f,
             CoordFunction get_x, CoordFunction get_y,
             size_t start, size_t end,
-            SimdType simd)
+            SimdType simd, uint16_t* cost)
     {
         using enum SimdType;
 
+        using ComputeFractal::ExecutedIterations;
+
+        auto StoreCost = [&](size_t i, size_t width, uint64_t before)
+        {
+            std::fill_n(cost + i, width, static_cast<uint16_t>(ExecutedIterations - before));
+        };
+
         auto IterateScalar = [&](size_t scalar_start, size_t scalar_end)
         {
             for (size_t i = scalar_start; i < scalar_end; i++)
             {
                 const float x = get_x(i);
                 const float y = get_y(i);
-                data[i] = f.Scalar(x, y);
+
+                const uint64_t before = ExecutedIterations;
+
+                data[i] = f.Scalar(x, y, f.Params);
+
+                if (cost != nullptr)
+                    StoreCost(i, 1, before);
+            }
+        };
+
+        //Partial vectors at either end of the range go through the vector kernel as well, with unused
+        //lanes repeating the last pixel, and only the used lanes are kept
+        //Lanes are computed independently, so every pixel gets the same value for given simd type,
+        //no matter how the frame is split into ranges (jobs, tiles, rows of subgrids)
+        auto IteratePartialSSE = [&](size_t first, size_t last)
+        {
+            if (first >= last)
+                return;
+
+            alignas(16) std::array<float, 4> xs, ys, res;
+
+            for (size_t l = 0; l < 4; l++)
+            {
+                xs[l] = get_x(std::min(first + l, last - 1));
+                ys[l] = get_y(std::min(first + l, last - 1));
             }
+
+            const uint64_t before = ExecutedIterations;
+
+            f.SSE(res.data(), _mm_load_ps(xs.data()), _mm_load_ps(ys.data()), f.Params);
+
+            std::copy_n(res.data(), last - first, data + first);
+
+            if (cost != nullptr)
+                StoreCost(first, last - first, before);
+        };
+
+        auto IteratePartialAVX = [&](size_t first, size_t last)
+        {
+            if (first >= last)
+                return;
+
+            alignas(32) std::array<float, 8> xs, ys, res;
+
+            for (size_t l = 0; l < 8; l++)
+            {
+                xs[l] = get_x(std::min(first + l, last - 1));
+                ys[l] = get_y(std::min(first + l, last - 1));
+            }
+
+            const uint64_t before = ExecutedIterations;
+
+            f.AVX(res.data(), _mm256_load_ps(xs.data()), _mm256_load_ps(ys.data()), f.Params);
+
+            std::copy_n(res.data(), last - first, data + first);
+
+            if (cost != nullptr)
+                StoreCost(first, last - first, before);
         };
 
         //Utilities to find multiple of alignment that is closest to given value
@@ -96,7 +565,7 @@ namespace GenData {
         auto FindLargerMultiple = [](size_t value, size_t alignment)
         {
             const size_t mod = value % alignment;
-            return value - mod + alignment;
+            return (mod == 0) ? value : value - mod + alignment;
         };
 
         switch(simd)
@@ -108,32 +577,37 @@ namespace GenData {
              }
             case SSE:
             {
-                size_t vector_start = FindLargerMultiple(start, 4);
-                size_t vector_end = FindSmallerMultiple(end, 4);
+                size_t vector_start = std::min(FindLargerMultiple(start, 4), end);
+                size_t vector_end = std::max(FindSmallerMultiple(end, 4), vector_start);
 
-                IterateScalar(start, vector_start);
+                IteratePartialSSE(start, vector_start);
 
                 for (size_t i = vector_start; i < vector_end; i += 4)
                 {
                     __m128 x = _mm_set_ps(get_x(i + 3), get_x(i + 2), get_x(i + 1), get_x(i));
                     __m128 y = _mm_set_ps(get_y(i + 3), get_y(i + 2), get_y(i + 1), get_y(i));
 
+                    const uint64_t before = ExecutedIterations;
+
                     float* mem_address = &data[i];
-                    f.SSE(mem_address, x, y);
+                    f.SSE(mem_address, x, y, f.Params);
+
+                    if (cost != nullptr)
+                        StoreCost(i, 4, before);
                 }
 
-                IterateScalar(vector_end, end);
+                IteratePartialSSE(vector_end, end);
 
                 break;
             }
             case AVX:
             {
-                size_t vector_start = FindLargerMultiple(start, 8);
-                size_t vector_end = FindSmallerMultiple(end, 8);
+                size_t vector_start = std::min(FindLargerMultiple(start, 8), end);
+                size_t vector_end = std::max(FindSmallerMultiple(end, 8), vector_start);
 
-                IterateScalar(start, vector_start);
+                IteratePartialAVX(start, vector_start);
 
-                for (size_t i = start; i < end; i += 8)
+                for (size_t i = vector_start; i < vector_end; i += 8)
                 {
                     __m256 x = _mm256_set_ps(
                         get_x(i + 7), get_x(i + 6), get_x(i + 5), get_x(i + 4),
@@ -145,14 +619,103 @@ namespace GenData {
                         get_y(i + 3), get_y(i + 2), get_y(i + 1), get_y(i)
                     );
 
+                    const uint64_t before = ExecutedIterations;
+
                     float* mem_address = &data[i];
-                    f.AVX(mem_address, x, y);
+                    f.AVX(mem_address, x, y, f.Params);
+
+                    if (cost != nullptr)
+                        StoreCost(i, 8, before);
                 }
 
-                IterateScalar(vector_end, end);
+                IteratePartialAVX(vector_end, end);
 
                 break;
             }
         }
     }
-}
\ No newline at end of file
+
+    static void ConvertToCompact(const float* src, uint16_t* dst, size_t count,
+        DataFormat format, QuantizationRange range, SimdType simd)
+    {
+        using enum SimdType;
+
+        const size_t width = (simd == AVX) ? 8 : (simd == SSE) ? 4 : 1;
+        const size_t vector_end = count - count % width;
+
+        //Same mapping as EncodeQuantized, NaN lanes are masked to code 0
+        const __m128 min4 = _mm_set1_ps(range.Min);
+        const __m128 scale4 = _mm_set1_ps(65534.0f / (range.Max - range.Min));
+        const __m128 offset4 = _mm_set1_ps(1.5f);
+        const __m128 bottom4 = _mm_set1_ps(1.0f);
+        const __m128 top4 = _mm_set1_ps(65535.0f);
+
+        auto Quantize4 = [&](__m128 v)
+        {
+            __m128 q = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v, min4), scale4), offset4);
+            q = _mm_min_ps(_mm_max_ps(q, bottom4), top4);
+            q = _mm_and_ps(q, _mm_cmpord_ps(v, v));
+            return _mm_cvttps_epi32(q);
+        };
+
+        auto ConvertScalar = [&](size_t scalar_start, size_t scalar_end)
+        {
+            for (size_t i = scalar_start; i < scalar_end; i++)
+            {
+                if (format == DataFormat::Half)
+                    dst[i] = EncodeHalf(src[i]);
+                else
+                    dst[i] = EncodeQuantized(src[i], range);
+            }
+        };
+
+        if (format == DataFormat::Float)
+            return;
+
+        switch(simd)
+        {
+            case Scalar:
+            {
+                ConvertScalar(0, count);
+                return;
+            }
+            case SSE:
+            {
+                for (size_t i = 0; i < vector_end; i += 4)
+                {
+                    const __m128 v = _mm_load_ps(src + i);
+
+                    __m128i res;
+
+                    if (format == DataFormat::Half)
+                        res = _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+                    else
+                        res = _mm_packus_epi32(Quantize4(v), Quantize4(v));
+
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), res);
+                }
+                break;
+            }
+            case AVX:
+            {
+                for (size_t i = 0; i < vector_end; i += 8)
+                {
+                    const __m256 v = _mm256_load_ps(src + i);
+
+                    __m128i res;
+
+                    if (format == DataFormat::Half)
+                        res = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+                    else
+                        res = _mm_packus_epi32(Quantize4(_mm256_castps256_ps128(v)),
+                                               Quantize4(_mm256_extractf128_ps(v, 1)));
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), res);
+                }
+                break;
+            }
+        }
+
+        ConvertScalar(vector_end, count);
+    }
+}
@@ -1,20 +1,28 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <thread>
 #include <cstdint>
 #include <optional>
 #include <iostream>
+#include <functional>
 
 #include "AlignedAllocator.h"
 #include "SimdType.h"
 #include "ComputeFractal.h"
+#include "DataFormat.h"
 
 namespace GenData {
 
     struct ExecutionPolicy{
         SimdType Simd = SimdType::Scalar;
         std::optional<uint32_t> NumJobs = std::nullopt;
+        //Side length of square tiles used by tiled render paths
+        size_t TileSize = 64;
+        //Pin worker threads to cpus, spread over NUMA nodes as described in Topology.h
+        //Tiled render paths then also keep a work queue per node
+        bool PinThreads = false;
     };
 
     struct FrameParams{
@@ -26,5 +34,74 @@ namespace GenData {
         size_t Height;
     };
 
-	void GenerateFractal(AlignedVector<float>& data, GenFunction f, FrameParams p, ExecutionPolicy e);
+    //Rectangular part of a frame, in pixels
+    struct TileRect{
+        size_t X;
+        size_t Y;
+        size_t Width;
+        size_t Height;
+    };
+
+    //Describes a log-polar strip around given center
+    //Columns sample the angle uniformly over [0, 2pi),
+    //rows sample log of the radius uniformly, starting from MinLogRadius
+    struct LogPolarParams{
+        float CenterX;
+        float CenterY;
+        float MinLogRadius;
+        float LogStep;
+        size_t Width;
+        size_t Height;
+    };
+
+    //Iterations executed for every pixel of a frame, in the same layout as the frame
+    //Vector lanes share the count of their whole vector, as that is the work actually done
+    struct CostMap{
+        FrameParams Params{};
+        std::vector<uint16_t> Iterations;
+    };
+
+    typedef std::function<void(size_t, size_t)> RangeFunction;
+
+    //Splits [0, total) into contiguous ranges and processes each on a separate thread
+    //With pin_threads, the thread of range i is pinned by Topology::PinWorker
+    void SplitIntoJobs(size_t total, RangeFunction fn, std::optional<uint32_t> num_jobs, bool pin_threads = false);
+
+    //Processes every range between consecutive bounds on a separate thread
+    void SplitAtBounds(std::span<const size_t> bounds, RangeFunction fn, bool pin_threads = false);
+
+    //Returns num_jobs + 1 bounds splitting frame p into ranges of roughly equal cost,
+    //as predicted by the cost map of an earlier frame rescaled to the viewport of p
+    //Rows outside of the earlier frame are assumed to cost its average
+    std::vector<size_t> PredictPartition(const CostMap& prev, FrameParams p, size_t num_jobs);
+
+	void GenerateFractal(std::span<float> data, GenFunction f, FrameParams p, ExecutionPolicy e);
+
+    //Same as above, but also stores iterations executed for every pixel in cost
+    //If cost already holds the map of an earlier frame (e.g. previous frame of a zoom),
+    //jobs are balanced by its predicted cost instead of by pixel count
+    void GenerateFractal(std::span<float> data, GenFunction f, FrameParams p, ExecutionPolicy e, CostMap& cost);
+
+    //Same as the first one, but stores output in one of the 16 bit formats
+    //Values are converted right after the kernel writes them, while still in L1
+    void GenerateFractal(std::span<uint16_t> data, GenFunction f, FrameParams p, ExecutionPolicy e,
+                         DataFormat format, QuantizationRange range);
+
+    //Renders frame p into data, which holds frame prev of the same size and scale
+    //If the viewport moved by a whole number of pixels, overlapping region is shifted
+    //in place and only newly exposed strips are computed, otherwise whole frame is generated
+    //Returns number of generated pixels
+    size_t GeneratePanned(std::span<float> data, GenFunction f, FrameParams prev, FrameParams p, ExecutionPolicy e);
+
+    //Generates given part of the frame into a tightly packed buffer of r.Width*r.Height floats
+    //Buffer must be aligned at least to 32 bytes, as the one provided by AlignedVector
+    void GenerateTile(float* tile, GenFunction f, FrameParams p, TileRect r, SimdType simd);
+
+    //Same as above, but only for pixels (r.X + ox + i*step, r.Y + oy + j*step) inside of r,
+    //the buffer receives ceil((r.Width-ox)/step) * ceil((r.Height-oy)/step) values
+    //Pixels get exactly the values GenerateFractal would give them
+    void GenerateSubgrid(float* out, GenFunction f, FrameParams p, TileRect r,
+                         size_t step, size_t ox, size_t oy, SimdType simd);
+
+    void GenerateLogPolar(std::span<float> data, GenFunction f, LogPolarParams p, ExecutionPolicy e);
 }
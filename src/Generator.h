@@ -0,0 +1,123 @@
+#pragma once
+
+#include <version>
+
+#if defined(__cpp_lib_generator)
+
+#include <generator>
+
+template<typename T>
+using Generator = std::generator<T>;
+
+#else
+
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <exception>
+#include <coroutine>
+
+//Minimal stand-in for std::generator, for standard libraries that do not ship it yet
+//Lazily produced input range of values yielded with co_yield,
+//the coroutine runs only when the consumer advances the iterator
+template<typename T>
+class Generator{
+public:
+    struct promise_type{
+        const T* Value = nullptr;
+        std::exception_ptr Exception;
+
+        Generator get_return_object()
+        {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {return {};}
+        std::suspend_always final_suspend() noexcept {return {};}
+
+        //Yielded value lives in the coroutine frame until it is resumed again
+        std::suspend_always yield_value(const T& value) noexcept
+        {
+            Value = std::addressof(value);
+            return {};
+        }
+
+        void return_void() {}
+        void unhandled_exception() {Exception = std::current_exception();}
+
+        //Generators only yield, awaiting inside them is not supported
+        template<typename U>
+        void await_transform(U&&) = delete;
+    };
+
+    class iterator{
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+
+        const T& operator*() const {return *m_Handle.promise().Value;}
+
+        iterator& operator++()
+        {
+            Advance(m_Handle);
+            return *this;
+        }
+
+        void operator++(int) {++*this;}
+
+        bool operator==(std::default_sentinel_t) const {return !m_Handle || m_Handle.done();}
+
+    private:
+        std::coroutine_handle<promise_type> m_Handle;
+    };
+
+    Generator(Generator&& other) noexcept : m_Handle(std::exchange(other.m_Handle, {})) {}
+
+    Generator& operator=(Generator&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_Handle)
+                m_Handle.destroy();
+
+            m_Handle = std::exchange(other.m_Handle, {});
+        }
+
+        return *this;
+    }
+
+    //Destroying an unfinished generator destroys the coroutine frame,
+    //running destructors of all locals alive at the suspension point
+    ~Generator()
+    {
+        if (m_Handle)
+            m_Handle.destroy();
+    }
+
+    iterator begin()
+    {
+        Advance(m_Handle);
+        return iterator(m_Handle);
+    }
+
+    std::default_sentinel_t end() const noexcept {return {};}
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+
+    static void Advance(std::coroutine_handle<promise_type> handle)
+    {
+        handle.resume();
+
+        if (handle.done() && handle.promise().Exception)
+            std::rethrow_exception(handle.promise().Exception);
+    }
+
+private:
+    std::coroutine_handle<promise_type> m_Handle;
+};
+
+#endif
@@ -1,4 +1,7 @@
 #include "Image.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Topology.h"
 
 #define STBI_MSC_SECURE_CRT
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -7,6 +10,10 @@
 #include <cmath>
 #include <array>
 #include <map>
+#include <algorithm>
+#include <filesystem>
+
+#include "ComputeFractal.h"
 
 Image::ColoringFn Image::GetColoringFunction(ImageColoring c)
 {
@@ -22,17 +29,64 @@ Image::ColoringFn Image::GetColoringFunction(ImageColoring c)
 	return coloring_functions.at(c);
 }
 
-void Image::SaveImage(std::vector<Pixel>& image, ImageInfo info)
+void Image::SaveImage(std::span<const Pixel> image, ImageInfo info)
 {
+	TRACE_ZONE("Encode PNG");
+	Perf::Stage stage("Encode");
+
 	const size_t channel_nr = 3;
 
-	stbi_write_png(info.Name.c_str(), info.Width, info.Height, channel_nr, &image[0], info.Width * sizeof(Pixel));
+	//Written under a temporary name, so that an interrupted run never leaves a truncated image
+	const std::string temp = info.Name + ".tmp";
+
+	std::error_code ec;
+
+	if (stbi_write_png(temp.c_str(), info.Width, info.Height, channel_nr, image.data(), info.Width * sizeof(Pixel)))
+		std::filesystem::rename(temp, info.Name, ec);
+	else
+		std::filesystem::remove(temp, ec);
+}
+
+void Image::SaveHeatmap(std::span<const uint16_t> cost, ImageInfo info)
+{
+	std::vector<Pixel> image(cost.size());
+
+	//Square root spreads the many cheap pixels over more of the palette
+	auto HeatColor = [](uint16_t iterations)
+	{
+		const float t = std::sqrt(std::min(1.0f, static_cast<float>(iterations) / static_cast<float>(IterationBudget)));
+
+		auto Channel = [&](float from, float to)
+		{
+			return static_cast<uint8_t>(255.0f * std::clamp((t - from) / (to - from), 0.0f, 1.0f));
+		};
+
+		return Pixel{
+			.r = Channel(0.0f, 0.4f),
+			.g = Channel(0.3f, 0.7f),
+			.b = Channel(0.6f, 1.0f)
+		};
+	};
+
+	std::transform(cost.begin(), cost.end(), image.begin(), HeatColor);
+
+	SaveImage(image, info);
 }
 
-void Image::ColorAndSave(AlignedVector<float>&data, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs)
+void Image::ColorAndSave(std::span<const float> data, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs,
+	bool pin_threads)
 {
 	std::vector<Pixel> image(data.size());
 
+	ColorAndSave(data, image, f, info, num_jobs, pin_threads);
+}
+
+static void ColorInParallel(size_t total, const std::function<void(size_t, size_t)>& ColorPixels, std::optional<uint32_t> num_jobs,
+	bool pin_threads);
+
+void Image::ColorAndSave(std::span<const float> data, std::span<Pixel> image, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs,
+	bool pin_threads)
+{
 	auto ColorPixels = [&](size_t start, size_t end)
 	{
 		for (size_t i = start; i < end; i++)
@@ -41,6 +95,43 @@ void Image::ColorAndSave(AlignedVector<float>&data, ColoringFn f, ImageInfo info
 		}
 	};
 
+	{
+		Perf::Stage stage("Color");
+		ColorInParallel(image.size(), ColorPixels, num_jobs, pin_threads);
+	}
+
+	SaveImage(image, info);
+}
+
+void Image::ColorAndSave(std::span<const uint16_t> data, DataFormat format, QuantizationRange range,
+	std::span<Pixel> image, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs, bool pin_threads)
+{
+	auto ColorPixels = [&](size_t start, size_t end)
+	{
+		if (format == DataFormat::Half)
+		{
+			for (size_t i = start; i < end; i++)
+				image[i] = f(DecodeHalf(data[i]));
+		}
+
+		else
+		{
+			for (size_t i = start; i < end; i++)
+				image[i] = f(DecodeQuantized(data[i], range));
+		}
+	};
+
+	{
+		Perf::Stage stage("Color");
+		ColorInParallel(image.size(), ColorPixels, num_jobs, pin_threads);
+	}
+
+	SaveImage(image, info);
+}
+
+static void ColorInParallel(size_t total, const std::function<void(size_t, size_t)>& ColorPixels, std::optional<uint32_t> num_jobs,
+	bool pin_threads)
+{
 	const size_t num_threads = [&](){
         if (num_jobs.has_value())
             return num_jobs.value();
@@ -50,14 +141,22 @@ void Image::ColorAndSave(AlignedVector<float>&data, ColoringFn f, ImageInfo info
 
     if (num_threads > 1)
     {
-	    const size_t total = image.size();
 		std::vector<std::thread> threads;
 
 		for (size_t i = 0; i < num_threads; i++)
 		{
 			const size_t start = i * total / num_threads;
 			const size_t end = (i + 1) * total / num_threads;
-			threads.push_back(std::thread(ColorPixels, start, end));
+			threads.push_back(std::thread([&ColorPixels, i, start, end, num_threads, pin_threads]()
+			{
+				if (pin_threads)
+					Topology::PinWorker(i, num_threads);
+
+				TRACE_ZONE("Color", static_cast<int64_t>(i));
+				Perf::ThreadScope counters(i);
+
+				ColorPixels(start, end);
+			}));
 		}
 		
 		for (auto& thread : threads)
@@ -65,10 +164,9 @@ void Image::ColorAndSave(AlignedVector<float>&data, ColoringFn f, ImageInfo info
     }
     else
     {
-        ColorPixels(0, image.size());
+        TRACE_ZONE("Color", 0);
+        ColorPixels(0, total);
     }
-
-	SaveImage(image, info);
 }
 
 Image::Pixel Image::NormedGrayscale(float value)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <vector>
 #include <string>
 #include <thread>
@@ -8,6 +9,7 @@
 #include <functional>
 
 #include "AlignedAllocator.h"
+#include "DataFormat.h"
 
 namespace Image {
 	struct Pixel {
@@ -54,7 +56,23 @@ namespace Image {
 		std::string Name;
 	};
 
-	void SaveImage(std::vector<Pixel>& image, ImageInfo info);
+	void SaveImage(std::span<const Pixel> image, ImageInfo info);
 
-	void ColorAndSave(AlignedVector<float>&data, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs = std::nullopt);
+	//Saves iterations executed per pixel as a heatmap, from black (none)
+	//through red and yellow to white (whole iteration budget)
+	void SaveHeatmap(std::span<const uint16_t> cost, ImageInfo info);
+
+	//Pixels are split into contiguous ranges as in GenData::SplitIntoJobs,
+	//with pin_threads the thread of every range is pinned the same way too
+	void ColorAndSave(std::span<const float> data, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs = std::nullopt,
+		bool pin_threads = false);
+
+	//Same as above, but colors into provided pixel buffer instead of allocating one
+	void ColorAndSave(std::span<const float> data, std::span<Pixel> image, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs = std::nullopt,
+		bool pin_threads = false);
+
+	//Colors data stored in one of the 16 bit formats, values are decoded on the fly
+	void ColorAndSave(std::span<const uint16_t> data, DataFormat format, QuantizationRange range,
+		std::span<Pixel> image, ColoringFn f, ImageInfo info, std::optional<uint32_t> num_jobs = std::nullopt,
+		bool pin_threads = false);
 }
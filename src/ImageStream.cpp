@@ -0,0 +1,384 @@
+#include "ImageStream.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+//Adler32 with modulo deferred as long as the sums cannot overflow
+static void UpdateAdler(const uint8_t* data, size_t size, uint32_t& a, uint32_t& b)
+{
+	constexpr uint32_t adler_mod = 65521;
+	constexpr size_t adler_run = 5552;
+
+	for (size_t start = 0; start < size; start += adler_run)
+	{
+		const size_t end = std::min(start + adler_run, size);
+
+		for (size_t i = start; i < end; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+
+		a %= adler_mod;
+		b %= adler_mod;
+	}
+}
+
+static std::string PpmHeader(const Image::ImageInfo& info)
+{
+	return "P6\n" + std::to_string(info.Width) + " " + std::to_string(info.Height) + "\n255\n";
+}
+
+static void PushBigEndian(std::vector<uint8_t>& v, uint32_t value)
+{
+	v.push_back(static_cast<uint8_t>(value >> 24));
+	v.push_back(static_cast<uint8_t>(value >> 16));
+	v.push_back(static_cast<uint8_t>(value >> 8));
+	v.push_back(static_cast<uint8_t>(value));
+}
+
+Image::StreamWriter::StreamWriter(ImageInfo info, StreamFormat format, std::optional<StreamState> resume)
+	: m_Info(info), m_Format(format)
+{
+	const std::filesystem::path partial = PartialPath(m_Info.Name);
+
+	if (resume.has_value())
+	{
+		std::error_code ec;
+		std::filesystem::resize_file(partial, resume->Offset, ec);
+
+		if (!ec)
+		{
+			m_File.open(partial, std::ios::binary | std::ios::in | std::ios::out);
+			m_File.seekp(0, std::ios::end);
+
+			m_RowsWritten = resume->Rows;
+			m_AdlerA = resume->AdlerA;
+			m_AdlerB = resume->AdlerB;
+
+			return;
+		}
+	}
+
+	m_File.open(partial, std::ios::binary);
+
+	switch (m_Format)
+	{
+		case StreamFormat::PNG:
+		{
+			const std::array<uint8_t, 8> signature{137, 80, 78, 71, 13, 10, 26, 10};
+			m_File.write(reinterpret_cast<const char*>(signature.data()), signature.size());
+
+			std::vector<uint8_t> header;
+			PushBigEndian(header, m_Info.Width);
+			PushBigEndian(header, m_Info.Height);
+			//Bit depth 8, truecolor, default compression, filtering and no interlace
+			header.insert(header.end(), {8, 2, 0, 0, 0});
+
+			WriteChunk("IHDR", header);
+
+			//Zlib header: deflate with 32K window, no preset dictionary
+			WriteChunk("IDAT", {0x78, 0x01});
+			break;
+		}
+		case StreamFormat::PPM:
+		{
+			const std::string header = PpmHeader(m_Info);
+			m_File.write(header.data(), header.size());
+			break;
+		}
+	}
+}
+
+Image::StreamWriter::~StreamWriter()
+{
+	Finish();
+}
+
+void Image::StreamWriter::WriteRows(const Pixel* rows, size_t num_rows)
+{
+	const size_t row_bytes = m_Info.Width * sizeof(Pixel);
+
+	m_RowsWritten += static_cast<uint32_t>(num_rows);
+
+	if (m_Format == StreamFormat::PPM)
+	{
+		UpdateAdler(reinterpret_cast<const uint8_t*>(rows), num_rows * row_bytes, m_AdlerA, m_AdlerB);
+
+		m_File.write(reinterpret_cast<const char*>(rows), num_rows * row_bytes);
+		return;
+	}
+
+	//Scanlines are prefixed with filter type 0 (none)
+	std::vector<uint8_t> raw;
+	raw.reserve(num_rows * (row_bytes + 1));
+
+	for (size_t j = 0; j < num_rows; j++)
+	{
+		const uint8_t* row = reinterpret_cast<const uint8_t*>(rows + j * m_Info.Width);
+
+		raw.push_back(0);
+		raw.insert(raw.end(), row, row + row_bytes);
+	}
+
+	UpdateAdler(raw.data(), raw.size(), m_AdlerA, m_AdlerB);
+
+	//Split into stored deflate blocks, which cannot exceed 65535 bytes
+	constexpr size_t max_block = 65535;
+
+	m_Payload.clear();
+	m_Payload.reserve(raw.size() + 5 * (raw.size() / max_block + 1));
+
+	for (size_t start = 0; start < raw.size(); start += max_block)
+	{
+		const uint16_t len = static_cast<uint16_t>(std::min(max_block, raw.size() - start));
+		const uint16_t nlen = static_cast<uint16_t>(~len);
+
+		m_Payload.insert(m_Payload.end(), {
+			0x00,
+			static_cast<uint8_t>(len), static_cast<uint8_t>(len >> 8),
+			static_cast<uint8_t>(nlen), static_cast<uint8_t>(nlen >> 8)
+		});
+
+		m_Payload.insert(m_Payload.end(), raw.begin() + start, raw.begin() + start + len);
+	}
+
+	WriteChunk("IDAT", m_Payload);
+}
+
+void Image::StreamWriter::Finish()
+{
+	if (m_Finished)
+		return;
+
+	m_Finished = true;
+
+	if (m_Format == StreamFormat::PNG)
+	{
+		//Empty final stored block followed by the adler32 checksum
+		std::vector<uint8_t> tail{0x01, 0x00, 0x00, 0xff, 0xff};
+		PushBigEndian(tail, (m_AdlerB << 16) | m_AdlerA);
+
+		WriteChunk("IDAT", tail);
+		WriteChunk("IEND", {});
+	}
+
+	m_File.close();
+
+	std::error_code ec;
+	std::filesystem::rename(PartialPath(m_Info.Name), m_Info.Name, ec);
+}
+
+Image::StreamState Image::StreamWriter::GetState()
+{
+	m_File.flush();
+
+	return StreamState{
+		.Offset = static_cast<uint64_t>(m_File.tellp()),
+		.Rows = m_RowsWritten,
+		.AdlerA = m_AdlerA,
+		.AdlerB = m_AdlerB
+	};
+}
+
+std::filesystem::path Image::StreamWriter::PartialPath(const std::string& name)
+{
+	return name + ".partial";
+}
+
+bool Image::StreamWriter::Verify(const ImageInfo& info, StreamFormat format, const StreamState& state)
+{
+	std::ifstream file(PartialPath(info.Name), std::ios::binary);
+
+	if (!file)
+		return false;
+
+	uint64_t pos = 0;
+
+	//Reads never go past the recorded offset, data behind it is discarded on resume anyway
+	auto Read = [&](uint8_t* dst, size_t size)
+	{
+		if (pos + size > state.Offset)
+			return false;
+
+		file.read(reinterpret_cast<char*>(dst), size);
+		pos += size;
+
+		return static_cast<bool>(file);
+	};
+
+	auto ReadBigEndian = [&](uint32_t& value)
+	{
+		std::array<uint8_t, 4> bytes;
+
+		if (!Read(bytes.data(), bytes.size()))
+			return false;
+
+		value = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+		return true;
+	};
+
+	uint32_t a = 1, b = 0;
+	uint64_t data_bytes = 0;
+
+	std::vector<uint8_t> buffer(65536);
+
+	//Feeds size bytes of image data into the checksum
+	auto ReadData = [&](uint64_t size)
+	{
+		while (size > 0)
+		{
+			const size_t count = static_cast<size_t>(std::min<uint64_t>(size, buffer.size()));
+
+			if (!Read(buffer.data(), count))
+				return false;
+
+			UpdateAdler(buffer.data(), count, a, b);
+
+			data_bytes += count;
+			size -= count;
+		}
+
+		return true;
+	};
+
+	uint64_t row_bytes = uint64_t(info.Width) * sizeof(Pixel);
+
+	if (format == StreamFormat::PPM)
+	{
+		const std::string expected = PpmHeader(info);
+		std::vector<uint8_t> header(expected.size());
+
+		if (!Read(header.data(), header.size()) || !std::equal(header.begin(), header.end(), expected.begin()))
+			return false;
+
+		if (!ReadData(state.Offset - pos))
+			return false;
+	}
+
+	else
+	{
+		//Scanlines carry a filter type byte
+		row_bytes += 1;
+
+		const std::array<uint8_t, 8> signature{137, 80, 78, 71, 13, 10, 26, 10};
+		std::array<uint8_t, 8> read_signature;
+
+		if (!Read(read_signature.data(), read_signature.size()) || read_signature != signature)
+			return false;
+
+		//Chunks written so far: IHDR, IDAT with the zlib header, then one IDAT of stored blocks per band
+		for (size_t chunk = 0; pos < state.Offset; chunk++)
+		{
+			uint32_t length;
+			std::array<uint8_t, 4> type;
+
+			if (!ReadBigEndian(length) || !Read(type.data(), type.size()))
+				return false;
+
+			const std::string_view name(reinterpret_cast<const char*>(type.data()), type.size());
+
+			if (chunk == 0)
+			{
+				uint32_t width, height;
+				std::array<uint8_t, 5> rest;
+
+				if (name != "IHDR" || length != 13 || !ReadBigEndian(width) || !ReadBigEndian(height)
+					|| !Read(rest.data(), rest.size()) || width != info.Width || height != info.Height)
+					return false;
+			}
+
+			else if (chunk == 1)
+			{
+				std::array<uint8_t, 2> zlib;
+
+				if (name != "IDAT" || length != 2 || !Read(zlib.data(), zlib.size()) || zlib[0] != 0x78 || zlib[1] != 0x01)
+					return false;
+			}
+
+			else
+			{
+				if (name != "IDAT")
+					return false;
+
+				uint64_t remaining = length;
+
+				while (remaining > 0)
+				{
+					std::array<uint8_t, 5> block;
+
+					if (remaining < block.size() || !Read(block.data(), block.size()))
+						return false;
+
+					const uint16_t len = static_cast<uint16_t>(block[1] | (block[2] << 8));
+					const uint16_t nlen = static_cast<uint16_t>(block[3] | (block[4] << 8));
+
+					if (block[0] != 0x00 || nlen != static_cast<uint16_t>(~len) || remaining < block.size() + len)
+						return false;
+
+					if (!ReadData(len))
+						return false;
+
+					remaining -= block.size() + len;
+				}
+			}
+
+			uint32_t crc;
+
+			if (!ReadBigEndian(crc))
+				return false;
+		}
+	}
+
+	return pos == state.Offset && data_bytes == uint64_t(state.Rows) * row_bytes
+		&& a == state.AdlerA && b == state.AdlerB;
+}
+
+void Image::StreamWriter::WriteChunk(const char* type, const std::vector<uint8_t>& payload)
+{
+	std::vector<uint8_t> length;
+	PushBigEndian(length, static_cast<uint32_t>(payload.size()));
+
+	const uint8_t* type_bytes = reinterpret_cast<const uint8_t*>(type);
+
+	uint32_t crc = Crc32(type_bytes, 4);
+	crc = Crc32(payload.data(), payload.size(), crc);
+
+	std::vector<uint8_t> checksum;
+	PushBigEndian(checksum, crc);
+
+	m_File.write(reinterpret_cast<const char*>(length.data()), length.size());
+	m_File.write(type, 4);
+	m_File.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	m_File.write(reinterpret_cast<const char*>(checksum.data()), checksum.size());
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+	static const std::array<uint32_t, 256> table = [](){
+		std::array<uint32_t, 256> res;
+
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+
+			for (uint32_t k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+			res[n] = c;
+		}
+
+		return res;
+	}();
+
+	crc = ~crc;
+
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <optional>
+#include <filesystem>
+
+#include "Image.h"
+
+namespace Image {
+	enum class StreamFormat{
+		PNG,
+		PPM
+	};
+
+	//Position of a partially written image, enough to continue it after a restart
+	struct StreamState{
+		uint64_t Offset;
+		uint32_t Rows;
+		uint32_t AdlerA;
+		uint32_t AdlerB;
+	};
+
+	//Writes image to disk incrementally, a band of rows at a time,
+	//so the whole image never needs to reside in memory
+	//PNG output uses uncompressed (stored) deflate blocks, since the zlib stream
+	//of stb_image_write cannot be produced piecewise
+	//Data goes to PartialPath(info.Name) first, which is renamed once the image is finished
+	class StreamWriter{
+	public:
+		//With resume state, the partial file is truncated to its offset and continued
+		StreamWriter(ImageInfo info, StreamFormat format, std::optional<StreamState> resume = std::nullopt);
+		~StreamWriter();
+
+		StreamWriter(const StreamWriter&) = delete;
+		StreamWriter& operator=(const StreamWriter&) = delete;
+
+		//Appends num_rows full rows of pixels, rows are tightly packed
+		void WriteRows(const Pixel* rows, size_t num_rows);
+
+		//Writes trailing data, called automatically on destruction
+		void Finish();
+
+		uint32_t RowsWritten() const {return m_RowsWritten;}
+
+		//Flushes written rows, so that the state refers to data on disk
+		StreamState GetState();
+
+		static std::filesystem::path PartialPath(const std::string& name);
+
+		//Recomputes the checksum of the image data in the partial file up to the state's offset,
+		//false if the file is shorter, malformed, of another size or format, or its data does not match
+		static bool Verify(const ImageInfo& info, StreamFormat format, const StreamState& state);
+
+	private:
+		void WriteChunk(const char* type, const std::vector<uint8_t>& payload);
+
+	private:
+		ImageInfo m_Info;
+		StreamFormat m_Format;
+
+		std::ofstream m_File;
+
+		uint32_t m_RowsWritten = 0;
+		bool m_Finished = false;
+
+		//Running adler32 checksum of uncompressed PNG scanlines, or of PPM pixel data
+		uint32_t m_AdlerA = 1;
+		uint32_t m_AdlerB = 0;
+
+		std::vector<uint8_t> m_Payload;
+	};
+}
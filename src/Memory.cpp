@@ -0,0 +1,209 @@
+#include "Memory.h"
+#include "Topology.h"
+
+#include <new>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+static constexpr size_t SmallPageSize = 4096;
+static constexpr std::align_val_t HeapAlignment{64};
+
+static size_t MinorPageFaults()
+{
+#ifdef __linux__
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_minflt);
+#else
+    return 0;
+#endif
+}
+
+Memory::FramePool::FramePool(HugePages mode, std::optional<uint32_t> num_jobs, bool pin_threads)
+    : m_Mode(mode), m_NumJobs(num_jobs), m_PinThreads(pin_threads)
+{}
+
+Memory::FramePool::~FramePool()
+{
+    for (auto& block : m_FreeBlocks)
+        Free(block);
+}
+
+Memory::PoolStats Memory::FramePool::GetStats() const
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Stats;
+}
+
+Memory::FramePool::Block Memory::FramePool::Take(size_t bytes)
+{
+    {
+        std::lock_guard lock(m_Mutex);
+
+        //Smallest free block that fits
+        auto best = m_FreeBlocks.end();
+
+        for (auto it = m_FreeBlocks.begin(); it != m_FreeBlocks.end(); ++it)
+        {
+            if (it->Bytes >= bytes && (best == m_FreeBlocks.end() || it->Bytes < best->Bytes))
+                best = it;
+        }
+
+        if (best != m_FreeBlocks.end())
+        {
+            Block block = *best;
+            m_FreeBlocks.erase(best);
+
+            m_Stats.Reuses++;
+            m_Stats.PageFaultsAvoided += block.PageFaults;
+
+            return block;
+        }
+    }
+
+    Block block = Allocate(bytes);
+
+    FirstTouch(block);
+
+    std::lock_guard lock(m_Mutex);
+
+    m_Stats.Allocations++;
+    m_Stats.PageFaults += block.PageFaults;
+
+    return block;
+}
+
+void Memory::FramePool::Release(Block block)
+{
+    std::lock_guard lock(m_Mutex);
+    m_FreeBlocks.push_back(block);
+}
+
+Memory::FramePool::Block Memory::FramePool::Allocate(size_t bytes)
+{
+    Block block;
+    block.Bytes = std::max<size_t>(bytes, 1);
+
+#ifdef __linux__
+    if (m_Mode != HugePages::None)
+    {
+        block.Bytes = (block.Bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+        block.Mapped = true;
+
+        if (m_Mode == HugePages::Explicit)
+        {
+            void* ptr = mmap(nullptr, block.Bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if (ptr != MAP_FAILED)
+            {
+                block.Ptr = ptr;
+                return block;
+            }
+
+            std::lock_guard lock(m_Mutex);
+            m_Stats.ExplicitFallbacks++;
+        }
+
+        //Over-allocate, so that the mapping can be trimmed to 2MB alignment,
+        //which is required for the kernel to back it with huge pages
+        const size_t mapped_bytes = block.Bytes + HugePageSize;
+
+        void* ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+        const uintptr_t aligned = (begin + HugePageSize - 1) / HugePageSize * HugePageSize;
+
+        const size_t head = aligned - begin;
+        const size_t tail = mapped_bytes - head - block.Bytes;
+
+        if (head > 0)
+            munmap(ptr, head);
+
+        if (tail > 0)
+            munmap(reinterpret_cast<void*>(aligned + block.Bytes), tail);
+
+        block.Ptr = reinterpret_cast<void*>(aligned);
+
+        madvise(block.Ptr, block.Bytes, MADV_HUGEPAGE);
+
+        return block;
+    }
+#endif
+
+    block.Ptr = ::operator new(block.Bytes, HeapAlignment);
+    return block;
+}
+
+void Memory::FramePool::Free(Block block)
+{
+#ifdef __linux__
+    if (block.Mapped)
+    {
+        munmap(block.Ptr, block.Bytes);
+        return;
+    }
+#endif
+
+    ::operator delete(block.Ptr, HeapAlignment);
+}
+
+void Memory::FramePool::FirstTouch(Block& block)
+{
+    const size_t num_pages = (block.Bytes + SmallPageSize - 1) / SmallPageSize;
+
+    const size_t num_threads = std::min<size_t>(num_pages, [&](){
+        if (m_NumJobs.has_value())
+            return m_NumJobs.value();
+        else
+            return std::thread::hardware_concurrency();
+    }());
+
+    auto TouchPages = [&](size_t start, size_t end)
+    {
+        volatile char* bytes = static_cast<char*>(block.Ptr);
+
+        for (size_t i = start; i < end; i++)
+            bytes[i * SmallPageSize] = 0;
+    };
+
+    const size_t faults_before = MinorPageFaults();
+
+    if (num_threads > 1)
+    {
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < num_threads; i++)
+        {
+            const size_t start =   i * num_pages / num_threads;
+            const size_t end = (i+1) * num_pages / num_threads;
+
+            threads.push_back(std::thread([&TouchPages, this, i, start, end, num_threads]()
+            {
+                if (m_PinThreads)
+                    Topology::PinWorker(i, num_threads);
+
+                TouchPages(start, end);
+            }));
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    else
+    {
+        TouchPages(0, num_pages);
+    }
+
+    block.PageFaults = MinorPageFaults() - faults_before;
+}
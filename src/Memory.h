@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <type_traits>
+
+namespace Memory {
+
+    enum class HugePages{
+        //Regular aligned heap allocation
+        None,
+        //Anonymous mapping aligned to 2MB with MADV_HUGEPAGE advice
+        Transparent,
+        //MAP_HUGETLB mapping, falls back to Transparent if no huge pages are reserved
+        Explicit
+    };
+
+    struct PoolStats{
+        size_t Allocations = 0;
+        size_t Reuses = 0;
+        size_t PageFaults = 0;
+        size_t PageFaultsAvoided = 0;
+        size_t ExplicitFallbacks = 0;
+    };
+
+    //Recycles large frame buffers between frames (and jobs), so that they are
+    //allocated and first-touched only once per run
+    //Fresh buffers are first-touched in parallel, so their pages are spread
+    //over the threads that will later write them
+    //With pinned threads, touching threads are pinned like the workers of the same range,
+    //which places every worker's part of the buffer on its own NUMA node
+    class FramePool{
+    private:
+        struct Block{
+            void* Ptr = nullptr;
+            size_t Bytes = 0;
+            size_t PageFaults = 0;
+            bool Mapped = false;
+        };
+
+    public:
+        template<typename T>
+        class Buffer{
+        public:
+            Buffer() = default;
+
+            Buffer(FramePool* pool, Block block, size_t count)
+                : m_Pool(pool), m_Block(block), m_Count(count)
+            {}
+
+            ~Buffer()
+            {
+                if (m_Pool != nullptr)
+                    m_Pool->Release(m_Block);
+            }
+
+            Buffer(const Buffer&) = delete;
+            Buffer& operator=(const Buffer&) = delete;
+
+            Buffer(Buffer&& other) noexcept
+                : m_Pool(std::exchange(other.m_Pool, nullptr)), m_Block(other.m_Block), m_Count(other.m_Count)
+            {}
+
+            Buffer& operator=(Buffer&& other) noexcept
+            {
+                std::swap(m_Pool, other.m_Pool);
+                std::swap(m_Block, other.m_Block);
+                std::swap(m_Count, other.m_Count);
+                return *this;
+            }
+
+            T* data() const {return static_cast<T*>(m_Block.Ptr);}
+            size_t size() const {return m_Count;}
+
+            T& operator[](size_t id) const {return data()[id];}
+
+            operator std::span<T>() const {return std::span<T>(data(), m_Count);}
+            operator std::span<const T>() const {return std::span<const T>(data(), m_Count);}
+
+        private:
+            FramePool* m_Pool = nullptr;
+            Block m_Block;
+            size_t m_Count = 0;
+        };
+
+        FramePool(HugePages mode = HugePages::None, std::optional<uint32_t> num_jobs = std::nullopt,
+                  bool pin_threads = false);
+        ~FramePool();
+
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        //Contents of returned buffer are unspecified
+        template<typename T>
+        Buffer<T> Acquire(size_t count)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Pooled buffers hold only trivial types");
+            return Buffer<T>(this, Take(count * sizeof(T)), count);
+        }
+
+        PoolStats GetStats() const;
+
+    private:
+        Block Take(size_t bytes);
+        void Release(Block block);
+
+        Block Allocate(size_t bytes);
+        void Free(Block block);
+
+        void FirstTouch(Block& block);
+
+    private:
+        HugePages m_Mode;
+        std::optional<uint32_t> m_NumJobs;
+        bool m_PinThreads;
+
+        mutable std::mutex m_Mutex;
+        std::vector<Block> m_FreeBlocks;
+
+        PoolStats m_Stats;
+    };
+}
@@ -0,0 +1,319 @@
+#include "Net.h"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#ifdef __unix__
+#include <cerrno>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+static constexpr std::string_view TcpPrefix = "tcp:";
+
+//Returned by ReadSome when the receive timeout ran out before any data arrived
+static constexpr long ReadTimedOut = -2;
+
+#ifdef __unix__
+
+//Splits "<host>:<port>" at the last colon, host defaults to loopback
+static std::pair<std::string, std::string> SplitHostPort(std::string_view address)
+{
+    const size_t colon = address.rfind(':');
+
+    if (colon == std::string_view::npos)
+        return {"127.0.0.1", std::string(address)};
+
+    return {std::string(address.substr(0, colon)), std::string(address.substr(colon + 1))};
+}
+
+//Resolves the address and calls fn on candidates until it succeeds
+template<typename Fn>
+static int ForEachAddress(std::string_view address, bool passive, Fn fn)
+{
+    const auto [host, port] = SplitHostPort(address);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    addrinfo* list = nullptr;
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &list) != 0)
+        return -1;
+
+    int res = -1;
+
+    for (addrinfo* it = list; it != nullptr && res < 0; it = it->ai_next)
+    {
+        const int fd = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+
+        if (fd < 0)
+            continue;
+
+        if (fn(fd, it))
+            res = fd;
+        else
+            close(fd);
+    }
+
+    freeaddrinfo(list);
+
+    return res;
+}
+
+int Net::Listen(const std::string& address)
+{
+    int fd = -1;
+
+    if (address.starts_with(TcpPrefix))
+    {
+        fd = ForEachAddress(std::string_view(address).substr(TcpPrefix.size()), true, [](int fd, const addrinfo* info)
+        {
+            const int enable = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+            return bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, 64) == 0;
+        });
+    }
+
+    else
+    {
+        sockaddr_un unix_address{};
+        unix_address.sun_family = AF_UNIX;
+
+        if (address.size() < sizeof(unix_address.sun_path))
+        {
+            std::copy(address.begin(), address.end(), unix_address.sun_path);
+
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+            //Stale socket of a previous run would make bind fail
+            unlink(address.c_str());
+
+            if (fd >= 0 && (bind(fd, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)) != 0
+                            || listen(fd, 64) != 0))
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+
+    if (fd < 0)
+        std::cerr << "Failed to listen on " << address << '\n';
+
+    return fd;
+}
+
+int Net::Connect(const std::string& address)
+{
+    return ForEachAddress(address, false, [](int fd, const addrinfo* info)
+    {
+        if (connect(fd, info->ai_addr, info->ai_addrlen) != 0)
+            return false;
+
+        //Requests are small and latency bound
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        return true;
+    });
+}
+
+int Net::Accept(int listen_fd)
+{
+    while (true)
+    {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+
+        if (fd >= 0 || errno != EINTR)
+            return fd;
+    }
+}
+
+void Net::StopListening(int listen_fd)
+{
+    shutdown(listen_fd, SHUT_RDWR);
+}
+
+void Net::CloseListener(int listen_fd, const std::string& address)
+{
+    close(listen_fd);
+
+    if (!address.starts_with(TcpPrefix))
+        unlink(address.c_str());
+}
+
+Net::Connection::~Connection()
+{
+    if (!m_OwnsFds)
+        return;
+
+    close(m_In);
+
+    if (m_Out != m_In)
+        close(m_Out);
+}
+
+//Reads at most bytes, returns 0 at the end of the stream
+static long ReadSome(int fd, void* data, size_t bytes)
+{
+    while (true)
+    {
+        const ssize_t count = read(fd, data, bytes);
+
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return ReadTimedOut;
+
+        if (count >= 0 || errno != EINTR)
+            return count;
+    }
+}
+
+void Net::Connection::SetReceiveTimeout(std::chrono::milliseconds timeout)
+{
+    timeval value{};
+    value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    value.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+
+    //Fails harmlessly on pipes
+    setsockopt(m_In, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value));
+}
+
+static long WriteSome(int fd, const void* data, size_t bytes)
+{
+    while (true)
+    {
+        const ssize_t count = write(fd, data, bytes);
+
+        if (count >= 0 || errno != EINTR)
+            return count;
+    }
+}
+
+#else
+
+int Net::Listen(const std::string& address)
+{
+    std::cerr << "Sockets are only supported on unix, cannot listen on " << address << '\n';
+    return -1;
+}
+
+int Net::Connect(const std::string&) {return -1;}
+int Net::Accept(int) {return -1;}
+void Net::StopListening(int) {}
+void Net::CloseListener(int, const std::string&) {}
+
+Net::Connection::~Connection() {}
+
+void Net::Connection::SetReceiveTimeout(std::chrono::milliseconds) {}
+
+static long ReadSome(int, void*, size_t) {return -1;}
+static long WriteSome(int, const void*, size_t) {return -1;}
+
+#endif
+
+Net::Connection::Connection(int in_fd, int out_fd, bool owns_fds)
+    : m_In(in_fd), m_Out(out_fd), m_OwnsFds(owns_fds)
+{}
+
+bool Net::Connection::ReadLine(std::string& line)
+{
+    while (true)
+    {
+        const size_t end = m_Buffer.find('\n');
+
+        if (end != std::string::npos)
+        {
+            line = m_Buffer.substr(0, end);
+            m_Buffer.erase(0, end + 1);
+            return true;
+        }
+
+        char chunk[4096];
+        const long count = ReadSome(m_In, chunk, sizeof(chunk));
+
+        //Partial line is kept, it is of no use to the caller after an error
+        if (count < 0)
+        {
+            m_TimedOut = (count == ReadTimedOut);
+            return false;
+        }
+
+        if (count == 0)
+        {
+            //Last line may lack the newline
+            line = std::move(m_Buffer);
+            m_Buffer.clear();
+            return !line.empty();
+        }
+
+        m_Buffer.append(chunk, static_cast<size_t>(count));
+    }
+}
+
+bool Net::Connection::ReadExact(void* data, size_t bytes)
+{
+    char* dst = static_cast<char*>(data);
+
+    //Bytes already buffered by ReadLine come first
+    const size_t buffered = std::min(bytes, m_Buffer.size());
+
+    std::memcpy(dst, m_Buffer.data(), buffered);
+    m_Buffer.erase(0, buffered);
+
+    dst += buffered;
+    bytes -= buffered;
+
+    while (bytes > 0)
+    {
+        const long count = ReadSome(m_In, dst, bytes);
+
+        if (count <= 0)
+        {
+            m_TimedOut = (count == ReadTimedOut);
+            return false;
+        }
+
+        dst += count;
+        bytes -= static_cast<size_t>(count);
+    }
+
+    return true;
+}
+
+bool Net::Connection::Send(std::string_view line, const void* payload, size_t bytes)
+{
+    std::string message(line);
+    message += '\n';
+
+    std::lock_guard lock(m_WriteMutex);
+
+    return WriteAll(message.data(), message.size()) && WriteAll(payload, bytes);
+}
+
+bool Net::Connection::WriteAll(const void* data, size_t bytes)
+{
+    const char* src = static_cast<const char*>(data);
+
+    while (bytes > 0)
+    {
+        const long count = WriteSome(m_Out, src, bytes);
+
+        if (count <= 0)
+            return false;
+
+        src += count;
+        bytes -= static_cast<size_t>(count);
+    }
+
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <cstddef>
+#include <string_view>
+
+//Thin wrappers over stream sockets used by the server and the coordinator
+//Only available on unix, elsewhere opening a socket always fails
+namespace Net {
+
+    //Address is either "tcp:<port>" (loopback), "tcp:<host>:<port>" or a UNIX socket path
+    //Returns listening descriptor or -1, errors are printed to stderr
+    int Listen(const std::string& address);
+
+    //Address is "<host>:<port>", returns connected descriptor or -1
+    int Connect(const std::string& address);
+
+    //Accepts next client, retrying interrupted calls, -1 once the socket is shut down
+    int Accept(int listen_fd);
+
+    //Makes a blocked Accept return
+    void StopListening(int listen_fd);
+
+    //Closes the descriptor, removing the socket file of UNIX sockets
+    void CloseListener(int listen_fd, const std::string& address);
+
+    //Line based, bidirectional channel over file descriptors
+    class Connection{
+    public:
+        Connection(int in_fd, int out_fd, bool owns_fds);
+        ~Connection();
+
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        //Reading is not synchronized, only one thread may read
+        //Both fail at the end of the stream, on errors and when the receive timeout runs out
+        bool ReadLine(std::string& line);
+        bool ReadExact(void* data, size_t bytes);
+
+        //Reads fail once no data arrives for this long, zero waits forever
+        //Only applies to sockets, reads of pipes always wait
+        void SetReceiveTimeout(std::chrono::milliseconds timeout);
+
+        //Last failed read ran into the receive timeout
+        bool TimedOut() const {return m_TimedOut;}
+
+        //Line and payload are written as one message, also when called concurrently
+        bool Send(std::string_view line, const void* payload = nullptr, size_t bytes = 0);
+
+    private:
+        bool WriteAll(const void* data, size_t bytes);
+
+    private:
+        int m_In;
+        int m_Out;
+        bool m_OwnsFds;
+        bool m_TimedOut = false;
+
+        std::string m_Buffer;
+        std::mutex m_WriteMutex;
+    };
+}
@@ -1,9 +1,11 @@
 #include "ParseInput.h"
+#include "Pyramid.h"
 
 #include <expected>
 #include <vector>
 #include <map>
 #include <cctype>
+#include <algorithm>
 
 #include <fstream>
 #include <nlohmann/json.hpp>
@@ -97,11 +99,443 @@ static auto GetSimd(std::vector<std::string_view>& args)
     return ret;
 }
 
+static auto GetHugePages(std::vector<std::string_view>& args)
+    -> std::expected<Memory::HugePages, std::string>
+{
+    Memory::HugePages ret = Memory::HugePages::None;
+
+    bool already_set = false;
+
+    const std::map<std::string, Memory::HugePages> huge_page_options{
+        {"-HugePages",         Memory::HugePages::Transparent},
+        {"-HugePagesExplicit", Memory::HugePages::Explicit},
+    };
+
+    for (auto it = args.begin(); it != args.end();)
+    {
+        std::string opt(*it);
+
+        bool erase = false;
+
+        if (huge_page_options.count(opt))
+        {
+            if (already_set)
+            {
+                return std::unexpected("Huge pages flag can only be set once");
+            }
+
+            already_set = true;
+
+            ret = huge_page_options.at(opt);
+
+            erase = true;
+        }
+
+        if(erase)
+            args.erase(it);
+        else
+            ++it;
+    }
+
+    return ret;
+}
+
+//Removes a flag without a value, returns whether it was present
+static bool GetFlag(std::vector<std::string_view>& args, std::string_view flag)
+{
+    const auto it = std::find(args.begin(), args.end(), flag);
+
+    if (it == args.end())
+        return false;
+
+    args.erase(it);
+
+    return true;
+}
+
+static auto GetServe(std::vector<std::string_view>& args)
+    -> std::expected<std::optional<std::string>, std::string>
+{
+    std::optional<std::string> ret = std::nullopt;
+
+    for (auto it = args.begin(); it != args.end();)
+    {
+        bool erase = false;
+
+        if (*it == "-Serve")
+        {
+            if (ret.has_value())
+                return std::unexpected("Cannot set -Serve option more than once.");
+
+            if (it + 1 == args.end())
+                return std::unexpected("Option -Serve requires a socket path, or - for stdin");
+
+            ret = std::string(*(it + 1));
+
+            erase = true;
+        }
+
+        if (erase)
+            args.erase(it, it+2);
+        else
+            ++it;
+    }
+
+    return ret;
+}
+
+//Comma separated list of worker addresses
+static auto GetWorkers(std::vector<std::string_view>& args)
+    -> std::expected<std::vector<std::string>, std::string>
+{
+    std::vector<std::string> ret;
+
+    bool already_set = false;
+
+    for (auto it = args.begin(); it != args.end();)
+    {
+        bool erase = false;
+
+        if (*it == "-Coordinate")
+        {
+            if (already_set)
+                return std::unexpected("Cannot set -Coordinate option more than once.");
+
+            already_set = true;
+
+            if (it + 1 == args.end())
+                return std::unexpected("Option -Coordinate requires a list of workers <host>:<port>,...");
+
+            std::string_view list = *(it + 1);
+
+            while (!list.empty())
+            {
+                const size_t comma = std::min(list.find(','), list.size());
+
+                if (comma > 0)
+                    ret.push_back(std::string(list.substr(0, comma)));
+
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+
+            if (ret.empty())
+                return std::unexpected("Option -Coordinate requires at least one worker");
+
+            erase = true;
+        }
+
+        if (erase)
+            args.erase(it, it+2);
+        else
+            ++it;
+    }
+
+    return ret;
+}
+
+static void ReadConfig(const json& data, ProgramArgs& res)
+{
+    auto RetrieveGenerator = [](const std::string& token)
+    {
+        const std::map<std::string, FractalGenerator> map{
+            {"SmoothIter",  FractalGenerator::SmoothIter},
+            {"Gradient",    FractalGenerator::Gradient},
+            {"BurningShip", FractalGenerator::BurningShip},
+            {"Tricorn",     FractalGenerator::Tricorn},
+            {"Multibrot3",  FractalGenerator::Multibrot3},
+            {"Multibrot4",  FractalGenerator::Multibrot4},
+            {"Julia",       FractalGenerator::Julia}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveColoring = [](const std::string& token)
+    {
+        using namespace Image;
+
+        const std::map<std::string, ImageColoring> map{
+            {"IterToColorIQ",   ImageColoring::IterToColorIQ},
+            {"NormedGrayscale", ImageColoring::NormedGrayscale},
+            {"ColorHSV",        ImageColoring::ColorHSV}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveMode = [](const std::string& token)
+    {
+        const std::map<std::string, RenderMode> map{
+            {"Frames", RenderMode::Frames},
+            {"ExpMap", RenderMode::ExpMap},
+            {"Stream", RenderMode::Stream},
+            {"Recolor", RenderMode::Recolor},
+            {"Pyramid", RenderMode::Pyramid},
+            {"Deadline", RenderMode::Deadline},
+            {"Buddhabrot", RenderMode::Buddhabrot}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveFormat = [](const std::string& token)
+    {
+        using namespace Image;
+
+        const std::map<std::string, StreamFormat> map{
+            {"PNG", StreamFormat::PNG},
+            {"PPM", StreamFormat::PPM}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveDataFormat = [](const std::string& token)
+    {
+        const std::map<std::string, DataFormat> map{
+            {"Float",     DataFormat::Float},
+            {"Half",      DataFormat::Half},
+            {"Quantized", DataFormat::Quantized}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveDataLayout = [](const std::string& token)
+    {
+        const std::map<std::string, DataLayout> map{
+            {"RowMajor", DataLayout::RowMajor},
+            {"Tiled",    DataLayout::Tiled},
+            {"Morton",   DataLayout::Morton}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveSampling = [](const std::string& token)
+    {
+        using namespace Buddhabrot;
+
+        const std::map<std::string, Sampling> map{
+            {"Uniform",    Sampling::Uniform},
+            {"Metropolis", Sampling::Metropolis}
+        };
+
+        return map.at(token);
+    };
+
+    auto RetrieveCostMap = [](const std::string& token)
+    {
+        const std::map<std::string, CostMapOutput> map{
+            {"None",    CostMapOutput::None},
+            {"Heatmap", CostMapOutput::Heatmap},
+            {"Raw",     CostMapOutput::Raw}
+        };
+
+        return map.at(token);
+    };
+
+    res.Width = data.at("Image Width");
+    res.Height = data.at("Image Height");
+    res.NumFrames = data.at("Num Frames");
+
+    res.CenterX = data.at("Image Center").at(0);
+    res.CenterY = data.at("Image Center").at(1);
+    res.InitialWidth = data.at("Initial Width");
+    res.ZoomSpeed = data.at("Zoom Speed");
+
+    res.Generator = RetrieveGenerator(data.at("Generator"));
+    res.Coloring = RetrieveColoring(data.at("Coloring"));
+
+    if (data.contains("Julia Constant"))
+    {
+        res.Formula.JuliaRe = data["Julia Constant"].at(0);
+        res.Formula.JuliaIm = data["Julia Constant"].at(1);
+    }
+
+    if (data.contains("Render Mode"))
+        res.Mode = RetrieveMode(data["Render Mode"]);
+
+    if (data.contains("Band Height"))
+        res.BandHeight = data["Band Height"];
+
+    if (data.contains("Pyramid Levels"))
+        res.PyramidLevels = data["Pyramid Levels"];
+
+    if (data.contains("Tile Size"))
+        res.TileSize = data["Tile Size"];
+
+    if (data.contains("Pyramid Directory"))
+        res.PyramidDirectory = data["Pyramid Directory"];
+
+    if (data.contains("Time Budget"))
+        res.TimeBudget = data["Time Budget"];
+
+    if (data.contains("Coarse Step"))
+        res.CoarseStep = data["Coarse Step"];
+
+    if (data.contains("Samples"))
+        res.OrbitParams.Samples = data["Samples"];
+
+    if (data.contains("Min Iterations"))
+        res.OrbitParams.MinIterations = data["Min Iterations"];
+
+    if (data.contains("Max Iterations"))
+        res.OrbitParams.MaxIterations = data["Max Iterations"];
+
+    if (data.contains("Sampling"))
+        res.OrbitParams.Mode = RetrieveSampling(data["Sampling"]);
+
+    if (data.contains("Histogram Shards"))
+        res.OrbitParams.Shards = data["Histogram Shards"];
+
+    if (data.contains("Seed"))
+        res.OrbitParams.Seed = data["Seed"];
+
+    if (data.contains("Output Format"))
+        res.OutputFormat = RetrieveFormat(data["Output Format"]);
+
+    if (data.contains("Data Format"))
+    {
+        res.Format = RetrieveDataFormat(data["Data Format"]);
+        res.KeepData |= (res.Format != DataFormat::Float);
+    }
+
+    if (data.contains("Data Layout"))
+    {
+        res.Layout = RetrieveDataLayout(data["Data Layout"]);
+        res.KeepData |= (res.Layout != DataLayout::RowMajor);
+    }
+
+    if (data.contains("Equalize"))
+    {
+        res.Equalize = data["Equalize"];
+        res.KeepData |= res.Equalize;
+    }
+
+    if (data.contains("Equalize Smoothing"))
+        res.EqualizeSmoothing = data["Equalize Smoothing"];
+
+    if (data.contains("Cost Map"))
+    {
+        res.CostMap = RetrieveCostMap(data["Cost Map"]);
+        res.KeepData |= (res.CostMap != CostMapOutput::None);
+    }
+
+    if (data.contains("Dump Data"))
+    {
+        res.DumpData = data["Dump Data"];
+        res.KeepData |= res.DumpData;
+    }
+
+    if (data.contains("Pan Step"))
+    {
+        res.PanStep = {data["Pan Step"].at(0), data["Pan Step"].at(1)};
+        res.KeepData = true;
+    }
+
+    if (data.contains("Tile Cache"))
+    {
+        res.TileCacheDir = data["Tile Cache"];
+        res.KeepData = true;
+    }
+
+    if (data.contains("Tile Cache Size"))
+        res.TileCacheMegabytes = data["Tile Cache Size"];
+
+    if (data.contains("Render Tile Size"))
+        res.RenderTileSize = data["Render Tile Size"];
+
+    if (data.contains("Checkpoint"))
+        res.CheckpointFile = data["Checkpoint"];
+
+    if (data.contains("Trace"))
+        res.TraceFile = data["Trace"];
+
+    if (data.contains("Perf Counters"))
+        res.PerfCounters = data["Perf Counters"];
+}
+
+//Checks of values which parse fine, but which the renderers cannot handle
+static std::optional<std::string> ValidateConfig(const ProgramArgs& res)
+{
+    if (res.Mode == RenderMode::Pyramid)
+    {
+        if (res.PyramidLevels > Pyramid::MaxLevelLimit)
+            return "Pyramid Levels must not exceed " + std::to_string(Pyramid::MaxLevelLimit);
+
+        const uint32_t distinct = Pyramid::MaxDistinctLevel(Pyramid::PyramidParams{
+            .CenterX  = res.CenterX,
+            .CenterY  = res.CenterY,
+            .Width    = res.InitialWidth,
+            .MaxLevel = res.PyramidLevels,
+            .TileSize = res.TileSize
+        });
+
+        if (res.PyramidLevels > distinct)
+            return "Pyramid Levels must not exceed " + std::to_string(distinct)
+                 + " for this region, deeper pixels are not distinct in float precision";
+    }
+
+    //Options of the Frames mode which only some of its paths honour, rejected instead of silently ignored
+    if (res.Mode == RenderMode::Frames)
+    {
+        //Costs are only recorded by full generation of row-major float frames
+        if (res.CostMap != CostMapOutput::None)
+        {
+            if (res.Format != DataFormat::Float)
+                return "Cost Map requires \"Data Format\" : \"Float\"";
+
+            if (res.Layout != DataLayout::RowMajor)
+                return "Cost Map requires \"Data Layout\" : \"RowMajor\"";
+
+            if (res.PanStep.has_value() || res.TileCacheDir.has_value())
+                return "Cost Map cannot be combined with Pan Step or Tile Cache, their frames are only partly generated";
+        }
+
+        //Shifting the previous frame needs it as floats, and takes precedence over the tile cache
+        if (res.PanStep.has_value())
+        {
+            if (res.Format != DataFormat::Float)
+                return "Pan Step requires \"Data Format\" : \"Float\"";
+
+            if (res.TileCacheDir.has_value())
+                return "Pan Step cannot be combined with Tile Cache";
+        }
+
+        //Cached tiles are stored as floats
+        if (res.TileCacheDir.has_value() && res.Format != DataFormat::Float)
+            return "Tile Cache requires \"Data Format\" : \"Float\"";
+
+        //Only full generation of float frames writes tiled layouts
+        if (res.Layout != DataLayout::RowMajor)
+        {
+            if (res.Format != DataFormat::Float)
+                return "Data Layout other than RowMajor requires \"Data Format\" : \"Float\"";
+
+            if (res.PanStep.has_value() || res.TileCacheDir.has_value())
+                return "Data Layout other than RowMajor cannot be combined with Pan Step or Tile Cache";
+        }
+    }
+
+    if (res.Equalize)
+    {
+        if (res.Mode != RenderMode::Frames && res.Mode != RenderMode::ExpMap)
+            return "Equalize is only supported in Frames and ExpMap render modes";
+
+        //Frames skipped on resume would be missing from the smoothed distribution
+        if (res.EqualizeSmoothing > 0.0f && res.CheckpointFile.has_value())
+            return "Equalize Smoothing cannot be combined with Checkpoint";
+    }
+
+    return std::nullopt;
+}
+
 ProgramArgs ParseInput(int argc, char* argv[])
 {
     ProgramArgs res;
 
-    constexpr int max_supported_args = 4;
+    constexpr int max_supported_args = 9;
 
     if (argc > max_supported_args + 1)
     {
@@ -131,6 +565,57 @@ ProgramArgs ParseInput(int argc, char* argv[])
         return res;
     }
 
+    const auto huge_pages = GetHugePages(args);
+
+    if (huge_pages.has_value())
+        res.HugePages = huge_pages.value();
+    else
+    {
+        res.ExitMessage = huge_pages.error();
+        return res;
+    }
+
+    res.Autotune = GetFlag(args, "-Autotune");
+    res.PinThreads = GetFlag(args, "-PinThreads");
+
+    const auto serve = GetServe(args);
+
+    if (serve.has_value())
+        res.ServeSocket = serve.value();
+    else
+    {
+        res.ExitMessage = serve.error();
+        return res;
+    }
+
+    const auto workers = GetWorkers(args);
+
+    if (workers.has_value())
+        res.Workers = workers.value();
+    else
+    {
+        res.ExitMessage = workers.error();
+        return res;
+    }
+
+    if (res.ServeSocket.has_value() && !res.Workers.empty())
+    {
+        res.ExitMessage = "Options -Serve and -Coordinate cannot be combined";
+        return res;
+    }
+
+    //Server reads configs of individual jobs from its clients
+    if (res.ServeSocket.has_value())
+    {
+        if (args.size() != 0)
+            res.ExitMessage = "Server mode does not accept a json file";
+
+        return res;
+    }
+
+    if (args.size() == 0 && res.Autotune)
+        return res;
+
     if (args.size() == 0)
     {
         res.ExitMessage = "Missing parameter: path to json file";
@@ -145,6 +630,8 @@ ProgramArgs ParseInput(int argc, char* argv[])
 
     std::string filename(args[0]);
 
+    res.ConfigFile = filename;
+
     std::ifstream file(filename);
 
     if (file)
@@ -153,47 +640,17 @@ ProgramArgs ParseInput(int argc, char* argv[])
         {
             json data = json::parse(file);
 
-            auto RetrieveGenerator = [](const std::string& token)
-            {
-                const std::map<std::string, FractalGenerator> map{
-                    {"SmoothIter", FractalGenerator::SmoothIter},
-                    {"Gradient",   FractalGenerator::Gradient}
-                };
-
-                return map.at(token);
-            };
-
-            auto RetrieveColoring = [](const std::string& token)
-            {
-                using namespace Image;
-
-                const std::map<std::string, ImageColoring> map{
-                    {"IterToColorIQ",   ImageColoring::IterToColorIQ},
-                    {"NormedGrayscale", ImageColoring::NormedGrayscale},
-                    {"ColorHSV",        ImageColoring::ColorHSV}
-                };
-
-                return map.at(token);
-            };
-
-            res.Width = data["Image Width"];
-            res.Height = data["Image Height"];
-            res.NumFrames = data["Num Frames"];
-
-            res.CenterX = data["Image Center"][0];
-            res.CenterY = data["Image Center"][1];
-            res.InitialWidth = data["Initial Width"];
-            res.ZoomSpeed = data["Zoom Speed"];
-
-            res.Generator = RetrieveGenerator(data["Generator"]);
-            res.Coloring = RetrieveColoring(data["Coloring"]);
+            ReadConfig(data, res);
         }
 
-        catch(const json::exception& e)
+        catch(const std::exception& e)
         {
             res.ExitMessage = "Unable to parse json file:\n" + std::string(e.what());
             return res;
         }
+
+        if (const auto error = ValidateConfig(res))
+            res.ExitMessage = error.value();
     }
 
     else
@@ -205,6 +662,29 @@ ProgramArgs ParseInput(int argc, char* argv[])
     return res;
 }
 
+ProgramArgs ParseConfig(std::string_view text)
+{
+    ProgramArgs res;
+
+    try
+    {
+        const json data = json::parse(text);
+
+        ReadConfig(data, res);
+    }
+
+    catch(const std::exception& e)
+    {
+        res.ExitMessage = "Unable to parse json:\n" + std::string(e.what());
+        return res;
+    }
+
+    if (const auto error = ValidateConfig(res))
+        res.ExitMessage = error.value();
+
+    return res;
+}
+
 static bool IsDigit(char ch)
 {
     return std::isdigit(static_cast<unsigned char>(ch));
@@ -1,14 +1,39 @@
 #pragma once
 
+#include <array>
+#include <vector>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <cstdint>
 
 #include "SimdType.h"
+#include "Memory.h"
+#include "DataFormat.h"
+#include "DataLayout.h"
+#include "Buddhabrot.h"
 
 #include "ComputeFractal.h"
 #include "Image.h"
+#include "ImageStream.h"
+
+enum class RenderMode{
+    Frames,
+    ExpMap,
+    Stream,
+    Recolor,
+    Pyramid,
+    Deadline,
+    Buddhabrot
+};
+
+enum class CostMapOutput{
+    None,
+    //Heatmap image of executed iterations
+    Heatmap,
+    //Executed iterations as raw 16 bit little endian values
+    Raw
+};
 
 struct ProgramArgs{
     uint32_t Width;
@@ -23,10 +48,93 @@ struct ProgramArgs{
     FractalGenerator Generator;
     Image::ImageColoring Coloring;
 
+    //Runtime inputs of the generator, e.g. the Julia constant
+    FormulaParams Formula;
+
+    RenderMode Mode = RenderMode::Frames;
+
+    //Only used by the streaming mode
+    uint32_t BandHeight = 256;
+    Image::StreamFormat OutputFormat = Image::StreamFormat::PNG;
+
+    //Only used by the pyramid export, region is given by center and initial width
+    uint32_t PyramidLevels = 5;
+    uint32_t TileSize = 256;
+    std::string PyramidDirectory = "tiles";
+
+    //Only used by the deadline mode, time budget of a frame in milliseconds
+    //and sample spacing of its first pass
+    float TimeBudget = 33.0f;
+    uint32_t CoarseStep = 8;
+
+    //Only used by the Buddhabrot mode, see Buddhabrot.h
+    Buddhabrot::BuddhabrotParams OrbitParams;
+
+    //Set when some stage consumes raw generator output,
+    //otherwise frames are generated and colored tile by tile
+    bool KeepData = false;
+
+    //Storage of the generator output buffer, compact formats imply KeepData
+    DataFormat Format = DataFormat::Float;
+
+    //Pixel order of the float generator output buffer, tiled layouts imply KeepData
+    //Frames are de-tiled once before later stages, panned and cached frames stay row-major
+    DataLayout Layout = DataLayout::RowMajor;
+
+    //Histogram-equalize generator output before coloring, implies KeepData
+    //Smoothing is the weight of earlier frames' distribution, see Equalize.h
+    bool Equalize = false;
+    float EqualizeSmoothing = 0.0f;
+
+    //Save iterations executed for every pixel next to the image, implies KeepData
+    CostMapOutput CostMap = CostMapOutput::None;
+
+    //Save generator output of every frame next to the image, implies KeepData
+    bool DumpData = false;
+
+    //Viewport movement per frame in pixels (x right, y up), implies KeepData
+    //Frames after the first one reuse the overlapping part of the previous frame
+    std::optional<std::array<int32_t, 2>> PanStep;
+
+    //Directory of persistent tile cache, implies KeepData
+    std::optional<std::string> TileCacheDir;
+    uint32_t TileCacheMegabytes = 1024;
+
+    //Journal of finished frames and bands, a restarted run skips them
+    std::optional<std::string> CheckpointFile;
+
+    //Timeline of frames, stages, tiles and jobs in Chrome trace format
+    std::optional<std::string> TraceFile;
+
+    //Hardware counters per stage and worker thread, printed after every frame
+    bool PerfCounters = false;
+
     std::optional<uint32_t> NumJobs;
     std::optional<SimdType> Simd;
+    Memory::HugePages HugePages = Memory::HugePages::None;
+
+    //Pin worker threads and place frame buffers on the NUMA nodes of their workers
+    bool PinThreads = false;
+
+    //Side length of tiles of the tiled render paths, "Render Tile Size" in the config,
+    //otherwise taken from the tuning profile, otherwise the ExecutionPolicy default
+    std::optional<size_t> RenderTileSize;
+
+    //Tune execution parameters and overwrite the profile, even if one exists
+    //Without a json file, the program exits after tuning
+    bool Autotune = false;
+    
+    //Socket path of the render server, "-" serves stdin/stdout
+    std::optional<std::string> ServeSocket;
+
+    //Render servers the frames are distributed to, as "<host>:<port>"
+    std::vector<std::string> Workers;
+    std::string ConfigFile;
     
     std::optional<std::string> ExitMessage;
 };
 
-ProgramArgs ParseInput(int argc, char* argv[]);
\ No newline at end of file
+ProgramArgs ParseInput(int argc, char* argv[]);
+
+//Reads a single config in the json file schema, execution flags are left unset
+ProgramArgs ParseConfig(std::string_view text);
\ No newline at end of file
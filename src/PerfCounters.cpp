@@ -0,0 +1,392 @@
+#include "PerfCounters.h"
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace Perf {
+
+    struct StageRecord{
+        std::string Name;
+        Counts Total;
+        std::vector<Counts> Threads;
+    };
+
+    static bool s_Enabled = false;
+    static std::array<bool, NumCounters> s_Available{};
+
+    static std::atomic<bool> s_StageRunning{false};
+
+    static std::mutex s_Mutex;
+    //Stages of the current frame, in order of their first appearance
+    static std::vector<StageRecord> s_Stages;
+    static size_t s_CurrentStage = 0;
+
+    static constexpr std::array<const char*, NumCounters> CounterNames{
+        "cycles", "instructions", "branch misses", "L1D misses", "LLC misses", "FP instructions", "cpu time"
+    };
+
+    Counts& Counts::operator+=(const Counts& other)
+    {
+        for (size_t i = 0; i < NumCounters; i++)
+        {
+            Values[i] += other.Values[i];
+            Valid[i] = Valid[i] || other.Valid[i];
+        }
+
+        return *this;
+    }
+
+#ifdef __linux__
+
+    static bool IsIntel()
+    {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+
+        while (std::getline(cpuinfo, line))
+        {
+            if (line.starts_with("vendor_id"))
+                return line.find("GenuineIntel") != std::string::npos;
+        }
+
+        return false;
+    }
+
+    static perf_event_attr GetAttributes(Counter c, bool inherit)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.inherit = inherit ? 1 : 0;
+        //User space only, so that the default paranoid level 2 still allows it
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        //More events than hardware counters get multiplexed, the times allow scaling
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        auto CacheMiss = [](uint64_t cache)
+        {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+
+        switch (c)
+        {
+            case Cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case Instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case BranchMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case L1DMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = CacheMiss(PERF_COUNT_HW_CACHE_L1D);
+                break;
+            case LLCMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = CacheMiss(PERF_COUNT_HW_CACHE_LL);
+                break;
+            case FPInstructions:
+                //FP_ARITH_INST_RETIRED with all umask bits (Skylake and later)
+                attr.type = PERF_TYPE_RAW;
+                attr.config = 0xffc7;
+                break;
+            case TaskClock:
+            case NumCounters:
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_TASK_CLOCK;
+                break;
+        }
+
+        return attr;
+    }
+
+    static int Open(Counter c, bool inherit)
+    {
+        perf_event_attr attr = GetAttributes(c, inherit);
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    class CounterGroup{
+    public:
+        CounterGroup(bool inherit)
+        {
+            m_Fds.fill(-1);
+
+            for (size_t i = 0; i < NumCounters; i++)
+            {
+                if (s_Available[i])
+                    m_Fds[i] = Open(static_cast<Counter>(i), inherit);
+            }
+
+            for (const int fd : m_Fds)
+            {
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        ~CounterGroup()
+        {
+            for (const int fd : m_Fds)
+            {
+                if (fd >= 0)
+                    close(fd);
+            }
+        }
+
+        //Inherited counts include the threads started since opening once they are joined
+        Counts Read() const
+        {
+            Counts res;
+
+            for (size_t i = 0; i < NumCounters; i++)
+            {
+                if (m_Fds[i] < 0)
+                    continue;
+
+                uint64_t data[3] = {0, 0, 0};
+
+                if (read(m_Fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+                    continue;
+
+                const double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+
+                res.Values[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * scale);
+                res.Valid[i] = true;
+            }
+
+            return res;
+        }
+
+    private:
+        std::array<int, NumCounters> m_Fds;
+    };
+
+    bool Enable()
+    {
+        const bool is_intel = IsIntel();
+
+        int first_error = 0;
+
+        for (size_t i = 0; i < NumCounters; i++)
+        {
+            const Counter c = static_cast<Counter>(i);
+
+            if (c == FPInstructions && !is_intel)
+                continue;
+
+            const int fd = Open(c, true);
+
+            if (fd >= 0)
+            {
+                s_Available[i] = true;
+                close(fd);
+            }
+
+            else if (first_error == 0)
+            {
+                first_error = errno;
+            }
+        }
+
+        s_Enabled = std::find(s_Available.begin(), s_Available.end(), true) != s_Available.end();
+
+        if (!s_Enabled)
+        {
+            std::cout << "Performance counters unavailable (" << std::strerror(first_error)
+                      << "), check kernel.perf_event_paranoid\n";
+        }
+
+        else if (!s_Available[Cycles] || !s_Available[Instructions])
+        {
+            std::cout << "Hardware performance counters unavailable (" << std::strerror(first_error)
+                      << "), only software counters will be reported\n";
+        }
+
+        return s_Enabled;
+    }
+
+#else
+
+    class CounterGroup{
+    public:
+        CounterGroup(bool) {}
+
+        Counts Read() const {return Counts{};}
+    };
+
+    bool Enable()
+    {
+        std::cout << "Performance counters are only available on Linux\n";
+        return false;
+    }
+
+#endif
+
+    bool IsEnabled()
+    {
+        return s_Enabled;
+    }
+
+    Stage::Stage(const char* name)
+    {
+        if (!s_Enabled || s_StageRunning.exchange(true))
+            return;
+
+        {
+            std::lock_guard lock(s_Mutex);
+
+            const auto it = std::find_if(s_Stages.begin(), s_Stages.end(),
+                [&](const StageRecord& r){return r.Name == name;});
+
+            m_Record = static_cast<size_t>(it - s_Stages.begin());
+
+            if (it == s_Stages.end())
+                s_Stages.push_back(StageRecord{.Name = name, .Total = {}, .Threads = {}});
+
+            s_CurrentStage = m_Record;
+        }
+
+        //Opened last, so that the bookkeeping above is not counted
+        m_Counters = std::make_unique<CounterGroup>(true);
+    }
+
+    Stage::~Stage()
+    {
+        if (m_Counters == nullptr)
+            return;
+
+        const Counts counts = m_Counters->Read();
+        m_Counters.reset();
+
+        {
+            std::lock_guard lock(s_Mutex);
+            s_Stages[m_Record].Total += counts;
+        }
+
+        s_StageRunning = false;
+    }
+
+    ThreadScope::ThreadScope(size_t index)
+        : m_Index(index)
+    {
+        if (!s_Enabled || !s_StageRunning)
+            return;
+
+        {
+            std::lock_guard lock(s_Mutex);
+            m_Record = s_CurrentStage;
+        }
+
+        m_Counters = std::make_unique<CounterGroup>(false);
+    }
+
+    ThreadScope::~ThreadScope()
+    {
+        if (m_Counters == nullptr)
+            return;
+
+        const Counts counts = m_Counters->Read();
+        m_Counters.reset();
+
+        std::lock_guard lock(s_Mutex);
+
+        auto& threads = s_Stages[m_Record].Threads;
+
+        if (threads.size() <= m_Index)
+            threads.resize(m_Index + 1);
+
+        threads[m_Index] += counts;
+    }
+
+    //Counters missing on this machine are left out of the line
+    static void PrintCounts(const Counts& c, size_t pixels)
+    {
+        const char* separator = "";
+
+        auto Field = [&](const char* name)
+        {
+            std::cout << separator << name << ' ';
+            separator = ", ";
+        };
+
+        if (c.Valid[Cycles] && c.Values[Cycles] > 0)
+        {
+            const double cycles = static_cast<double>(c.Values[Cycles]);
+
+            if (c.Valid[Instructions])
+            {
+                Field("IPC");
+                std::cout << static_cast<double>(c.Values[Instructions]) / cycles;
+            }
+
+            Field("pixels/cycle");
+            std::cout << static_cast<double>(pixels) / cycles;
+        }
+
+        for (const Counter counter : {Cycles, Instructions, BranchMisses, L1DMisses, LLCMisses, FPInstructions})
+        {
+            if (!c.Valid[counter])
+                continue;
+
+            Field(CounterNames[counter]);
+            std::cout << static_cast<double>(c.Values[counter]) * 1e-6 << "M";
+        }
+
+        if (c.Valid[TaskClock])
+        {
+            Field("cpu time");
+            std::cout << static_cast<double>(c.Values[TaskClock]) * 1e-6 << "ms";
+        }
+
+        std::cout << '\n';
+    }
+
+    void PrintFrame(uint32_t frame, size_t pixels)
+    {
+        if (!s_Enabled)
+            return;
+
+        std::lock_guard lock(s_Mutex);
+
+        std::cout << "Counters of frame " << frame << ":\n" << std::setprecision(4);
+
+        for (const StageRecord& stage : s_Stages)
+        {
+            std::cout << "  " << stage.Name << ": ";
+            PrintCounts(stage.Total, pixels);
+
+            for (size_t i = 0; i < stage.Threads.size(); i++)
+            {
+                std::cout << "    thread " << i << ": ";
+                PrintCounts(stage.Threads[i], pixels / stage.Threads.size());
+            }
+        }
+
+        std::cout << std::setprecision(6);
+
+        s_Stages.clear();
+    }
+}
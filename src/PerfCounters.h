@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+//Hardware performance counters per stage and per worker thread (Linux perf_event_open)
+//A stage counts its own thread together with every worker it starts,
+//workers additionally count themselves, so imbalance between them shows up
+//Counters the machine, kernel or permissions (kernel.perf_event_paranoid) do not provide
+//are reported as n/a, when none is available the counting is switched off with a notice
+namespace Perf {
+
+    enum Counter{
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        //Retired floating point instructions, scalar and packed, only known on Intel
+        FPInstructions,
+        //Software counter, CPU time in nanoseconds, available even in most VMs
+        TaskClock,
+        NumCounters
+    };
+
+    struct Counts{
+        std::array<uint64_t, NumCounters> Values{};
+        std::array<bool, NumCounters> Valid{};
+
+        Counts& operator+=(const Counts& other);
+    };
+
+    //Open counters of one thread, optionally inherited by threads it starts
+    class CounterGroup;
+
+    //Probes which counters can be opened, returns false if there are none
+    bool Enable();
+    bool IsEnabled();
+
+    //Counts the calling thread and threads it starts, stages do not nest:
+    //a stage started while another one runs on some thread is ignored
+    class Stage{
+    public:
+        Stage(const char* name);
+        ~Stage();
+
+        Stage(const Stage&) = delete;
+        Stage& operator=(const Stage&) = delete;
+
+    private:
+        std::unique_ptr<CounterGroup> m_Counters;
+        size_t m_Record = 0;
+    };
+
+    //Counts a worker thread of the currently running stage, under given index
+    class ThreadScope{
+    public:
+        ThreadScope(size_t index);
+        ~ThreadScope();
+
+        ThreadScope(const ThreadScope&) = delete;
+        ThreadScope& operator=(const ThreadScope&) = delete;
+
+    private:
+        std::unique_ptr<CounterGroup> m_Counters;
+        size_t m_Record = 0;
+        size_t m_Index;
+    };
+
+    //Prints the stages recorded since the previous call, with IPC and pixels per cycle
+    void PrintFrame(uint32_t frame, size_t pixels);
+}
@@ -0,0 +1,374 @@
+#include "Pyramid.h"
+#include "Trace.h"
+#include "Checkpoint.h"
+
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <limits>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+typedef std::vector<Image::Pixel> TileImage;
+
+//Tiles are downsampled 2x2, so their side is rounded up to an even number
+static size_t RoundTileSize(size_t tile_size)
+{
+    return std::max<size_t>(2, tile_size + tile_size % 2);
+}
+
+namespace Pyramid {
+
+    class Exporter{
+    public:
+        Exporter(GenFunction f, Image::ColoringFn c, const PyramidParams& p, GenData::ExecutionPolicy e)
+            : m_Function(f), m_Coloring(c), m_Params(p), m_Policy(e),
+              m_TileSize(RoundTileSize(p.TileSize))
+        {}
+
+        PyramidStats Run();
+
+    private:
+        //Builds the tile and every tile below it, saving all of them
+        TileImage BuildTile(uint32_t z, uint32_t x, uint32_t y, AlignedVector<float>& scratch);
+
+        TileImage GenerateTile(uint32_t z, uint32_t x, uint32_t y, AlignedVector<float>& scratch);
+        void Downsample(const TileImage& child, TileImage& parent, uint32_t dx, uint32_t dy);
+
+        void Save(uint32_t z, uint32_t x, uint32_t y, const TileImage& tile);
+
+        //Hash of everything the recorded subtree roots depend on
+        uint64_t ProgressHash() const;
+        void PrepareProgress() const;
+
+        fs::path ProgressPath(uint32_t z, uint32_t x, uint32_t y) const;
+        bool LoadProgress(uint32_t z, uint32_t x, uint32_t y, TileImage& tile) const;
+        void StoreProgress(uint32_t z, uint32_t x, uint32_t y, const TileImage& tile) const;
+
+        size_t NumPixels() const {return m_TileSize * m_TileSize;}
+
+        //Number of tiles in a subtree rooted at level z
+        size_t SubtreeSize(uint32_t z) const;
+
+    private:
+        GenFunction m_Function;
+        Image::ColoringFn m_Coloring;
+        PyramidParams m_Params;
+        GenData::ExecutionPolicy m_Policy;
+        size_t m_TileSize;
+
+        std::atomic<size_t> m_Generated{0};
+        std::atomic<size_t> m_Downsampled{0};
+        std::atomic<size_t> m_Resumed{0};
+    };
+
+    uint32_t MaxDistinctLevel(const PyramidParams& p)
+    {
+        const float extent = std::max(std::abs(p.CenterX), std::abs(p.CenterY)) + 0.5f * p.Width;
+        const double resolution = std::nextafter(extent, std::numeric_limits<float>::infinity()) - extent;
+
+        const double tile_size = static_cast<double>(RoundTileSize(p.TileSize));
+
+        uint32_t z = 0;
+
+        while (z < MaxLevelLimit && std::ldexp(static_cast<double>(p.Width), -static_cast<int>(z + 1)) / tile_size >= resolution)
+            z++;
+
+        return z;
+    }
+
+    PyramidStats Export(GenFunction f, Image::ColoringFn c, const PyramidParams& p, GenData::ExecutionPolicy e)
+    {
+        Exporter exporter(f, c, p, e);
+        return exporter.Run();
+    }
+}
+
+Pyramid::PyramidStats Pyramid::Exporter::Run()
+{
+    const size_t num_threads = m_Policy.NumJobs.has_value()
+                             ? m_Policy.NumJobs.value()
+                             : std::thread::hardware_concurrency();
+
+    //Subtrees rooted at split level are the parallel tasks,
+    //there should be a few per thread for load balancing
+    uint32_t split_level = 0;
+
+    while (split_level < m_Params.MaxLevel && (size_t(1) << (2 * split_level)) < 4 * num_threads)
+        split_level++;
+
+    const uint32_t side = 1u << split_level;
+    const size_t num_tasks = size_t(side) * side;
+
+    PrepareProgress();
+
+    //Roots of the subtrees, needed for the levels above
+    std::vector<TileImage> roots(num_tasks);
+
+    std::atomic<size_t> next_task{0};
+
+    auto ProcessTasks = [&]()
+    {
+        AlignedVector<float> scratch(NumPixels());
+
+        for (size_t id = next_task++; id < num_tasks; id = next_task++)
+        {
+            const uint32_t x = static_cast<uint32_t>(id % side);
+            const uint32_t y = static_cast<uint32_t>(id / side);
+
+            if (LoadProgress(split_level, x, y, roots[id]))
+            {
+                m_Resumed += SubtreeSize(split_level);
+                continue;
+            }
+
+            roots[id] = BuildTile(split_level, x, y, scratch);
+
+            StoreProgress(split_level, x, y, roots[id]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < std::max<size_t>(1, num_threads); i++)
+        threads.push_back(std::thread(ProcessTasks));
+
+    for (auto& thread : threads)
+        thread.join();
+
+    //Remaining coarse levels hold few tiles, they are built from the roots serially
+    for (uint32_t z = split_level; z > 0; z--)
+    {
+        const uint32_t parent_side = 1u << (z - 1);
+
+        std::vector<TileImage> parents(size_t(parent_side) * parent_side);
+
+        for (uint32_t y = 0; y < parent_side; y++)
+        {
+            for (uint32_t x = 0; x < parent_side; x++)
+            {
+                TileImage& parent = parents[y * parent_side + x];
+                parent.resize(NumPixels());
+
+                for (uint32_t d = 0; d < 4; d++)
+                {
+                    const uint32_t dx = d % 2, dy = d / 2;
+                    Downsample(roots[(2 * y + dy) * (2 * parent_side) + 2 * x + dx], parent, dx, dy);
+                }
+
+                Save(z - 1, x, y, parent);
+                m_Downsampled++;
+            }
+        }
+
+        roots = std::move(parents);
+    }
+
+    std::error_code ec;
+    fs::remove_all(m_Params.Directory / ".progress", ec);
+
+    return PyramidStats{
+        .Generated = m_Generated,
+        .Downsampled = m_Downsampled,
+        .Resumed = m_Resumed
+    };
+}
+
+TileImage Pyramid::Exporter::BuildTile(uint32_t z, uint32_t x, uint32_t y, AlignedVector<float>& scratch)
+{
+    if (z == m_Params.MaxLevel)
+    {
+        TileImage tile = GenerateTile(z, x, y, scratch);
+        Save(z, x, y, tile);
+
+        return tile;
+    }
+
+    //Depth first, so only one child per level is alive at a time
+    TileImage tile(NumPixels());
+
+    for (uint32_t d = 0; d < 4; d++)
+    {
+        const uint32_t dx = d % 2, dy = d / 2;
+
+        const TileImage child = BuildTile(z + 1, 2 * x + dx, 2 * y + dy, scratch);
+        Downsample(child, tile, dx, dy);
+    }
+
+    Save(z, x, y, tile);
+    m_Downsampled++;
+
+    return tile;
+}
+
+TileImage Pyramid::Exporter::GenerateTile(uint32_t z, uint32_t x, uint32_t y, AlignedVector<float>& scratch)
+{
+    TRACE_ZONE("Tile", static_cast<int64_t>(z));
+
+    //Bounds are computed in double, so that tile origins deep down are not rounded to a coarser grid
+    const double width = static_cast<double>(m_Params.Width);
+    const double size = std::ldexp(width, -static_cast<int>(z));
+
+    const double left = static_cast<double>(m_Params.CenterX) - 0.5 * width + size * static_cast<double>(x);
+    const double top  = static_cast<double>(m_Params.CenterY) + 0.5 * width - size * static_cast<double>(y);
+
+    const GenData::FrameParams params{
+        .MinX   = static_cast<float>(left),
+        .MaxX   = static_cast<float>(left + size),
+        .MinY   = static_cast<float>(top - size),
+        .MaxY   = static_cast<float>(top),
+        .Width  = m_TileSize,
+        .Height = m_TileSize
+    };
+
+    //Tiles are the unit of parallelism, every one is generated on a single thread
+    const GenData::ExecutionPolicy policy{
+        .Simd = m_Policy.Simd,
+        .NumJobs = 1
+    };
+
+    GenData::GenerateFractal(scratch, m_Function, params, policy);
+
+    TileImage tile(NumPixels());
+    std::transform(scratch.begin(), scratch.end(), tile.begin(), m_Coloring);
+
+    m_Generated++;
+
+    return tile;
+}
+
+//Averages 2x2 blocks of the child into quadrant (dx, dy) of the parent
+void Pyramid::Exporter::Downsample(const TileImage& child, TileImage& parent, uint32_t dx, uint32_t dy)
+{
+    const size_t half = m_TileSize / 2;
+
+    for (size_t j = 0; j < half; j++)
+    {
+        const Image::Pixel* row0 = &child[(2 * j) * m_TileSize];
+        const Image::Pixel* row1 = row0 + m_TileSize;
+
+        Image::Pixel* dst = &parent[(dy * half + j) * m_TileSize + dx * half];
+
+        for (size_t i = 0; i < half; i++)
+        {
+            auto Average = [&](auto channel)
+            {
+                const uint32_t sum = row0[2*i].*channel + row0[2*i + 1].*channel
+                                   + row1[2*i].*channel + row1[2*i + 1].*channel;
+
+                return static_cast<uint8_t>((sum + 2) / 4);
+            };
+
+            dst[i] = Image::Pixel{
+                .r = Average(&Image::Pixel::r),
+                .g = Average(&Image::Pixel::g),
+                .b = Average(&Image::Pixel::b)
+            };
+        }
+    }
+}
+
+void Pyramid::Exporter::Save(uint32_t z, uint32_t x, uint32_t y, const TileImage& tile)
+{
+    const fs::path dir = m_Params.Directory / std::to_string(z) / std::to_string(x);
+
+    fs::create_directories(dir);
+
+    const Image::ImageInfo info{
+        .Width  = static_cast<uint32_t>(m_TileSize),
+        .Height = static_cast<uint32_t>(m_TileSize),
+        .Name   = (dir / (std::to_string(y) + ".png")).string()
+    };
+
+    Image::SaveImage(tile, info);
+}
+
+uint64_t Pyramid::Exporter::ProgressHash() const
+{
+    std::ostringstream params;
+    params << std::hexfloat << m_Params.CenterX << ' ' << m_Params.CenterY << ' ' << m_Params.Width << ' '
+           << m_Params.MaxLevel << ' ' << m_TileSize;
+
+    return Checkpoint::Hash(params.str(), m_Params.RenderHash);
+}
+
+//Progress of an export with other parameters would stitch the pyramid together from two renders,
+//so it is thrown away unless its recorded hash matches
+void Pyramid::Exporter::PrepareProgress() const
+{
+    const fs::path dir = m_Params.Directory / ".progress";
+    const fs::path params = dir / "params";
+
+    const uint64_t hash = ProgressHash();
+
+    uint64_t recorded = 0;
+
+    {
+        std::ifstream file(params);
+
+        if (!(file >> std::hex >> recorded) || recorded != hash)
+        {
+            std::error_code ec;
+            fs::remove_all(dir, ec);
+        }
+    }
+
+    fs::create_directories(dir);
+
+    std::ofstream(params) << std::hex << hash << '\n';
+}
+
+fs::path Pyramid::Exporter::ProgressPath(uint32_t z, uint32_t x, uint32_t y) const
+{
+    return m_Params.Directory / ".progress" / (std::to_string(z) + "-" + std::to_string(x) + "-" + std::to_string(y) + ".rgb");
+}
+
+//Subtree roots are kept as raw pixels, so that levels above can be built
+//without generating or decoding anything
+bool Pyramid::Exporter::LoadProgress(uint32_t z, uint32_t x, uint32_t y, TileImage& tile) const
+{
+    std::ifstream file(ProgressPath(z, x, y), std::ios::binary);
+
+    if (!file)
+        return false;
+
+    tile.resize(NumPixels());
+    file.read(reinterpret_cast<char*>(tile.data()), tile.size() * sizeof(Image::Pixel));
+
+    //Root has to fill the file exactly, anything else was not written for this tile size
+    return static_cast<size_t>(file.gcount()) == tile.size() * sizeof(Image::Pixel)
+        && file.peek() == std::ifstream::traits_type::eof();
+}
+
+void Pyramid::Exporter::StoreProgress(uint32_t z, uint32_t x, uint32_t y, const TileImage& tile) const
+{
+    const fs::path path = ProgressPath(z, x, y);
+
+    //Written under a temporary name, so that an interrupted write never counts as done
+    fs::path temp = path;
+    temp += ".tmp";
+
+    {
+        std::ofstream file(temp, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(Image::Pixel));
+
+        if (!file)
+            return;
+    }
+
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+}
+
+size_t Pyramid::Exporter::SubtreeSize(uint32_t z) const
+{
+    size_t res = 0;
+
+    for (uint32_t level = z; level <= m_Params.MaxLevel; level++)
+        res += size_t(1) << (2 * (level - z));
+
+    return res;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "ComputeFractal.h"
+#include "GenData.h"
+#include "Image.h"
+
+//Export of a square region as an XYZ (slippy map) tile pyramid:
+//level z consists of 2^z x 2^z tiles stored as <Directory>/<z>/<x>/<y>.png,
+//with y growing downwards
+//Only the deepest level is generated, every coarser tile is the 2x2 downsample
+//of its four children, so the whole pyramid costs about 4/3 of its deepest level
+//Subtrees are independent tasks, generated, encoded and written in parallel
+//Finished subtrees are recorded in <Directory>/.progress, so an interrupted export
+//resumes where it stopped; the record is removed once the pyramid is complete,
+//and discarded if it was written with different parameters
+namespace Pyramid {
+
+    //Deepest level accepted regardless of the region, level z holds 4^z tiles
+    constexpr uint32_t MaxLevelLimit = 20;
+
+    struct PyramidParams{
+        float CenterX;
+        float CenterY;
+        //Side length of the region, covered by the single tile of level 0
+        float Width;
+        uint32_t MaxLevel;
+        //Rounded up to an even number of pixels
+        size_t TileSize = 256;
+        std::filesystem::path Directory = "tiles";
+        //Identifies what is rendered besides the region (generator, formula, coloring, simd type),
+        //progress recorded with a different one is discarded
+        uint64_t RenderHash = 0;
+    };
+
+    struct PyramidStats{
+        size_t Generated = 0;
+        size_t Downsampled = 0;
+        //Tiles of subtrees finished by a previous run
+        size_t Resumed = 0;
+    };
+
+    //Deepest level whose pixels are still distinct in float coordinates everywhere in the region,
+    //below it neighbouring pixels of a tile would repeat the same point
+    uint32_t MaxDistinctLevel(const PyramidParams& p);
+
+    PyramidStats Export(GenFunction f, Image::ColoringFn c, const PyramidParams& p, GenData::ExecutionPolicy e);
+}
@@ -0,0 +1,627 @@
+#include "Render.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Topology.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <algorithm>
+
+size_t Render::GetTileSize(const GenData::ExecutionPolicy& e)
+{
+    //Keeping the tile width a multiple of 8 lets every tile row start on a vector boundary
+    return std::max<size_t>(8, e.TileSize - e.TileSize % 8);
+}
+
+size_t Render::GetBandHeight(const StreamParams& s, const GenData::ExecutionPolicy& e)
+{
+    const size_t tile_size = GetTileSize(e);
+
+    return std::max<size_t>(1, (s.BandHeight + tile_size - 1) / tile_size) * tile_size;
+}
+
+static size_t GetNumThreads(const GenData::ExecutionPolicy& e)
+{
+    if (e.NumJobs.has_value())
+        return e.NumJobs.value();
+    else
+        return std::thread::hardware_concurrency();
+}
+
+//Function receives index of the worker running it
+static void RunOnThreads(size_t num_threads, const std::function<void(size_t)>& fn, bool pin_threads = false)
+{
+    if (num_threads > 1)
+    {
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < num_threads; i++)
+        {
+            threads.push_back(std::thread([&fn, i, num_threads, pin_threads]()
+            {
+                if (pin_threads)
+                    Topology::PinWorker(i, num_threads);
+
+                Perf::ThreadScope counters(i);
+                fn(i);
+            }));
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    else
+    {
+        fn(0);
+    }
+}
+
+//Tiles [0, num_tiles) split into contiguous ranges, one per NUMA node, so that workers
+//mostly take tiles of the rows their own node first-touched
+//A worker whose node ran out of tiles takes the remaining ones of other nodes
+class NodeQueues{
+public:
+    NodeQueues(size_t num_tiles, size_t num_nodes)
+        : m_Queues(num_nodes)
+    {
+        for (size_t i = 0; i < num_nodes; i++)
+        {
+            m_Queues[i].Next = i * num_tiles / num_nodes;
+            m_Queues[i].End = (i + 1) * num_tiles / num_nodes;
+        }
+    }
+
+    std::optional<size_t> Next(size_t node)
+    {
+        for (size_t i = 0; i < m_Queues.size(); i++)
+        {
+            Queue& queue = m_Queues[(node + i) % m_Queues.size()];
+
+            if (queue.Next.load(std::memory_order_relaxed) >= queue.End)
+                continue;
+
+            const size_t id = queue.Next++;
+
+            if (id < queue.End)
+                return id;
+        }
+
+        return std::nullopt;
+    }
+
+private:
+    //Counters of different nodes do not share a cache line
+    struct alignas(64) Queue{
+        std::atomic<size_t> Next{0};
+        size_t End = 0;
+    };
+
+    std::vector<Queue> m_Queues;
+};
+
+//Generates a tile and colors it into dst, which points to the top left pixel
+//of the tile inside an image with rows of length stride
+static void ProcessTile(float* tile, Image::Pixel* dst, size_t stride, GenFunction f, Image::ColoringFn& c,
+                        const GenData::FrameParams& p, const GenData::TileRect& rect, SimdType simd)
+{
+    TRACE_ZONE("Tile");
+
+    GenData::GenerateTile(tile, f, p, rect, simd);
+
+    for (size_t j = 0; j < rect.Height; j++)
+    {
+        const float* src = &tile[j * rect.Width];
+        Image::Pixel* row = dst + j * stride;
+
+        for (size_t i = 0; i < rect.Width; i++)
+            row[i] = c(src[i]);
+    }
+}
+
+void Render::GenerateAndColor(std::span<Image::Pixel> image, GenFunction f, Image::ColoringFn c,
+                              GenData::FrameParams p, GenData::ExecutionPolicy e)
+{
+    const size_t tile_size = GetTileSize(e);
+
+    const size_t tiles_x = (p.Width + tile_size - 1) / tile_size;
+    const size_t tiles_y = (p.Height + tile_size - 1) / tile_size;
+    const size_t num_tiles = tiles_x * tiles_y;
+
+    const size_t num_threads = GetNumThreads(e);
+    const size_t num_nodes = e.PinThreads ? Topology::NumNodes() : 1;
+
+    NodeQueues queues(num_tiles, num_nodes);
+
+    auto ProcessTiles = [&](size_t worker)
+    {
+        AlignedVector<float> tile(tile_size * tile_size);
+
+        const size_t node = e.PinThreads ? Topology::NodeOfWorker(worker, num_threads) : 0;
+
+        for (std::optional<size_t> next = queues.Next(node); next.has_value(); next = queues.Next(node))
+        {
+            const size_t id = next.value();
+
+            const size_t x = (id % tiles_x) * tile_size;
+            const size_t y = (id / tiles_x) * tile_size;
+
+            const GenData::TileRect rect{
+                .X      = x,
+                .Y      = y,
+                .Width  = std::min(tile_size, p.Width - x),
+                .Height = std::min(tile_size, p.Height - y)
+            };
+
+            ProcessTile(tile.data(), &image[y * p.Width + x], p.Width, f, c, p, rect, e.Simd);
+        }
+    };
+
+    RunOnThreads(num_threads, ProcessTiles, e.PinThreads);
+}
+
+void Render::StreamBands(Image::StreamWriter& writer, GenFunction f, Image::ColoringFn c,
+                         GenData::FrameParams p, GenData::ExecutionPolicy e, StreamParams s)
+{
+    const size_t tile_size = GetTileSize(e);
+
+    const size_t band_height = GetBandHeight(s, e);
+    const size_t tiles_per_band = band_height / tile_size;
+
+    const size_t tiles_x = (p.Width + tile_size - 1) / tile_size;
+    const size_t num_bands = (p.Height + band_height - 1) / band_height;
+    const size_t tiles_in_band = tiles_x * tiles_per_band;
+    const size_t num_tiles = tiles_in_band * num_bands;
+
+    //Bands written before a restart
+    const size_t first_band = std::min<size_t>(writer.RowsWritten() / band_height, num_bands);
+
+    const size_t num_slots = std::max<size_t>(2, s.BandsInFlight);
+
+    std::vector<std::vector<Image::Pixel>> slots(num_slots, std::vector<Image::Pixel>(band_height * p.Width));
+    std::vector<size_t> tiles_done(num_slots, 0);
+
+    //Number of bands already handed to the writer, guarded by the mutex
+    size_t bands_written = first_band;
+
+    std::mutex mutex;
+    std::condition_variable band_finished, slot_freed;
+
+    std::atomic<size_t> next_tile{first_band * tiles_in_band};
+
+    auto ProcessTiles = [&](size_t)
+    {
+        AlignedVector<float> tile(tile_size * tile_size);
+
+        for (size_t id = next_tile++; id < num_tiles; id = next_tile++)
+        {
+            const size_t band = id / tiles_in_band;
+            const size_t local = id % tiles_in_band;
+            const size_t slot = band % num_slots;
+
+            {
+                //Time spent here means the writer is the bottleneck
+                TRACE_ZONE("Wait for free band", static_cast<int64_t>(band));
+
+                std::unique_lock lock(mutex);
+                slot_freed.wait(lock, [&]{return band < bands_written + num_slots;});
+            }
+
+            const size_t x = (local % tiles_x) * tile_size;
+            const size_t band_y = (local / tiles_x) * tile_size;
+            const size_t y = band * band_height + band_y;
+
+            //Tile rows past the bottom of the image are counted as done right away
+            if (y < p.Height)
+            {
+                const GenData::TileRect rect{
+                    .X      = x,
+                    .Y      = y,
+                    .Width  = std::min(tile_size, p.Width - x),
+                    .Height = std::min(tile_size, p.Height - y)
+                };
+
+                Image::Pixel* dst = &slots[slot][band_y * p.Width + x];
+                ProcessTile(tile.data(), dst, p.Width, f, c, p, rect, e.Simd);
+            }
+
+            {
+                std::lock_guard lock(mutex);
+
+                if (++tiles_done[slot] == tiles_in_band)
+                    band_finished.notify_all();
+            }
+        }
+    };
+
+    auto WriteBands = [&]()
+    {
+        for (size_t band = first_band; band < num_bands; band++)
+        {
+            const size_t slot = band % num_slots;
+
+            {
+                std::unique_lock lock(mutex);
+                band_finished.wait(lock, [&]{return tiles_done[slot] == tiles_in_band;});
+            }
+
+            const size_t rows = std::min(band_height, p.Height - band * band_height);
+
+            {
+                TRACE_ZONE("Write band", static_cast<int64_t>(band));
+
+                writer.WriteRows(slots[slot].data(), rows);
+
+                if (s.OnBandWritten)
+                    s.OnBandWritten(writer);
+            }
+
+            {
+                std::lock_guard lock(mutex);
+
+                tiles_done[slot] = 0;
+                bands_written++;
+            }
+
+            slot_freed.notify_all();
+        }
+    };
+
+    std::thread writer_thread(WriteBands);
+
+    RunOnThreads(GetNumThreads(e), ProcessTiles, e.PinThreads);
+
+    writer_thread.join();
+}
+
+Render::DeadlineStats Render::RenderWithDeadline(std::span<Image::Pixel> image, GenFunction f, Image::ColoringFn c,
+                                                 GenData::FrameParams p, GenData::ExecutionPolicy e, DeadlineParams d,
+                                                 std::stop_token stop)
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto start = clock::now();
+    const auto deadline = start + d.Budget;
+
+    const size_t tile_size = GetTileSize(e);
+
+    size_t coarse_step = 1;
+
+    while (coarse_step * 2 <= std::min(d.CoarseStep, tile_size))
+        coarse_step *= 2;
+
+    struct TileState{
+        GenData::TileRect Rect;
+        size_t Step;
+    };
+
+    std::vector<TileState> tiles;
+
+    for (size_t y = 0; y < p.Height; y += tile_size)
+    {
+        for (size_t x = 0; x < p.Width; x += tile_size)
+        {
+            const GenData::TileRect rect{
+                .X      = x,
+                .Y      = y,
+                .Width  = std::min(tile_size, p.Width - x),
+                .Height = std::min(tile_size, p.Height - y)
+            };
+
+            tiles.push_back(TileState{rect, coarse_step});
+        }
+    }
+
+    auto ShouldStop = [&]()
+    {
+        return stop.stop_requested() || clock::now() >= deadline;
+    };
+
+    //Computes the samples of the tile at given spacing and offset, every one colors
+    //the block of side block_size below and to the right of it
+    //Returns false if it stopped early, rows finished until then are kept
+    auto Sample = [&](float* scratch, const GenData::TileRect& rect, size_t step, size_t ox, size_t oy,
+                      size_t block_size, bool cancellable)
+    {
+        if (rect.Width <= ox || rect.Height <= oy)
+            return true;
+
+        const size_t nx = (rect.Width - ox + step - 1) / step;
+        const size_t ny = (rect.Height - oy + step - 1) / step;
+
+        for (size_t j = 0; j < ny; j++)
+        {
+            if (cancellable && ShouldStop())
+                return false;
+
+            //One row of samples at a time, so that the deadline is noticed quickly
+            const GenData::TileRect row{
+                .X      = rect.X,
+                .Y      = rect.Y + oy + j * step,
+                .Width  = rect.Width,
+                .Height = 1
+            };
+
+            GenData::GenerateSubgrid(scratch, f, p, row, step, ox, 0, e.Simd);
+
+            const size_t py = rect.Y + oy + j * step;
+            const size_t block_end_y = std::min(py + block_size, rect.Y + rect.Height);
+
+            for (size_t i = 0; i < nx; i++)
+            {
+                const Image::Pixel color = c(scratch[i]);
+
+                const size_t px = rect.X + ox + i * step;
+                const size_t block_end_x = std::min(px + block_size, rect.X + rect.Width);
+
+                for (size_t by = py; by < block_end_y; by++)
+                    std::fill(&image[by * p.Width + px], &image[by * p.Width + block_end_x], color);
+            }
+        }
+
+        return true;
+    };
+
+    //Average color difference of neighbouring samples, weighted by the area a refinement improves
+    auto GetPriority = [&](const TileState& tile)
+    {
+        const GenData::TileRect& r = tile.Rect;
+        const size_t step = tile.Step;
+
+        auto Difference = [](Image::Pixel a, Image::Pixel b)
+        {
+            return std::abs(int(a.r) - int(b.r)) + std::abs(int(a.g) - int(b.g)) + std::abs(int(a.b) - int(b.b));
+        };
+
+        double sum = 0.0;
+        size_t pairs = 0;
+
+        for (size_t y = r.Y; y < r.Y + r.Height; y += step)
+        {
+            for (size_t x = r.X; x < r.X + r.Width; x += step)
+            {
+                const Image::Pixel pixel = image[y * p.Width + x];
+
+                if (x + step < r.X + r.Width)
+                {
+                    sum += Difference(pixel, image[y * p.Width + x + step]);
+                    pairs++;
+                }
+
+                if (y + step < r.Y + r.Height)
+                {
+                    sum += Difference(pixel, image[(y + step) * p.Width + x]);
+                    pairs++;
+                }
+            }
+        }
+
+        const double contrast = (pairs > 0) ? sum / static_cast<double>(pairs) : 0.0;
+
+        //Flat tiles still get refined, coarsest first, once boundary tiles are done
+        return (contrast + 1.0) * static_cast<double>(step * step);
+    };
+
+    typedef std::pair<double, size_t> QueueEntry;
+
+    std::vector<QueueEntry> queue;
+    std::vector<double> priorities(tiles.size());
+
+    std::mutex mutex;
+    //Waits take the stop token, so that a stop request wakes waiting workers instead of leaving them until the deadline
+    std::condition_variable_any queue_changed;
+
+    size_t in_flight = 0;
+    bool cancelled = false;
+
+    std::atomic<size_t> next_tile{0};
+
+    //Coarse pass has to complete, otherwise there would be no image at all
+    auto CoarsePass = [&](size_t)
+    {
+        AlignedVector<float> scratch(tile_size);
+
+        for (size_t id = next_tile++; id < tiles.size(); id = next_tile++)
+        {
+            if (stop.stop_requested())
+                break;
+
+            Sample(scratch.data(), tiles[id].Rect, coarse_step, 0, 0, coarse_step, false);
+            priorities[id] = GetPriority(tiles[id]);
+        }
+    };
+
+    auto Refine = [&](size_t)
+    {
+        AlignedVector<float> scratch(tile_size);
+
+        while (true)
+        {
+            size_t id;
+
+            {
+                std::unique_lock lock(mutex);
+
+                //Tiles being refined may come back to the queue
+                queue_changed.wait_until(lock, stop, deadline, [&]{return !queue.empty() || in_flight == 0;});
+
+                if (queue.empty() || ShouldStop())
+                {
+                    cancelled |= !queue.empty() || in_flight > 0;
+                    break;
+                }
+
+                std::pop_heap(queue.begin(), queue.end());
+                id = queue.back().second;
+                queue.pop_back();
+
+                in_flight++;
+            }
+
+            TileState& tile = tiles[id];
+            const size_t half = tile.Step / 2;
+
+            bool finished = true;
+
+            for (const auto& [ox, oy] : {std::pair{half, size_t(0)}, std::pair{size_t(0), half}, std::pair{half, half}})
+                finished = finished && Sample(scratch.data(), tile.Rect, tile.Step, ox, oy, half, true);
+
+            if (finished)
+                tile.Step = half;
+
+            const double priority = (finished && half > 1) ? GetPriority(tile) : 0.0;
+
+            {
+                std::lock_guard lock(mutex);
+
+                if (finished && half > 1)
+                {
+                    queue.push_back(QueueEntry{priority, id});
+                    std::push_heap(queue.begin(), queue.end());
+                }
+
+                cancelled |= !finished;
+                in_flight--;
+            }
+
+            queue_changed.notify_all();
+        }
+
+        queue_changed.notify_all();
+    };
+
+    const size_t num_threads = GetNumThreads(e);
+
+    RunOnThreads(num_threads, CoarsePass, e.PinThreads);
+
+    if (coarse_step > 1)
+    {
+        for (size_t id = 0; id < tiles.size(); id++)
+            queue.push_back(QueueEntry{priorities[id], id});
+
+        std::make_heap(queue.begin(), queue.end());
+
+        RunOnThreads(num_threads, Refine, e.PinThreads);
+    }
+
+    size_t exact_pixels = 0;
+    size_t max_step = 1;
+
+    for (const TileState& tile : tiles)
+    {
+        if (tile.Step == 1)
+            exact_pixels += tile.Rect.Width * tile.Rect.Height;
+
+        max_step = std::max(max_step, tile.Step);
+    }
+
+    return DeadlineStats{
+        .Elapsed   = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start),
+        .Coverage  = static_cast<double>(exact_pixels) / static_cast<double>(std::max<size_t>(1, p.Width * p.Height)),
+        .Step      = max_step,
+        .Cancelled = cancelled || stop.stop_requested()
+    };
+}
+
+Generator<GenData::TileRect> Render::StreamTiles(std::span<float> data, GenFunction f, GenData::FrameParams p,
+                                                 GenData::ExecutionPolicy e, std::stop_token stop)
+{
+    const size_t tile_size = GetTileSize(e);
+
+    const size_t tiles_x = (p.Width + tile_size - 1) / tile_size;
+    const size_t tiles_y = (p.Height + tile_size - 1) / tile_size;
+    const size_t num_tiles = tiles_x * tiles_y;
+
+    //Even a single job runs on a background thread, so that the consumer is never blocked by it
+    const size_t num_threads = std::max<size_t>(1, GetNumThreads(e));
+
+    std::atomic<size_t> next_tile{0};
+
+    std::mutex mutex;
+    std::condition_variable tile_done;
+
+    //Finished tiles, consumed in order from the front
+    std::vector<GenData::TileRect> finished;
+    finished.reserve(num_tiles);
+
+    size_t consumed = 0;
+    size_t running = num_threads;
+
+    auto ProcessTiles = [&](std::stop_token cancel)
+    {
+        AlignedVector<float> tile(tile_size * tile_size);
+
+        for (size_t id = next_tile++; id < num_tiles; id = next_tile++)
+        {
+            if (cancel.stop_requested() || stop.stop_requested())
+                break;
+
+            const size_t tx = id % tiles_x;
+            const size_t ty = id / tiles_x;
+
+            const GenData::TileRect rect{
+                .X = tx * tile_size,
+                .Y = ty * tile_size,
+                .Width = std::min(tile_size, p.Width - tx * tile_size),
+                .Height = std::min(tile_size, p.Height - ty * tile_size)
+            };
+
+            TRACE_ZONE("Tile", static_cast<int64_t>(id));
+
+            GenData::GenerateTile(tile.data(), f, p, rect, e.Simd);
+
+            for (size_t j = 0; j < rect.Height; j++)
+            {
+                const float* src = &tile[j * rect.Width];
+                std::copy(src, src + rect.Width, &data[(rect.Y + j) * p.Width + rect.X]);
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                finished.push_back(rect);
+            }
+
+            tile_done.notify_one();
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            running--;
+        }
+
+        tile_done.notify_one();
+    };
+
+    //Declared after the shared state, so the threads are joined before it goes away,
+    //also when the consumer destroys the generator mid-frame
+    std::vector<std::jthread> workers;
+
+    //Destroyed first, asks all workers to stop before any of them is joined
+    struct StopAll{
+        std::vector<std::jthread>& Workers;
+        ~StopAll() {for (auto& worker : Workers) worker.request_stop();}
+    } stop_all{workers};
+
+    for (size_t i = 0; i < num_threads; i++)
+        workers.emplace_back(ProcessTiles);
+
+    while (!stop.stop_requested())
+    {
+        GenData::TileRect rect;
+
+        {
+            std::unique_lock lock(mutex);
+            tile_done.wait(lock, [&]{return consumed < finished.size() || running == 0;});
+
+            if (consumed == finished.size())
+                break;
+
+            rect = finished[consumed++];
+        }
+
+        co_yield rect;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <stop_token>
+
+#include "ComputeFractal.h"
+#include "GenData.h"
+#include "Image.h"
+#include "ImageStream.h"
+#include "Generator.h"
+
+namespace Render {
+    //Side of the square tiles of the tiled render paths, e.TileSize rounded down to a multiple of 8
+    size_t GetTileSize(const GenData::ExecutionPolicy& e);
+
+    //Generates the frame tile by tile and colors every tile while it is still in cache,
+    //so the full-frame float buffer is never written nor read back
+    //Tiles are square with side e.TileSize and are handed out to threads dynamically
+    void GenerateAndColor(std::span<Image::Pixel> image, GenFunction f, Image::ColoringFn c,
+                          GenData::FrameParams p, GenData::ExecutionPolicy e);
+
+    struct StreamParams{
+        //Height of a band, rounded up to whole tiles
+        size_t BandHeight = 256;
+        //Number of band buffers, workers can run this many bands ahead of the writer
+        size_t BandsInFlight = 3;
+        //Called on the writer thread after every band, e.g. to checkpoint writer state
+        std::function<void(Image::StreamWriter&)> OnBandWritten = nullptr;
+    };
+
+    //Height of the bands of StreamBands, s.BandHeight rounded up to whole tiles
+    size_t GetBandHeight(const StreamParams& s, const GenData::ExecutionPolicy& e);
+
+    //Renders the frame in horizontal bands and passes finished ones to the writer in order
+    //Peak memory is BandsInFlight * BandHeight * Width pixels, regardless of frame height
+    //Workers keep pulling tiles of later bands while earlier ones are being encoded,
+    //so there is no synchronization point at band boundaries
+    //Rows the writer already holds (when resuming) are not rendered again,
+    //BandHeight must be the same as when they were written
+    void StreamBands(Image::StreamWriter& writer, GenFunction f, Image::ColoringFn c,
+                     GenData::FrameParams p, GenData::ExecutionPolicy e, StreamParams s);
+
+    struct DeadlineParams{
+        std::chrono::microseconds Budget{33000};
+        //Sample spacing of the first pass, rounded down to a power of two no larger than the tile size
+        size_t CoarseStep = 8;
+    };
+
+    struct DeadlineStats{
+        std::chrono::microseconds Elapsed{0};
+        //Fraction of pixels computed at full resolution
+        double Coverage = 0.0;
+        //Sample spacing reached in every part of the frame, 1 is full resolution
+        size_t Step = 0;
+        //Refinement was cut short by the deadline or a stop request
+        bool Cancelled = false;
+    };
+
+    //Renders the best image possible within d.Budget: a pass with one sample per
+    //d.CoarseStep^2 block always completes, then tiles are refined by halving their
+    //sample spacing, tiles with most contrast (fractal boundary) first
+    //At the deadline, workers abandon their refinement after the current row of samples
+    //and every pixel shows its nearest computed sample above and to the left
+    DeadlineStats RenderWithDeadline(std::span<Image::Pixel> image, GenFunction f, Image::ColoringFn c,
+                                     GenData::FrameParams p, GenData::ExecutionPolicy e, DeadlineParams d,
+                                     std::stop_token stop = {});
+
+    //Generates the frame into data tile by tile on background threads, yielding every
+    //tile's rectangle as soon as its values are in place, in completion order
+    //Workers keep producing while the consumer handles earlier tiles
+    //Generation stops early when stop is requested or the generator is destroyed,
+    //no tiles are yielded after that; data must outlive the generator
+    Generator<GenData::TileRect> StreamTiles(std::span<float> data, GenFunction f, GenData::FrameParams p,
+                                             GenData::ExecutionPolicy e, std::stop_token stop = {});
+}
@@ -0,0 +1,427 @@
+#include "Server.h"
+
+#include "Engine.h"
+#include "ParseInput.h"
+#include "Net.h"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <condition_variable>
+
+#include <nlohmann/json.hpp>
+
+#include <csignal>
+#include <cstdio>
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+//Threads per job, when there are enough cores several jobs run side by side,
+//since small jobs do not scale well across many threads
+static constexpr size_t ThreadsPerJob = 4;
+
+//Scratch row width of the renderers, wider frames are processed in pieces
+static constexpr size_t MaxScratchWidth = 4096;
+
+//Header and payload are written as one message, also when jobs respond concurrently
+static void Send(Net::Connection& client, const json& header, const void* payload = nullptr, size_t bytes = 0)
+{
+    client.Send(header.dump(), payload, bytes);
+}
+
+struct Job{
+    ProgramArgs Args;
+    //Index of the first rendered frame in the zoom sequence
+    uint32_t FirstFrame = 0;
+    json Id;
+    bool Raw = false;
+    fs::path OutputDir;
+    std::shared_ptr<Net::Connection> Client;
+};
+
+class JobQueue{
+public:
+    //Returns false once the queue is closed
+    bool Push(Job job)
+    {
+        {
+            std::lock_guard lock(m_Mutex);
+
+            if (m_Closed)
+                return false;
+
+            m_Jobs.push_back(std::move(job));
+        }
+
+        m_Available.notify_one();
+        return true;
+    }
+
+    //Blocks until a job is available, returns nullopt when closed and drained
+    std::optional<Job> Pop()
+    {
+        std::unique_lock lock(m_Mutex);
+        m_Available.wait(lock, [&]{return !m_Jobs.empty() || m_Closed;});
+
+        if (m_Jobs.empty())
+            return std::nullopt;
+
+        Job job = std::move(m_Jobs.front());
+        m_Jobs.pop_front();
+
+        return job;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard lock(m_Mutex);
+            m_Closed = true;
+        }
+
+        m_Available.notify_all();
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Available;
+    std::deque<Job> m_Jobs;
+    bool m_Closed = false;
+};
+
+//Outlives Run, since detached client threads may still refer to it
+struct SharedState{
+    JobQueue Queue;
+    std::atomic<bool> ShutdownRequested{false};
+
+    size_t NumRunners = 1;
+    size_t ThreadsPerJob = 1;
+};
+
+static json ErrorResponse(const json& id, const std::string& message)
+{
+    return json{{"Id", id}, {"Status", "Error"}, {"Message", message}};
+}
+
+//Only frame by frame rendering runs in the server, other modes and the features
+//relying on the intermediate buffer are available from the command line
+//Jobs asking for anything RunJob does not honour are rejected rather than silently rendered without it
+static std::optional<std::string> CheckSupported(const ProgramArgs& args)
+{
+    if (args.Mode != RenderMode::Frames)
+        return "Only \"Frames\" render mode is supported by the server";
+
+    if (args.DumpData || args.TileCacheDir.has_value())
+        return "Data dumps and tile cache are not supported by the server";
+
+    if (args.Format != DataFormat::Float || args.Layout != DataLayout::RowMajor)
+        return "Data formats and layouts are not supported by the server";
+
+    if (args.Equalize)
+        return "Histogram equalization is not supported by the server";
+
+    if (args.CostMap != CostMapOutput::None)
+        return "Cost maps are not supported by the server";
+
+    if (args.CheckpointFile.has_value())
+        return "Checkpoints are not supported by the server";
+
+    if (args.TraceFile.has_value() || args.PerfCounters)
+        return "Tracing and performance counters are not supported by the server";
+
+    if (args.RenderTileSize.has_value())
+        return "Render tile size is chosen by the server";
+
+    if (args.Width == 0 || args.Height == 0)
+        return "Image size must be positive";
+
+    return std::nullopt;
+}
+
+//Moves to the next frame of the zoom sequence, same as the command line Frames mode
+static void AdvanceViewport(const ProgramArgs& args, float& half_ext, float& center_x, float& center_y)
+{
+    if (args.PanStep.has_value())
+    {
+        const float pixel_size = 2.0f * half_ext / static_cast<float>(args.Width);
+
+        center_x += pixel_size * static_cast<float>(args.PanStep.value()[0]);
+        center_y += pixel_size * static_cast<float>(args.PanStep.value()[1]);
+    }
+
+    half_ext *= args.ZoomSpeed;
+}
+
+static void RunJob(const Job& job, Engine::Renderer& renderer, std::vector<Image::Pixel>& image, SimdType simd)
+{
+    const ProgramArgs& args = job.Args;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const GenFunction gen_function = GetGeneratingFunction(args.Generator, args.Formula);
+    const Image::ColoringFn coloring_fn = Image::GetColoringFunction(args.Coloring);
+
+    const float aspect_ratio = static_cast<float>(args.Height)/static_cast<float>(args.Width);
+
+    float half_ext = 0.5f * args.InitialWidth;
+
+    float center_x = args.CenterX;
+    float center_y = args.CenterY;
+
+    //Grows to the largest frame seen, never shrinks
+    image.resize(std::max(image.size(), size_t(args.Width) * size_t(args.Height)));
+
+    json files = json::array();
+
+    for (uint32_t i=0; i<job.FirstFrame + args.NumFrames; i++)
+    {
+        //Frames before the first one only advance the viewport
+        if (i < job.FirstFrame)
+        {
+            AdvanceViewport(args, half_ext, center_x, center_y);
+            continue;
+        }
+
+        const Engine::Request request{
+            .Function = gen_function,
+            .Simd = simd,
+            .Frame = {
+                .MinX   = center_x - half_ext,
+                .MaxX   = center_x + half_ext,
+                .MinY   = center_y - aspect_ratio*half_ext,
+                .MaxY   = center_y + aspect_ratio*half_ext,
+                .Width  = args.Width,
+                .Height = args.Height
+            },
+            .Rect = {0, 0, args.Width, args.Height}
+        };
+
+        renderer.RenderPixels(image.data(), args.Width, request, coloring_fn);
+
+        const std::span<const Image::Pixel> frame(image.data(), size_t(args.Width) * size_t(args.Height));
+
+        if (job.Raw)
+        {
+            const json header{
+                {"Id", job.Id}, {"Frame", i},
+                {"Width", args.Width}, {"Height", args.Height},
+                {"Bytes", frame.size_bytes()}
+            };
+
+            Send(*job.Client, header, frame.data(), frame.size_bytes());
+        }
+
+        else
+        {
+            const Image::ImageInfo info{
+                .Width  = args.Width,
+                .Height = args.Height,
+                .Name   = (job.OutputDir / (std::to_string(i) + ".png")).string()
+            };
+
+            Image::SaveImage(frame, info);
+
+            files.push_back(info.Name);
+        }
+
+        AdvanceViewport(args, half_ext, center_x, center_y);
+    }
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    json response{{"Id", job.Id}, {"Status", "Done"}, {"Frames", args.NumFrames}, {"Milliseconds", elapsed.count()}};
+
+    if (!job.Raw)
+        response["Files"] = files;
+
+    Send(*job.Client, response);
+}
+
+static void RunJobs(JobQueue& queue, size_t num_threads, SimdType simd)
+{
+    //Kept alive for the whole lifetime of the server
+    ThreadPool pool(num_threads - 1);
+    Engine::Renderer renderer(pool, MaxScratchWidth);
+    std::vector<Image::Pixel> image;
+
+    while (auto job = queue.Pop())
+    {
+        try
+        {
+            RunJob(job.value(), renderer, image, simd);
+        }
+
+        catch(const std::exception& e)
+        {
+            Send(*job->Client, ErrorResponse(job->Id, e.what()));
+        }
+    }
+}
+
+//Reads requests until the client disconnects
+//Returns true if the client asked for shutdown
+static bool ServeClient(std::shared_ptr<Net::Connection> client, SharedState& state)
+{
+    uint64_t counter = 0;
+
+    std::string line;
+
+    while (client->ReadLine(line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        const json fallback_id = counter++;
+
+        json request;
+
+        try
+        {
+            request = json::parse(line);
+
+            if (!request.is_object())
+                throw std::runtime_error("Request must be a json object");
+
+            if (request.value("Shutdown", false))
+            {
+                Send(*client, json{{"Status", "Shutdown"}});
+                return true;
+            }
+
+            //Lets clients keep enough jobs in flight to occupy all runners
+            if (request.value("Info", false))
+            {
+                Send(*client, json{{"Status", "Info"}, {"Jobs", state.NumRunners}, {"Threads", state.ThreadsPerJob}});
+                continue;
+            }
+        }
+
+        catch(const std::exception& e)
+        {
+            Send(*client, ErrorResponse(fallback_id, "Unable to parse json:\n" + std::string(e.what())));
+            continue;
+        }
+
+        Job job{
+            .Args = ParseConfig(line),
+            .FirstFrame = 0,
+            .Id = request.contains("Id") ? request["Id"] : fallback_id,
+            .Raw = false,
+            .OutputDir = ".",
+            .Client = client
+        };
+
+        std::optional<std::string> error = job.Args.ExitMessage;
+
+        try
+        {
+            const std::string output = request.value("Output", "Files");
+
+            if (output != "Files" && output != "Raw")
+                throw std::runtime_error("Output must be \"Files\" or \"Raw\"");
+
+            job.Raw = (output == "Raw");
+            job.OutputDir = request.value("Output Directory", ".");
+            job.FirstFrame = request.value("First Frame", 0u);
+        }
+
+        catch(const std::exception& e)
+        {
+            error = e.what();
+        }
+
+        if (!error.has_value())
+            error = CheckSupported(job.Args);
+
+        if (error.has_value())
+        {
+            Send(*client, ErrorResponse(job.Id, error.value()));
+            continue;
+        }
+
+        const json id = job.Id;
+
+        if (!state.Queue.Push(std::move(job)))
+            Send(*client, ErrorResponse(id, "Server is shutting down"));
+    }
+
+    return false;
+}
+
+int Server::Run(const std::string& address, ServerParams p)
+{
+#ifdef SIGPIPE
+    //Clients going away mid-response must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    const size_t total_threads = std::max<size_t>(1, p.NumThreads);
+    const size_t num_runners = std::max<size_t>(1, total_threads / ThreadsPerJob);
+    const size_t threads_per_job = std::max<size_t>(1, total_threads / num_runners);
+
+    std::cerr << "Serving " << num_runners << " concurrent jobs, "
+              << threads_per_job << " threads each\n";
+
+    auto state = std::make_shared<SharedState>();
+    state->NumRunners = num_runners;
+    state->ThreadsPerJob = threads_per_job;
+
+    std::vector<std::thread> runners;
+
+    for (size_t i = 0; i < num_runners; i++)
+        runners.push_back(std::thread(RunJobs, std::ref(state->Queue), threads_per_job, p.Simd));
+
+    int exit_code = 0;
+
+    if (address == "-")
+    {
+        ServeClient(std::make_shared<Net::Connection>(fileno(stdin), fileno(stdout), false), *state);
+    }
+
+    else
+    {
+        const int listen_fd = Net::Listen(address);
+
+        if (listen_fd < 0)
+            exit_code = -1;
+
+        while (listen_fd >= 0 && !state->ShutdownRequested)
+        {
+            const int client_fd = Net::Accept(listen_fd);
+
+            if (client_fd < 0)
+                break;
+
+            auto client = std::make_shared<Net::Connection>(client_fd, client_fd, true);
+
+            //Clients are served independently, a reader blocked on an idle client
+            //must not keep the server from exiting, hence detached threads
+            std::thread([client, state, listen_fd]()
+            {
+                if (ServeClient(client, *state) && !state->ShutdownRequested.exchange(true))
+                    Net::StopListening(listen_fd);
+            }).detach();
+        }
+
+        //Keeps late shutdown requests from touching the closed descriptor
+        state->ShutdownRequested = true;
+
+        if (listen_fd >= 0)
+            Net::CloseListener(listen_fd, address);
+    }
+
+    state->Queue.Close();
+
+    for (auto& runner : runners)
+        runner.join();
+
+    return exit_code;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#include "SimdType.h"
+
+//Long running render server, accepting jobs in the json config schema
+//one per line, over a UNIX domain socket, TCP or stdin
+//Jobs are queued and several of them run at once, each on its own warm thread pool
+//Besides the config fields a job may contain:
+// "Id"               - echoed back in every response, defaults to a per-connection counter
+// "Output"           - "Files" (default) saves PNG frames, "Raw" sends RGB pixels back
+// "Output Directory" - where the frames are saved, defaults to the working directory
+// "First Frame"      - index in the zoom sequence of the first of "Num Frames" frames
+//Every response starts with a single json line, raw frames are followed by
+//"Bytes" bytes of pixel data; a job finishes with "Status" : "Done" or "Error"
+//A line {"Info" : true} is answered with the number of concurrent "Jobs" and their "Threads"
+//A line {"Shutdown" : true} stops the server after the queued jobs are finished
+namespace Server {
+
+    struct ServerParams{
+        SimdType Simd = SimdType::SSE;
+        //Threads shared by all jobs
+        size_t NumThreads = 1;
+    };
+
+    //Address is a UNIX socket path or "tcp:[<host>:]<port>" (see Net::Listen),
+    //"-" serves stdin/stdout until stdin is closed
+    //Returns process exit code
+    int Run(const std::string& address, ServerParams p);
+}
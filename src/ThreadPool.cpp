@@ -0,0 +1,78 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t num_workers)
+{
+    for (size_t i = 0; i < num_workers; i++)
+        m_Workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i + 1));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stop = true;
+    }
+
+    m_WorkReady.notify_all();
+
+    for (auto& worker : m_Workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, LoopFunction fn)
+{
+    std::lock_guard submit_lock(m_SubmitMutex);
+
+    {
+        std::lock_guard lock(m_Mutex);
+
+        m_Function = &fn;
+        m_Count = count;
+        m_Next = 0;
+        m_Busy = m_Workers.size();
+        m_Generation++;
+    }
+
+    m_WorkReady.notify_all();
+
+    //Calling thread always has id 0
+    RunIterations(0);
+
+    std::unique_lock lock(m_Mutex);
+    m_WorkDone.wait(lock, [&]{return m_Busy == 0;});
+
+    m_Function = nullptr;
+}
+
+void ThreadPool::WorkerLoop(size_t thread_id)
+{
+    uint64_t seen_generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(m_Mutex);
+            m_WorkReady.wait(lock, [&]{return m_Stop || m_Generation != seen_generation;});
+
+            if (m_Stop)
+                return;
+
+            seen_generation = m_Generation;
+        }
+
+        RunIterations(thread_id);
+
+        {
+            std::lock_guard lock(m_Mutex);
+
+            if (--m_Busy == 0)
+                m_WorkDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunIterations(size_t thread_id)
+{
+    for (size_t i = m_Next++; i < m_Count; i = m_Next++)
+        (*m_Function)(i, thread_id);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+#include "FunctionRef.h"
+
+//Fixed set of worker threads kept alive between calls
+//Work is submitted as a parallel loop over [0, count), indices are handed out
+//dynamically and the calling thread participates, so Size() + 1 threads run it
+//Submitting work does not allocate
+class ThreadPool{
+public:
+    //Function receives loop index and id of the thread running it, in [0, Size()]
+    typedef FunctionRef<void(size_t, size_t)> LoopFunction;
+
+    explicit ThreadPool(size_t num_workers = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const {return m_Workers.size();}
+
+    //Number of distinct thread ids passed to loop functions
+    size_t NumThreads() const {return m_Workers.size() + 1;}
+
+    //Blocks until all iterations finished
+    //Calls from multiple threads are serialized
+    void ParallelFor(size_t count, LoopFunction fn);
+
+private:
+    void WorkerLoop(size_t thread_id);
+    void RunIterations(size_t thread_id);
+
+private:
+    std::vector<std::thread> m_Workers;
+
+    std::mutex m_SubmitMutex;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkReady;
+    std::condition_variable m_WorkDone;
+
+    uint64_t m_Generation = 0;
+    size_t m_Busy = 0;
+    bool m_Stop = false;
+
+    LoopFunction* m_Function = nullptr;
+    size_t m_Count = 0;
+    std::atomic<size_t> m_Next{0};
+};
@@ -0,0 +1,460 @@
+#include "TileCache.h"
+
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+static constexpr char TileMagic[8] = {'C', 'F', 'T', 'I', 'L', 'E', '\0', '\0'};
+static constexpr const char* TileExtension = ".tile";
+
+//Packets start with 16 bit word, top bit set means a run of one repeated value,
+//otherwise a number of literal values follows
+static constexpr uint16_t RunFlag = 0x8000;
+static constexpr size_t MaxPacket = 0x7fff;
+static constexpr size_t MinRun = 3;
+
+//Once over the size cap, tiles are evicted until the cache is this fraction of it,
+//so that the LRU scan runs once per batch of stores instead of on every one
+static constexpr size_t EvictNumerator = 7;
+static constexpr size_t EvictDenominator = 8;
+
+static int64_t FloorDiv(int64_t a, int64_t b)
+{
+    const int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static uint32_t Bits(float value)
+{
+    uint32_t res;
+    std::memcpy(&res, &value, sizeof(res));
+    return res;
+}
+
+static std::vector<uint8_t> Compress(std::span<const float> data)
+{
+    std::vector<uint8_t> res;
+
+    auto PushWord = [&](uint16_t word)
+    {
+        res.push_back(static_cast<uint8_t>(word));
+        res.push_back(static_cast<uint8_t>(word >> 8));
+    };
+
+    auto PushValues = [&](const float* values, size_t count)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+        res.insert(res.end(), bytes, bytes + count * sizeof(float));
+    };
+
+    auto RunLength = [&](size_t start)
+    {
+        size_t len = 1;
+
+        while (start + len < data.size() && len < MaxPacket && Bits(data[start + len]) == Bits(data[start]))
+            len++;
+
+        return len;
+    };
+
+    size_t i = 0;
+
+    while (i < data.size())
+    {
+        const size_t run = RunLength(i);
+
+        if (run >= MinRun)
+        {
+            PushWord(static_cast<uint16_t>(RunFlag | run));
+            PushValues(&data[i], 1);
+            i += run;
+            continue;
+        }
+
+        size_t literal = 0;
+
+        while (i + literal < data.size() && literal < MaxPacket && RunLength(i + literal) < MinRun)
+            literal++;
+
+        PushWord(static_cast<uint16_t>(literal));
+        PushValues(&data[i], literal);
+        i += literal;
+    }
+
+    return res;
+}
+
+static bool Decompress(const uint8_t* src, size_t size, std::span<float> data)
+{
+    size_t pos = 0, out = 0;
+
+    while (pos + 2 <= size)
+    {
+        const uint16_t word = static_cast<uint16_t>(src[pos] | (src[pos + 1] << 8));
+        pos += 2;
+
+        const size_t count = word & MaxPacket;
+        const bool is_run = word & RunFlag;
+
+        const size_t bytes = (is_run ? 1 : count) * sizeof(float);
+
+        if (pos + bytes > size || out + count > data.size())
+            return false;
+
+        if (is_run)
+        {
+            float value;
+            std::memcpy(&value, src + pos, sizeof(float));
+            std::fill_n(&data[out], count, value);
+        }
+
+        else
+        {
+            std::memcpy(&data[out], src + pos, bytes);
+        }
+
+        pos += bytes;
+        out += count;
+    }
+
+    return out == data.size();
+}
+
+TileCache::Cache::Cache(const fs::path& directory, size_t max_bytes, size_t tile_size)
+    : m_Directory(directory), m_MaxBytes(max_bytes), m_TileSize(tile_size)
+{
+    fs::create_directories(m_Directory);
+
+    for (const auto& file : fs::directory_iterator(m_Directory))
+    {
+        if (!file.is_regular_file() || file.path().extension() != TileExtension)
+            continue;
+
+        const Entry entry{
+            .Bytes = static_cast<size_t>(file.file_size()),
+            .LastUse = file.last_write_time()
+        };
+
+        m_Entries[file.path().filename().string()] = entry;
+        m_TotalBytes += entry.Bytes;
+    }
+
+    RemoveFiles(Evict());
+}
+
+TileCache::Stats TileCache::Cache::GetStats() const
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Stats;
+}
+
+void TileCache::Cache::GenerateFractal(std::span<float> data, GenFunction f, FractalGenerator g,
+                                       GenData::FrameParams p, GenData::ExecutionPolicy e)
+{
+    const int64_t size = static_cast<int64_t>(m_TileSize);
+    const int64_t width = static_cast<int64_t>(p.Width);
+    const int64_t height = static_cast<int64_t>(p.Height);
+
+    //Scale is rounded to float, so that the key fully determines tile coordinates
+    const float scale_key = static_cast<float>((double(p.MaxX) - double(p.MinX)) / double(p.Width));
+    const double scale = scale_key;
+
+    //Lattice coordinates of the left column and the top row
+    //(in GenerateFractal row r lies at MinY + scale * (Height - r))
+    const int64_t left = std::llround(double(p.MinX) / scale);
+    const int64_t top = std::llround(double(p.MinY) / scale) + height;
+
+    //Tile (tx, ty) covers columns [tx*size, (tx+1)*size) and rows ((ty)*size, (ty+1)*size],
+    //with its row r lying at lattice row (ty+1)*size - r
+    const int64_t tx_min = FloorDiv(left, size);
+    const int64_t tx_max = FloorDiv(left + width - 1, size);
+    const int64_t ty_min = FloorDiv(top - height, size);
+    const int64_t ty_max = FloorDiv(top - 1, size);
+
+    const int64_t tiles_x = tx_max - tx_min + 1;
+    const int64_t num_tiles = tiles_x * (ty_max - ty_min + 1);
+
+    //Kernels differ slightly between simd types (e.g. in bailout radius), so tiles are not shared between them
+    //Julia tiles also depend on the constant of the render
+    char prefix[96];
+    std::snprintf(prefix, sizeof(prefix), "v%u-%u-%u-%u-%08x", KernelVersion, static_cast<uint32_t>(g),
+                  static_cast<uint32_t>(e.Simd), IterationBudget, Bits(scale_key));
+
+    if (g == FractalGenerator::Julia)
+    {
+        const size_t len = std::strlen(prefix);
+        std::snprintf(prefix + len, sizeof(prefix) - len, "-%08x-%08x", Bits(f.Params.JuliaRe), Bits(f.Params.JuliaIm));
+    }
+
+    std::atomic<int64_t> next_tile{0};
+
+    auto ProcessTiles = [&]()
+    {
+        AlignedVector<float> tile(m_TileSize * m_TileSize);
+
+        for (int64_t id = next_tile++; id < num_tiles; id = next_tile++)
+        {
+            const int64_t tx = tx_min + id % tiles_x;
+            const int64_t ty = ty_min + id / tiles_x;
+
+            const std::string name = std::string(prefix) + "-" + std::to_string(tx) + "-" + std::to_string(ty) + TileExtension;
+            const fs::path path = m_Directory / name;
+
+            if (!Load(path, tile))
+            {
+                const GenData::FrameParams tile_params{
+                    .MinX   = static_cast<float>(double(tx * size) * scale),
+                    .MaxX   = static_cast<float>(double((tx + 1) * size) * scale),
+                    .MinY   = static_cast<float>(double(ty * size) * scale),
+                    .MaxY   = static_cast<float>(double((ty + 1) * size) * scale),
+                    .Width  = m_TileSize,
+                    .Height = m_TileSize
+                };
+
+                const GenData::TileRect rect{0, 0, m_TileSize, m_TileSize};
+
+                GenData::GenerateTile(tile.data(), f, tile_params, rect, e.Simd);
+
+                Store(path, tile);
+            }
+
+            //Copy the part overlapping the frame
+            const int64_t col_begin = std::max<int64_t>(0, tx * size - left);
+            const int64_t col_end = std::min<int64_t>(width, (tx + 1) * size - left);
+
+            for (int64_t r = 0; r < size; r++)
+            {
+                const int64_t row = top - ((ty + 1) * size - r);
+
+                if (row < 0 || row >= height)
+                    continue;
+
+                const float* src = &tile[r * size + (col_begin + left - tx * size)];
+                float* dst = &data[row * width + col_begin];
+
+                std::copy(src, src + (col_end - col_begin), dst);
+            }
+        }
+    };
+
+    const size_t num_threads = e.NumJobs.has_value()
+                             ? e.NumJobs.value()
+                             : std::thread::hardware_concurrency();
+
+    if (num_threads > 1)
+    {
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < num_threads; i++)
+            threads.push_back(std::thread(ProcessTiles));
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    else
+    {
+        ProcessTiles();
+    }
+}
+
+bool TileCache::Cache::Load(const fs::path& path, std::span<float> tile)
+{
+    const std::string name = path.filename().string();
+
+    {
+        std::lock_guard lock(m_Mutex);
+
+        if (!m_Entries.contains(name))
+        {
+            m_Stats.Misses++;
+            return false;
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    std::vector<uint8_t> bytes;
+
+    if (file)
+    {
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    }
+
+    const size_t header_size = sizeof(TileMagic) + sizeof(uint32_t);
+
+    bool valid = file && bytes.size() >= header_size
+        && std::memcmp(bytes.data(), TileMagic, sizeof(TileMagic)) == 0;
+
+    if (valid)
+    {
+        uint32_t tile_size;
+        std::memcpy(&tile_size, bytes.data() + sizeof(TileMagic), sizeof(tile_size));
+
+        valid = (tile_size == m_TileSize)
+            && Decompress(bytes.data() + header_size, bytes.size() - header_size, tile);
+    }
+
+    const auto now = fs::file_time_type::clock::now();
+
+    {
+        std::lock_guard lock(m_Mutex);
+
+        const auto it = m_Entries.find(name);
+
+        if (!valid)
+        {
+            if (it != m_Entries.end())
+            {
+                m_TotalBytes -= it->second.Bytes;
+                m_Entries.erase(it);
+            }
+
+            m_Stats.Misses++;
+        }
+
+        else
+        {
+            if (it != m_Entries.end())
+                it->second.LastUse = now;
+
+            m_Stats.Hits++;
+        }
+    }
+
+    std::error_code ec;
+
+    if (!valid)
+    {
+        //Unreadable tiles are dropped and recomputed
+        fs::remove(path, ec);
+        return false;
+    }
+
+    //Modification time doubles as the last use time, so LRU order survives between runs
+    fs::last_write_time(path, now, ec);
+
+    return true;
+}
+
+void TileCache::Cache::Store(const fs::path& path, std::span<const float> tile)
+{
+    const std::vector<uint8_t> payload = Compress(tile);
+    const uint32_t tile_size = static_cast<uint32_t>(m_TileSize);
+
+    //Written under a temporary name, so that other processes never see partial tiles
+    //Name is unique per process and store, concurrent writers of the same tile each rename a complete file
+    static const uint64_t process_tag = std::random_device{}();
+    static std::atomic<uint64_t> store_counter{0};
+
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), ".%016llx-%llu.tmp", static_cast<unsigned long long>(process_tag),
+                  static_cast<unsigned long long>(store_counter++));
+
+    fs::path temp = path;
+    temp += suffix;
+
+    {
+        std::ofstream file(temp, std::ios::binary);
+
+        file.write(TileMagic, sizeof(TileMagic));
+        file.write(reinterpret_cast<const char*>(&tile_size), sizeof(tile_size));
+        file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+        if (!file)
+        {
+            file.close();
+
+            std::error_code ec;
+            fs::remove(temp, ec);
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+
+    if (ec)
+    {
+        fs::remove(temp, ec);
+        return;
+    }
+
+    const Entry entry{
+        .Bytes = sizeof(TileMagic) + sizeof(tile_size) + payload.size(),
+        .LastUse = fs::file_time_type::clock::now()
+    };
+
+    std::vector<std::string> victims;
+
+    {
+        std::lock_guard lock(m_Mutex);
+
+        const std::string name = path.filename().string();
+
+        if (m_Entries.contains(name))
+            m_TotalBytes -= m_Entries[name].Bytes;
+
+        m_Entries[name] = entry;
+        m_TotalBytes += entry.Bytes;
+
+        if (m_TotalBytes > m_MaxBytes)
+            victims = Evict();
+    }
+
+    RemoveFiles(victims);
+}
+
+//Expects the mutex to be held (or no other threads running)
+std::vector<std::string> TileCache::Cache::Evict()
+{
+    std::vector<std::string> victims;
+
+    if (m_TotalBytes <= m_MaxBytes)
+        return victims;
+
+    const size_t target = m_MaxBytes / EvictDenominator * EvictNumerator;
+
+    //One sort of all entries per eviction batch, oldest first
+    std::vector<std::pair<fs::file_time_type, std::string>> order;
+    order.reserve(m_Entries.size());
+
+    for (const auto& [name, entry] : m_Entries)
+        order.emplace_back(entry.LastUse, name);
+
+    std::sort(order.begin(), order.end());
+
+    for (const auto& [last_use, name] : order)
+    {
+        if (m_TotalBytes <= target)
+            break;
+
+        m_TotalBytes -= m_Entries[name].Bytes;
+        m_Entries.erase(name);
+
+        m_Stats.Evictions++;
+
+        victims.push_back(name);
+    }
+
+    return victims;
+}
+
+//A tile stored again between its eviction and the removal loses its new file as well,
+//its entry then fails to load once and the tile is recomputed
+void TileCache::Cache::RemoveFiles(const std::vector<std::string>& names) const
+{
+    for (const std::string& name : names)
+    {
+        std::error_code ec;
+        fs::remove(m_Directory / name, ec);
+    }
+}
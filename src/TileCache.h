@@ -0,0 +1,65 @@
+#pragma once
+
+#include <span>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+
+#include "ComputeFractal.h"
+#include "GenData.h"
+
+//Persistent cache of generated tiles, shared between runs
+//Tiles lie on a global pixel lattice (pixel (i, j) sits at (i*scale, j*scale)),
+//so that overlapping viewports at the same scale map to the same tiles
+//Tiles are keyed by kernel version, generator, simd type, iteration budget, pixel scale
+//and lattice coordinates, and stored run-length compressed, one file per tile
+namespace TileCache {
+
+    struct Stats{
+        size_t Hits = 0;
+        size_t Misses = 0;
+        size_t Evictions = 0;
+    };
+
+    class Cache{
+    public:
+        //Size cap is enforced by evicting least recently used tiles in batches,
+        //down to 7/8 of the cap once it is exceeded
+        Cache(const std::filesystem::path& directory, size_t max_bytes, size_t tile_size = 64);
+
+        //Same as GenData::GenerateFractal, but tiles found on disk are read instead of computed
+        //Frame origin is snapped to the lattice, shifting the image by at most half a pixel
+        void GenerateFractal(std::span<float> data, GenFunction f, FractalGenerator g,
+                             GenData::FrameParams p, GenData::ExecutionPolicy e);
+
+        Stats GetStats() const;
+
+    private:
+        struct Entry{
+            size_t Bytes;
+            std::filesystem::file_time_type LastUse;
+        };
+
+        bool Load(const std::filesystem::path& path, std::span<float> tile);
+        void Store(const std::filesystem::path& path, std::span<const float> tile);
+
+        //Drops least recently used entries, returns names of their files, which callers
+        //remove after releasing the mutex, so that other threads do not wait for the disk
+        std::vector<std::string> Evict();
+        void RemoveFiles(const std::vector<std::string>& names) const;
+
+    private:
+        std::filesystem::path m_Directory;
+        size_t m_MaxBytes;
+        size_t m_TileSize;
+
+        mutable std::mutex m_Mutex;
+        std::unordered_map<std::string, Entry> m_Entries;
+        size_t m_TotalBytes = 0;
+
+        Stats m_Stats;
+    };
+}
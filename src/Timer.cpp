@@ -3,7 +3,7 @@
 #include <iostream>
 
 Timer::Timer(const std::string& msg)
-	: m_Message(msg)
+	: m_Message(msg), m_Zone(Trace::Intern(msg))
 {
 	m_Start = std::chrono::high_resolution_clock::now();
 }
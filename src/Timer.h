@@ -3,6 +3,9 @@
 #include <chrono>
 #include <string>
 
+#include "Trace.h"
+
+//Prints the duration of a scope, and records it as a trace zone when tracing
 class Timer {
 public:
 	Timer(const std::string& msg);
@@ -11,4 +14,5 @@ public:
 private:
 	std::chrono::time_point<std::chrono::high_resolution_clock> m_Start;
 	std::string m_Message;
+	Trace::Zone m_Zone;
 };
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "Topology.h"
+
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+//Parses kernel cpu lists like "0-3,8-11"
+static std::vector<uint32_t> ParseCpuList(const std::string& text)
+{
+    std::vector<uint32_t> cpus;
+
+    std::stringstream stream(text);
+
+    for (std::string range; std::getline(stream, range, ',');)
+    {
+        const size_t dash = range.find('-');
+
+        try
+        {
+            const uint32_t first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+            const uint32_t last = (dash == std::string::npos) ? first
+                                : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+
+            for (uint32_t cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        }
+
+        catch (const std::exception&)
+        {
+            //Empty or malformed range, e.g. memory-only node
+        }
+    }
+
+    return cpus;
+}
+
+static std::vector<uint32_t> AllowedCpus()
+{
+    std::vector<uint32_t> cpus;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+    }
+#endif
+
+    if (cpus.empty())
+    {
+        for (uint32_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+static Topology::Layout Simulate(const std::string& spec, const std::vector<uint32_t>& allowed)
+{
+    Topology::Layout layout;
+    layout.Simulated = true;
+
+    const size_t x = spec.find('x');
+
+    size_t num_nodes = 1, cpus_per_node = allowed.size();
+
+    try
+    {
+        num_nodes = std::stoul(spec.substr(0, x));
+
+        if (x != std::string::npos)
+            cpus_per_node = std::stoul(spec.substr(x + 1));
+    }
+
+    catch (const std::exception&)
+    {
+        num_nodes = 1;
+    }
+
+    num_nodes = std::max<size_t>(1, num_nodes);
+    cpus_per_node = std::max<size_t>(1, cpus_per_node);
+
+    for (size_t node = 0; node < num_nodes; node++)
+    {
+        std::vector<uint32_t> cpus;
+
+        for (size_t i = 0; i < cpus_per_node; i++)
+            cpus.push_back(allowed[(node * cpus_per_node + i) % allowed.size()]);
+
+        layout.Nodes.push_back(std::move(cpus));
+    }
+
+    return layout;
+}
+
+static Topology::Layout Discover()
+{
+    const std::vector<uint32_t> allowed = AllowedCpus();
+
+    if (const char* spec = std::getenv("CF_TOPOLOGY"); spec != nullptr && *spec != '\0')
+        return Simulate(spec, allowed);
+
+    Topology::Layout layout;
+
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> nodes;
+
+    std::error_code ec;
+
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+    {
+        const std::string name = entry.path().filename().string();
+
+        if (!name.starts_with("node") || name.size() == 4
+            || !std::all_of(name.begin() + 4, name.end(), [](char ch){return ch >= '0' && ch <= '9';}))
+            continue;
+
+        std::ifstream file(entry.path() / "cpulist");
+
+        std::string text;
+        std::getline(file, text);
+
+        std::vector<uint32_t> cpus;
+
+        for (const uint32_t cpu : ParseCpuList(text))
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                cpus.push_back(cpu);
+
+        if (!cpus.empty())
+            nodes.emplace_back(static_cast<uint32_t>(std::stoul(name.substr(4))), std::move(cpus));
+    }
+
+    std::sort(nodes.begin(), nodes.end());
+
+    for (auto& [id, cpus] : nodes)
+        layout.Nodes.push_back(std::move(cpus));
+
+    if (layout.Nodes.empty())
+        layout.Nodes.push_back(allowed);
+
+    return layout;
+}
+
+const Topology::Layout& Topology::Get()
+{
+    static const Layout layout = Discover();
+    return layout;
+}
+
+size_t Topology::NumNodes()
+{
+    return Get().Nodes.size();
+}
+
+size_t Topology::NodeOfWorker(size_t worker, size_t num_workers)
+{
+    return worker * NumNodes() / std::max<size_t>(1, num_workers);
+}
+
+bool Topology::PinWorker(size_t worker, size_t num_workers)
+{
+    const Layout& layout = Get();
+
+    const size_t node = NodeOfWorker(worker, num_workers);
+
+    //First worker of the node, the rest of its block takes the following cpus
+    const size_t first = (node * num_workers + layout.Nodes.size() - 1) / layout.Nodes.size();
+
+    const std::vector<uint32_t>& cpus = layout.Nodes[node];
+    const uint32_t cpu = cpus[(worker - std::min(first, worker)) % cpus.size()];
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+std::string Topology::Describe()
+{
+    const Layout& layout = Get();
+
+    std::ostringstream res;
+
+    res << layout.Nodes.size() << (layout.Nodes.size() == 1 ? " node" : " nodes")
+        << (layout.Simulated ? " (simulated)" : "") << ":";
+
+    for (size_t node = 0; node < layout.Nodes.size(); node++)
+    {
+        const std::vector<uint32_t>& cpus = layout.Nodes[node];
+
+        res << ((node == 0) ? " " : " | ");
+
+        //Consecutive cpus are printed as ranges
+        for (size_t i = 0; i < cpus.size();)
+        {
+            size_t j = i;
+
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+                j++;
+
+            res << (i == 0 ? "" : ",") << cpus[i];
+
+            if (j > i)
+                res << "-" << cpus[j];
+
+            i = j + 1;
+        }
+    }
+
+    return res.str();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//NUMA nodes of the machine and placement of worker threads on them
+//Workers of a parallel loop are assigned to nodes in contiguous blocks,
+//the same way jobs split a frame into contiguous ranges, so that worker i
+//of n touches, and later writes, memory of the same node in every stage
+namespace Topology {
+
+    struct Layout{
+        //Cpu ids of every node
+        std::vector<std::vector<uint32_t>> Nodes;
+        //Read from CF_TOPOLOGY instead of the system
+        bool Simulated = false;
+    };
+
+    //Discovered on first use from /sys/devices/system/node, limited to cpus the process may run on
+    //CF_TOPOLOGY=<nodes>x<cpus per node> simulates a machine, e.g. 2x4 for two sockets of four cpus;
+    //simulated cpus wrap around the real ones, so pinning works on any machine
+    const Layout& Get();
+
+    size_t NumNodes();
+
+    size_t NodeOfWorker(size_t worker, size_t num_workers);
+
+    //Pins the calling thread to the cpu of given worker, returns false if that is not possible
+    bool PinWorker(size_t worker, size_t num_workers);
+
+    //E.g. "2 nodes (simulated): 0-3 | 4-7"
+    std::string Describe();
+}
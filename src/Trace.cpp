@@ -0,0 +1,208 @@
+#include "Trace.h"
+
+#include <set>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+namespace Trace {
+
+    static std::mutex s_NamesMutex;
+    static std::set<std::string> s_Names;
+
+#ifdef CF_TRACING
+
+    std::atomic<bool> Enabled{false};
+
+    struct Event{
+        const char* Name;
+        int64_t Arg;
+        int64_t Start;
+        int64_t Duration;
+    };
+
+    //Power of two, 1 MiB of zones per timeline row
+    static constexpr size_t BufferCapacity = size_t(1) << 15;
+
+    struct Buffer{
+        std::unique_ptr<Event[]> Events = std::make_unique<Event[]>(BufferCapacity);
+        //Total number of recorded zones, including overwritten ones
+        size_t Count = 0;
+        uint32_t Row = 0;
+    };
+
+    static std::chrono::steady_clock::time_point s_Origin;
+
+    static std::mutex s_BuffersMutex;
+    static std::vector<std::unique_ptr<Buffer>> s_Buffers;
+    //Buffers of threads that have exited, reused by new ones
+    static std::vector<Buffer*> s_FreeBuffers;
+
+    //Claims a buffer on the first zone of a thread and returns it when the thread exits
+    class LocalBuffer{
+    public:
+        ~LocalBuffer()
+        {
+            if (m_Buffer == nullptr)
+                return;
+
+            std::lock_guard lock(s_BuffersMutex);
+            s_FreeBuffers.push_back(m_Buffer);
+        }
+
+        Buffer& Get()
+        {
+            if (m_Buffer != nullptr)
+                return *m_Buffer;
+
+            std::lock_guard lock(s_BuffersMutex);
+
+            if (!s_FreeBuffers.empty())
+            {
+                m_Buffer = s_FreeBuffers.back();
+                s_FreeBuffers.pop_back();
+            }
+
+            else
+            {
+                s_Buffers.push_back(std::make_unique<Buffer>());
+                m_Buffer = s_Buffers.back().get();
+                m_Buffer->Row = static_cast<uint32_t>(s_Buffers.size() - 1);
+            }
+
+            return *m_Buffer;
+        }
+
+    private:
+        Buffer* m_Buffer = nullptr;
+    };
+
+    static thread_local LocalBuffer t_Buffer;
+
+    void Record(const char* name, int64_t arg, std::chrono::steady_clock::time_point start)
+    {
+        const auto end = std::chrono::steady_clock::now();
+
+        Buffer& buffer = t_Buffer.Get();
+
+        buffer.Events[buffer.Count % BufferCapacity] = Event{
+            .Name     = name,
+            .Arg      = arg,
+            .Start    = std::chrono::duration_cast<std::chrono::nanoseconds>(start - s_Origin).count(),
+            .Duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()
+        };
+
+        buffer.Count++;
+    }
+
+    void Start()
+    {
+        {
+            std::lock_guard lock(s_BuffersMutex);
+
+            for (auto& buffer : s_Buffers)
+                buffer->Count = 0;
+        }
+
+        s_Origin = std::chrono::steady_clock::now();
+        Enabled = true;
+    }
+
+    static void WriteEscaped(std::ostream& out, const char* text)
+    {
+        for (; *text != '\0'; text++)
+        {
+            if (*text == '"' || *text == '\\')
+                out << '\\';
+
+            out << *text;
+        }
+    }
+
+    bool Write(const std::string& path)
+    {
+        Enabled = false;
+
+        std::ofstream out(path);
+
+        if (!out)
+        {
+            std::cerr << "Failed to open trace file " << path << '\n';
+            return false;
+        }
+
+        std::lock_guard lock(s_BuffersMutex);
+
+        size_t recorded = 0, dropped = 0;
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+        bool first = true;
+
+        for (const auto& buffer : s_Buffers)
+        {
+            if (!first)
+                out << ",\n";
+
+            first = false;
+
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->Row
+                << ",\"args\":{\"name\":\"Thread " << buffer->Row << "\"}}";
+
+            const size_t begin = (buffer->Count > BufferCapacity) ? buffer->Count - BufferCapacity : 0;
+
+            for (size_t i = begin; i < buffer->Count; i++)
+            {
+                const Event& e = buffer->Events[i % BufferCapacity];
+
+                //Timestamps are in microseconds, fractions keep nanosecond resolution
+                out << ",\n{\"name\":\"";
+                WriteEscaped(out, e.Name);
+                out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->Row
+                    << ",\"ts\":" << e.Start / 1000 << '.' << std::to_string(1000 + e.Start % 1000).substr(1)
+                    << ",\"dur\":" << e.Duration / 1000 << '.' << std::to_string(1000 + e.Duration % 1000).substr(1);
+
+                if (e.Arg >= 0)
+                    out << ",\"args\":{\"index\":" << e.Arg << '}';
+
+                out << '}';
+            }
+
+            recorded += buffer->Count - begin;
+            dropped += begin;
+        }
+
+        out << "\n]}\n";
+
+        std::cout << "Trace: " << recorded << " zones on " << s_Buffers.size() << " rows written to " << path;
+
+        if (dropped > 0)
+            std::cout << ", " << dropped << " oldest zones overwritten";
+
+        std::cout << '\n';
+
+        return static_cast<bool>(out);
+    }
+
+#else
+
+    void Start()
+    {
+        std::cerr << "Tracing was disabled at build time (TRACING=OFF), no trace will be recorded\n";
+    }
+
+    bool Write(const std::string&)
+    {
+        return false;
+    }
+
+#endif
+
+    const char* Intern(const std::string& name)
+    {
+        std::lock_guard lock(s_NamesMutex);
+        return s_Names.insert(name).first->c_str();
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//Timeline of scoped zones, exported in the Chrome trace event format
+//(chrome://tracing, ui.perfetto.dev) to see per thread load balance and stalls
+//Every thread records into its own ring buffer, so recording takes no locks;
+//when a buffer is full its oldest zones are overwritten
+//Buffers of finished threads are handed to the next thread that starts recording,
+//so short lived workers of consecutive frames share a few timeline rows
+//Recording is off until Start is called, a disabled zone costs one relaxed load
+//Configuring with -DTRACING=OFF removes the zones from the build entirely
+namespace Trace {
+
+    //Begins recording, clears zones of a previous recording
+    void Start();
+    //Writes recorded zones as json, should be called once worker threads are idle
+    bool Write(const std::string& path);
+
+    //Stable copy of the name, for zones whose name is not a literal
+    const char* Intern(const std::string& name);
+
+#ifdef CF_TRACING
+
+    extern std::atomic<bool> Enabled;
+
+    void Record(const char* name, int64_t arg, std::chrono::steady_clock::time_point start);
+
+    //Records the time between construction and destruction, name must outlive the recording
+    class Zone{
+    public:
+        Zone(const char* name, int64_t arg = -1)
+        {
+            if (Enabled.load(std::memory_order_relaxed))
+            {
+                m_Name = name;
+                m_Arg = arg;
+                m_Start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Zone()
+        {
+            if (m_Name != nullptr)
+                Record(m_Name, m_Arg, m_Start);
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char* m_Name = nullptr;
+        int64_t m_Arg = -1;
+        std::chrono::steady_clock::time_point m_Start{};
+    };
+
+#else
+
+    class Zone{
+    public:
+        Zone(const char*, int64_t = -1) {}
+    };
+
+#endif
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef CF_TRACING
+    //Optional second argument is shown with the zone, e.g. frame or tile index
+    #define TRACE_ZONE(...) Trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(__VA_ARGS__)
+#else
+    #define TRACE_ZONE(...) ((void)0)
+#endif
@@ -2,40 +2,559 @@
 
 #include "ComputeFractal.h"
 #include "GenData.h"
+#include "ExpMap.h"
+#include "Render.h"
 #include "Image.h"
+#include "Memory.h"
+#include "DataDump.h"
+#include "TileCache.h"
+#include "Pyramid.h"
+#include "Checkpoint.h"
+#include "PerfCounters.h"
+#include "Autotune.h"
+#include "Topology.h"
+#include "Buddhabrot.h"
+#include "Equalize.h"
 
 #include "ParseInput.h"
+#include "Server.h"
+#include "Coordinator.h"
 
-int main(int argc, char* argv[])
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+static void SaveCostMap(const GenData::CostMap& cost, uint32_t frame, CostMapOutput output)
 {
-    ProgramArgs args = ParseInput(argc, argv);
+    if (output == CostMapOutput::Heatmap)
+    {
+        const Image::ImageInfo info{
+            .Width  = static_cast<uint32_t>(cost.Params.Width),
+            .Height = static_cast<uint32_t>(cost.Params.Height),
+            .Name   = std::to_string(frame) + "_cost.png"
+        };
 
-    if (args.ExitMessage.has_value())
+        Image::SaveHeatmap(cost.Iterations, info);
+    }
+
+    else if (output == CostMapOutput::Raw)
     {
-        std::cerr << args.ExitMessage.value() << '\n';
-        return -1;
+        std::ofstream file(std::to_string(frame) + "_cost.raw", std::ios::binary);
+
+        file.write(reinterpret_cast<const char*>(cost.Iterations.data()),
+                   static_cast<std::streamsize>(cost.Iterations.size() * sizeof(uint16_t)));
     }
+}
+
+//Upper end of values given to the coloring function by stages producing values in [0, 1]
+//NormedGrayscale takes values in [0, 1], the other palettes take iteration counts
+static float GetOutputScale(const ProgramArgs& args)
+{
+    return (args.Coloring == Image::ImageColoring::NormedGrayscale) ? 1.0f : static_cast<float>(IterationBudget);
+}
 
-    AlignedVector<float> data(args.Width*args.Height);
+static std::optional<Equalize::Equalizer> MakeEqualizer(const ProgramArgs& args)
+{
+    if (!args.Equalize)
+        return std::nullopt;
+
+    return Equalize::Equalizer(Equalize::EqualizeParams{
+        .Range       = GetValueRange(args.Generator),
+        .OutputScale = GetOutputScale(args),
+        .Smoothing   = args.EqualizeSmoothing
+    });
+}
 
-    auto gen_function = GetGeneratingFunction(args.Generator);
+//Out may be data itself
+static void EqualizeFrame(Equalize::Equalizer& equalizer, std::span<const float> data, std::span<float> out,
+                          const ProgramArgs& args)
+{
+    Timer we("Equalizing the histogram");
+    Perf::Stage stage("Equalize");
+
+    equalizer.Update(data, args.NumJobs, args.PinThreads);
+    equalizer.Apply(data, out, args.NumJobs, args.PinThreads);
+}
+
+static void RenderFrames(const ProgramArgs& args, SimdType simd_type, Memory::FramePool& pool,
+                         TileCache::Cache* cache, Checkpoint::Journal* journal)
+{
+    auto gen_function = GetGeneratingFunction(args.Generator, args.Formula);
     auto coloring_fn = Image::GetColoringFunction(args.Coloring);
 
-    SimdType simd_type = args.Simd.has_value()
-                       ? args.Simd.value()
-                       : SimdType::SSE;
+    const float aspect_ratio = static_cast<float>(args.Height)/static_cast<float>(args.Width);
+
+    float half_ext = 0.5f * args.InitialWidth;
+
+    float center_x = args.CenterX;
+    float center_y = args.CenterY;
+
+    //Float buffer outlives single frames, so that panned frames can reuse its contents
+    Memory::FramePool::Buffer<float> data;
+
+    if (args.KeepData && args.Format == DataFormat::Float)
+        data = pool.Acquire<float>(args.Width*args.Height);
+
+    std::optional<GenData::FrameParams> prev_params;
+
+    //Iterations executed in the last fully generated frame, balances the jobs of the next one
+    GenData::CostMap cost_map;
+
+    //Keeps the distribution of earlier frames for temporal smoothing
+    std::optional<Equalize::Equalizer> equalizer = MakeEqualizer(args);
+
+    auto NextFrame = [&]()
+    {
+        if (args.PanStep.has_value())
+        {
+            const float pixel_size = 2.0f * half_ext / static_cast<float>(args.Width);
+
+            center_x += pixel_size * static_cast<float>(args.PanStep.value()[0]);
+            center_y += pixel_size * static_cast<float>(args.PanStep.value()[1]);
+        }
+
+        half_ext *= args.ZoomSpeed;
+    };
+
+    for (uint32_t i=0; i<args.NumFrames; i++)
+    {
+        const GenData::ExecutionPolicy exec_policy{
+            .Simd = simd_type,
+            .NumJobs = args.NumJobs,
+            .TileSize = args.RenderTileSize.value(),
+            .PinThreads = args.PinThreads
+        };
+
+        const GenData::FrameParams params{
+            .MinX   = center_x - half_ext,
+            .MaxX   = center_x + half_ext,
+            .MinY   = center_y - aspect_ratio*half_ext,
+            .MaxY   = center_y + aspect_ratio*half_ext,
+            .Width  = args.Width,
+            .Height = args.Height
+        };
+
+        const Image::ImageInfo info{
+            .Width  = args.Width,
+            .Height = args.Height,
+            .Name   = std::to_string(i) + ".png"
+        };
+
+        if (journal != nullptr && journal->IsFrameDone(i, info.Name))
+        {
+            //Panned frames after the skipped ones start from scratch
+            prev_params.reset();
+            NextFrame();
+            continue;
+        }
+
+        TRACE_ZONE("Frame", i);
+
+        auto image = pool.Acquire<Image::Pixel>(args.Width*args.Height);
+
+        if (args.KeepData && args.Format == DataFormat::Float)
+        {
+            {
+                Timer we("Generating the fractal");
+                Perf::Stage stage("Generate");
+
+                if (args.PanStep.has_value() && prev_params.has_value())
+                {
+                    const size_t generated = GenData::GeneratePanned(data, gen_function, prev_params.value(), params, exec_policy);
+                    std::cout << "Generated " << generated << " of " << data.size() << " pixels\n";
+                }
+                else if (cache != nullptr)
+                    cache->GenerateFractal(data, gen_function, args.Generator, params, exec_policy);
+                else if (args.Layout != DataLayout::RowMajor)
+                {
+                    auto tiled = pool.Acquire<float>(Layout::BufferSize(args.Layout, args.Width, args.Height));
+
+                    Layout::GenerateFractal(tiled, args.Layout, gen_function, params, exec_policy);
+                    Layout::ToRowMajor(tiled, args.Layout, data, args.Width, args.Height, args.NumJobs);
+                }
+                else
+                    GenData::GenerateFractal(data, gen_function, params, exec_policy, cost_map);
+            }
+
+            //Panned and cached frames are only partially generated, their cost is unknown,
+            //tiled generation does not record it
+            const bool has_cost = !(args.PanStep.has_value() && prev_params.has_value()) && cache == nullptr
+                                && args.Layout == DataLayout::RowMajor;
+
+            if (!has_cost)
+                cost_map.Iterations.clear();
+
+            if (has_cost && args.CostMap != CostMapOutput::None)
+            {
+                Timer we("Saving the cost map");
+
+                SaveCostMap(cost_map, i, args.CostMap);
+            }
+
+            if (args.DumpData)
+            {
+                Timer we("Dumping the data");
+
+                const auto header = DataDump::MakeHeader(params, args.Generator, args.Format);
+                DataDump::Save(std::to_string(i) + ".cfd", header, data);
+            }
+
+            //Data itself stays intact, panned frames reuse it
+            if (equalizer.has_value())
+            {
+                auto equalized = pool.Acquire<float>(data.size());
+
+                EqualizeFrame(equalizer.value(), data, equalized, args);
+
+                Timer we("Coloring and saving the image");
+
+                Image::ColorAndSave(equalized, image, coloring_fn, info, args.NumJobs, args.PinThreads);
+            }
+
+            else
+            {
+                Timer we("Coloring and saving the image");
+
+                Image::ColorAndSave(data, image, coloring_fn, info, args.NumJobs, args.PinThreads);
+            }
+        }
+
+        else if (args.KeepData)
+        {
+            auto data = pool.Acquire<uint16_t>(args.Width*args.Height);
+
+            const QuantizationRange range = GetValueRange(args.Generator);
+
+            {
+                Timer we("Generating the fractal");
+                Perf::Stage stage("Generate");
+
+                GenData::GenerateFractal(data, gen_function, params, exec_policy, args.Format, range);
+            }
+
+            if (args.DumpData)
+            {
+                Timer we("Dumping the data");
+
+                const auto header = DataDump::MakeHeader(params, args.Generator, args.Format);
+                DataDump::Save(std::to_string(i) + ".cfd", header, data);
+            }
+
+            if (equalizer.has_value())
+            {
+                auto values = pool.Acquire<float>(data.size());
+
+                auto DecodeRange = [&](size_t start, size_t end)
+                {
+                    for (size_t j = start; j < end; j++)
+                        values[j] = (args.Format == DataFormat::Half) ? DecodeHalf(data[j]) : DecodeQuantized(data[j], range);
+                };
+
+                GenData::SplitIntoJobs(data.size(), DecodeRange, args.NumJobs, args.PinThreads);
+
+                EqualizeFrame(equalizer.value(), values, values, args);
+
+                Timer we("Coloring and saving the image");
+
+                Image::ColorAndSave(values, image, coloring_fn, info, args.NumJobs, args.PinThreads);
+            }
+
+            else
+            {
+                Timer we("Coloring and saving the image");
+
+                Image::ColorAndSave(data, args.Format, range, image, coloring_fn, info, args.NumJobs, args.PinThreads);
+            }
+        }
+
+        else
+        {
+            {
+                Timer we("Generating and coloring the fractal");
+                Perf::Stage stage("Generate and color");
+
+                Render::GenerateAndColor(image, gen_function, coloring_fn, params, exec_policy);
+            }
+
+            {
+                Timer we("Saving the image");
+
+                Image::SaveImage(image, info);
+            }
+        }
+
+        if (journal != nullptr)
+            journal->MarkFrameDone(i, info.Name);
+
+        Perf::PrintFrame(i, params.Width * params.Height);
+
+        prev_params = params;
+
+        NextFrame();
+    }
+}
+
+static void RenderExpMap(const ProgramArgs& args, SimdType simd_type, Memory::FramePool& pool,
+                         Checkpoint::Journal* journal)
+{
+    auto gen_function = GetGeneratingFunction(args.Generator, args.Formula);
+    auto coloring_fn = Image::GetColoringFunction(args.Coloring);
+
+    const GenData::ExecutionPolicy exec_policy{
+        .Simd = simd_type,
+        .NumJobs = args.NumJobs,
+        .PinThreads = args.PinThreads
+    };
+
+    const ExpMap::SequenceParams params{
+        .CenterX      = args.CenterX,
+        .CenterY      = args.CenterY,
+        .InitialWidth = args.InitialWidth,
+        .ZoomSpeed    = args.ZoomSpeed,
+        .NumFrames    = args.NumFrames,
+        .Width        = args.Width,
+        .Height       = args.Height
+    };
+
+    auto IsDone = [&](uint32_t i)
+    {
+        return journal != nullptr && journal->IsFrameDone(i, std::to_string(i) + ".png");
+    };
+
+    //Strip is only worth generating if some frame is still missing
+    uint32_t num_done = 0;
+
+    for (uint32_t i=0; i<args.NumFrames; i++)
+        num_done += IsDone(i);
+
+    if (num_done == args.NumFrames)
+        return;
+
+    ExpMap::Strip strip;
+
+    {
+        Timer we("Generating the log-polar strip");
+
+        strip = ExpMap::GenerateStrip(gen_function, params, exec_policy);
+    }
+
+    std::cout << "Strip size: " << strip.Params.Width << "x" << strip.Params.Height << '\n';
+
+    const ExpMap::FrameMapper mapper(strip, params);
+
+    std::optional<Equalize::Equalizer> equalizer = MakeEqualizer(args);
+
+    for (uint32_t i=0; i<args.NumFrames; i++)
+    {
+        if (IsDone(i))
+            continue;
+
+        TRACE_ZONE("Frame", i);
+
+        const Image::ImageInfo info{
+            .Width  = args.Width,
+            .Height = args.Height,
+            .Name   = std::to_string(i) + ".png"
+        };
+
+        auto data = pool.Acquire<float>(args.Width*args.Height);
+        auto image = pool.Acquire<Image::Pixel>(args.Width*args.Height);
+
+        {
+            Timer we("Mapping the frame");
+            Perf::Stage stage("Map");
+
+            mapper.MapFrame(data, i, args.NumJobs);
+        }
+
+        if (equalizer.has_value())
+            EqualizeFrame(equalizer.value(), data, data, args);
+
+        {
+            Timer we("Coloring and saving the image");
+
+            Image::ColorAndSave(data, image, coloring_fn, info, args.NumJobs, args.PinThreads);
+        }
+
+        if (journal != nullptr)
+            journal->MarkFrameDone(i, info.Name);
+
+        Perf::PrintFrame(i, info.Width * info.Height);
+    }
+}
+
+static void RenderStream(const ProgramArgs& args, SimdType simd_type, Checkpoint::Journal* journal)
+{
+    auto gen_function = GetGeneratingFunction(args.Generator, args.Formula);
+    auto coloring_fn = Image::GetColoringFunction(args.Coloring);
 
     const float aspect_ratio = static_cast<float>(args.Height)/static_cast<float>(args.Width);
 
+    const std::string extension = (args.OutputFormat == Image::StreamFormat::PNG) ? ".png" : ".ppm";
+
     float half_ext = 0.5f * args.InitialWidth;
 
     for (uint32_t i=0; i<args.NumFrames; i++)
     {
         const GenData::ExecutionPolicy exec_policy{
             .Simd = simd_type,
-            .NumJobs = args.NumJobs
+            .NumJobs = args.NumJobs,
+            .TileSize = args.RenderTileSize.value(),
+            .PinThreads = args.PinThreads
+        };
+
+        const GenData::FrameParams params{
+            .MinX   = args.CenterX - half_ext,
+            .MaxX   = args.CenterX + half_ext,
+            .MinY   = args.CenterY - aspect_ratio*half_ext,
+            .MaxY   = args.CenterY + aspect_ratio*half_ext,
+            .Width  = args.Width,
+            .Height = args.Height
+        };
+
+        const Image::ImageInfo info{
+            .Width  = args.Width,
+            .Height = args.Height,
+            .Name   = std::to_string(i) + extension
+        };
+
+        if (journal != nullptr && journal->IsFrameDone(i, info.Name))
+        {
+            half_ext *= args.ZoomSpeed;
+            continue;
+        }
+
+        TRACE_ZONE("Frame", i);
+
+        Render::StreamParams stream_params{
+            .BandHeight = args.BandHeight
         };
 
+        const size_t band_height = Render::GetBandHeight(stream_params, exec_policy);
+        const size_t tile_size = Render::GetTileSize(exec_policy);
+
+        //Bands written before an interruption are kept
+        const auto resume = (journal != nullptr)
+                          ? journal->GetBandState(i, info, args.OutputFormat, band_height, tile_size)
+                          : std::nullopt;
+
+        if (journal != nullptr)
+        {
+            stream_params.OnBandWritten = [&](Image::StreamWriter& writer)
+            {
+                journal->MarkBandDone(i, writer.GetState(), band_height, tile_size);
+            };
+        }
+
+        {
+            Timer we("Streaming the image");
+
+            Image::StreamWriter writer(info, args.OutputFormat, resume);
+
+            if (resume.has_value())
+                std::cout << "Resuming frame " << i << " at row " << writer.RowsWritten() << '\n';
+
+            Render::StreamBands(writer, gen_function, coloring_fn, params, exec_policy, stream_params);
+
+            writer.Finish();
+        }
+
+        if (journal != nullptr)
+            journal->MarkFrameDone(i, info.Name);
+
+        half_ext *= args.ZoomSpeed;
+    }
+}
+
+//Colors previously dumped frames without recomputing them
+//Frames are processed in parallel, each on a single thread, so that
+//the serial PNG encoding of one frame overlaps with others
+static void RenderRecolor(const ProgramArgs& args, Memory::FramePool& pool)
+{
+    auto coloring_fn = Image::GetColoringFunction(args.Coloring);
+
+    std::atomic<uint32_t> next_frame{0};
+
+    auto RecolorFrames = [&]()
+    {
+        for (uint32_t i = next_frame++; i < args.NumFrames; i = next_frame++)
+        {
+            TRACE_ZONE("Frame", i);
+
+            const DataDump::MappedFile file(std::to_string(i) + ".cfd");
+
+            if (!file.IsValid())
+            {
+                std::cerr << file.Error() << '\n';
+                continue;
+            }
+
+            const DataDump::Header& header = file.GetHeader();
+
+            const Image::ImageInfo info{
+                .Width  = header.Width,
+                .Height = header.Height,
+                .Name   = std::to_string(i) + ".png"
+            };
+
+            auto image = pool.Acquire<Image::Pixel>(size_t(header.Width) * size_t(header.Height));
+
+            const DataFormat format = static_cast<DataFormat>(header.Format);
+
+            if (format == DataFormat::Float)
+            {
+                Image::ColorAndSave(file.Floats(), image, coloring_fn, info, 1);
+            }
+
+            else
+            {
+                const QuantizationRange range{header.RangeMin, header.RangeMax};
+                Image::ColorAndSave(file.Compact(), format, range, image, coloring_fn, info, 1);
+            }
+        }
+    };
+
+    //hardware_concurrency may return 0 when it cannot tell
+    const size_t num_threads = std::max<size_t>(1, args.NumJobs.has_value()
+                                                   ? args.NumJobs.value()
+                                                   : std::thread::hardware_concurrency());
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < num_threads; i++)
+        threads.push_back(std::thread(RecolorFrames));
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+//Every frame gets a fixed time budget, the image is saved as far as it got
+static void RenderDeadline(const ProgramArgs& args, SimdType simd_type, Memory::FramePool& pool)
+{
+    auto gen_function = GetGeneratingFunction(args.Generator, args.Formula);
+    auto coloring_fn = Image::GetColoringFunction(args.Coloring);
+
+    const float aspect_ratio = static_cast<float>(args.Height)/static_cast<float>(args.Width);
+
+    const GenData::ExecutionPolicy exec_policy{
+        .Simd = simd_type,
+        .NumJobs = args.NumJobs,
+        .TileSize = args.RenderTileSize.value(),
+        .PinThreads = args.PinThreads
+    };
+
+    const Render::DeadlineParams deadline_params{
+        .Budget = std::chrono::microseconds(static_cast<int64_t>(1000.0f * args.TimeBudget)),
+        .CoarseStep = args.CoarseStep
+    };
+
+    float half_ext = 0.5f * args.InitialWidth;
+
+    for (uint32_t i=0; i<args.NumFrames; i++)
+    {
+        TRACE_ZONE("Frame", i);
+
         const GenData::FrameParams params{
             .MinX   = args.CenterX - half_ext,
             .MaxX   = args.CenterX + half_ext,
@@ -51,18 +570,311 @@ int main(int argc, char* argv[])
             .Name   = std::to_string(i) + ".png"
         };
 
+        auto image = pool.Acquire<Image::Pixel>(args.Width*args.Height);
+
+        const Render::DeadlineStats stats = Render::RenderWithDeadline(image, gen_function, coloring_fn,
+            params, exec_policy, deadline_params);
+
+        std::cout << "Frame " << i << ": " << 100.0 * stats.Coverage << "% at full resolution, "
+                  << "1/" << stats.Step << " resolution everywhere, "
+                  << static_cast<float>(stats.Elapsed.count()) / 1000.0f << "[ms]"
+                  << (stats.Cancelled ? ", refinement stopped at the deadline" : "") << '\n';
+
         {
-            Timer we("Generating the fractal");
+            Timer we("Saving the image");
 
-            GenData::GenerateFractal(data, gen_function, params, exec_policy);
+            Image::SaveImage(image, info);
         }
 
+        half_ext *= args.ZoomSpeed;
+    }
+}
+
+static void RenderBuddhabrot(const ProgramArgs& args, SimdType simd_type, Memory::FramePool& pool)
+{
+    auto coloring_fn = Image::GetColoringFunction(args.Coloring);
+
+    const float aspect_ratio = static_cast<float>(args.Height)/static_cast<float>(args.Width);
+
+    const GenData::ExecutionPolicy exec_policy{
+        .Simd = simd_type,
+        .NumJobs = args.NumJobs,
+        .PinThreads = args.PinThreads
+    };
+
+    float half_ext = 0.5f * args.InitialWidth;
+
+    for (uint32_t i=0; i<args.NumFrames; i++)
+    {
+        TRACE_ZONE("Frame", i);
+
+        const GenData::FrameParams params{
+            .MinX   = args.CenterX - half_ext,
+            .MaxX   = args.CenterX + half_ext,
+            .MinY   = args.CenterY - aspect_ratio*half_ext,
+            .MaxY   = args.CenterY + aspect_ratio*half_ext,
+            .Width  = args.Width,
+            .Height = args.Height
+        };
+
+        const Image::ImageInfo info{
+            .Width  = args.Width,
+            .Height = args.Height,
+            .Name   = std::to_string(i) + ".png"
+        };
+
+        auto data = pool.Acquire<float>(args.Width*args.Height);
+
+        const Buddhabrot::BuddhabrotStats stats = Buddhabrot::Accumulate(data, args.Generator, params,
+            args.OrbitParams, exec_policy);
+
+        std::cout << "Frame " << i << ": " << stats.Samples << " samples, "
+                  << stats.Contributing << " contributing, "
+                  << 1e-6 * static_cast<double>(stats.Samples) / stats.Seconds << " MSamples/s\n";
+
+        Buddhabrot::Normalize(data, GetOutputScale(args), args.NumJobs);
+
         {
             Timer we("Coloring and saving the image");
 
-            Image::ColorAndSave(data, coloring_fn, info, args.NumJobs);
+            Image::ColorAndSave(data, coloring_fn, info, args.NumJobs, args.PinThreads);
         }
 
         half_ext *= args.ZoomSpeed;
     }
-}
\ No newline at end of file
+}
+
+static void RenderPyramid(const ProgramArgs& args, SimdType simd_type)
+{
+    const GenData::ExecutionPolicy exec_policy{
+        .Simd = simd_type,
+        .NumJobs = args.NumJobs,
+        .PinThreads = args.PinThreads
+    };
+
+    std::ostringstream render;
+    render << static_cast<int>(args.Generator) << ' ' << static_cast<int>(args.Coloring) << ' '
+           << std::hexfloat << args.Formula.JuliaRe << ' ' << args.Formula.JuliaIm << ' '
+           << static_cast<int>(simd_type) << ' ' << KernelVersion;
+
+    const Pyramid::PyramidParams params{
+        .CenterX    = args.CenterX,
+        .CenterY    = args.CenterY,
+        .Width      = args.InitialWidth,
+        .MaxLevel   = args.PyramidLevels,
+        .TileSize   = args.TileSize,
+        .Directory  = args.PyramidDirectory,
+        .RenderHash = Checkpoint::Hash(render.str())
+    };
+
+    const Pyramid::PyramidStats stats = Pyramid::Export(GetGeneratingFunction(args.Generator, args.Formula),
+        Image::GetColoringFunction(args.Coloring), params, exec_policy);
+
+    std::cout << "Pyramid tiles: " << stats.Generated << " generated, "
+              << stats.Downsampled << " downsampled, "
+              << stats.Resumed << " from previous run\n";
+}
+
+int main(int argc, char* argv[])
+{
+    ProgramArgs args = ParseInput(argc, argv);
+
+    if (args.ExitMessage.has_value())
+    {
+        std::cerr << args.ExitMessage.value() << '\n';
+        return -1;
+    }
+
+    //Tuned parameters only fill in what the command line and config left unset
+    {
+        const std::filesystem::path profile_path = Autotune::DefaultPath();
+
+        std::optional<Autotune::Profile> profile;
+
+        if (args.Autotune)
+        {
+            //Server on stdin/stdout must not mix the log into its replies
+            profile = Autotune::Tune(args.ServeSocket.has_value() ? std::cerr : std::cout);
+
+            if (Autotune::Save(profile.value(), profile_path))
+                std::cerr << "Profile saved to " << profile_path.string() << '\n';
+            else
+                std::cerr << "Unable to save profile to " << profile_path.string() << '\n';
+
+            if (args.ConfigFile.empty() && !args.ServeSocket.has_value())
+                return 0;
+        }
+
+        else
+        {
+            profile = Autotune::Load(profile_path);
+        }
+
+        if (profile.has_value())
+        {
+            std::ostringstream applied;
+
+            if (!args.Simd.has_value())
+            {
+                args.Simd = profile->Simd;
+                applied << " simd " << Autotune::SimdName(profile->Simd) << ',';
+            }
+
+            if (!args.NumJobs.has_value())
+            {
+                args.NumJobs = profile->NumThreads;
+                applied << " threads " << profile->NumThreads << ',';
+            }
+
+            if (!args.RenderTileSize.has_value())
+            {
+                args.RenderTileSize = profile->TileSize;
+                applied << " tile " << profile->TileSize << ',';
+            }
+
+            std::ostream& log = args.ServeSocket.has_value() ? std::cerr : std::cout;
+
+            const std::string settings = applied.str();
+
+            if (settings.empty())
+                log << "Profile " << profile_path.string() << " overridden by command line and config\n";
+            else
+                log << "Using profile " << profile_path.string() << ":" << settings.substr(0, settings.size() - 1) << '\n';
+        }
+
+        if (!args.RenderTileSize.has_value())
+            args.RenderTileSize = GenData::ExecutionPolicy{}.TileSize;
+    }
+
+    SimdType simd_type = args.Simd.has_value()
+                       ? args.Simd.value()
+                       : SimdType::SSE;
+
+    if (args.ServeSocket.has_value())
+    {
+        const Server::ServerParams server_params{
+            .Simd = simd_type,
+            .NumThreads = args.NumJobs.has_value() ? args.NumJobs.value() : std::thread::hardware_concurrency()
+        };
+
+        return Server::Run(args.ServeSocket.value(), server_params);
+    }
+
+    if (!args.Workers.empty())
+    {
+        const Coordinator::CoordinatorParams coordinator_params{
+            .Workers = args.Workers,
+            .ConfigFile = args.ConfigFile
+        };
+
+        return Coordinator::Run(coordinator_params);
+    }
+
+    Memory::FramePool pool(args.HugePages, args.NumJobs, args.PinThreads);
+
+    if (args.PinThreads)
+        std::cout << "Pinning threads over " << Topology::Describe() << '\n';
+
+    std::optional<TileCache::Cache> cache;
+
+    std::optional<Checkpoint::Journal> journal;
+
+    if (args.CheckpointFile.has_value())
+    {
+        std::ifstream config(args.ConfigFile);
+
+        std::stringstream text;
+        text << config.rdbuf();
+
+        //Besides the config, the hash covers the effective execution policy that affects output:
+        //simd type and kernel version, since kernels may differ in the last bits, and the render tile size,
+        //which may come from the tuning profile and decides band boundaries of streamed frames
+        std::ostringstream policy;
+        policy << static_cast<int>(simd_type) << ' ' << KernelVersion << ' ' << args.RenderTileSize.value();
+
+        const uint64_t hash = Checkpoint::Hash(policy.str(), Checkpoint::Hash(text.str()));
+
+        journal.emplace(args.CheckpointFile.value(), hash);
+    }
+
+    Checkpoint::Journal* journal_ptr = journal.has_value() ? &journal.value() : nullptr;
+
+    if (args.TileCacheDir.has_value())
+    {
+        const size_t max_bytes = size_t(args.TileCacheMegabytes) * 1024 * 1024;
+        cache.emplace(args.TileCacheDir.value(), max_bytes);
+    }
+
+    if (args.TraceFile.has_value())
+        Trace::Start();
+
+    if (args.PerfCounters)
+        Perf::Enable();
+
+    {
+        Timer we("Rendering " + std::to_string(args.NumFrames) + " frames");
+
+        switch (args.Mode)
+        {
+            case RenderMode::Frames:
+            {
+                RenderFrames(args, simd_type, pool, cache.has_value() ? &cache.value() : nullptr, journal_ptr);
+                break;
+            }
+            case RenderMode::ExpMap:
+            {
+                RenderExpMap(args, simd_type, pool, journal_ptr);
+                break;
+            }
+            case RenderMode::Stream:
+            {
+                RenderStream(args, simd_type, journal_ptr);
+                break;
+            }
+            case RenderMode::Recolor:
+            {
+                RenderRecolor(args, pool);
+                break;
+            }
+            case RenderMode::Pyramid:
+            {
+                RenderPyramid(args, simd_type);
+                break;
+            }
+            case RenderMode::Deadline:
+            {
+                RenderDeadline(args, simd_type, pool);
+                break;
+            }
+            case RenderMode::Buddhabrot:
+            {
+                RenderBuddhabrot(args, simd_type, pool);
+                break;
+            }
+        }
+    }
+
+    if (args.TraceFile.has_value())
+        Trace::Write(args.TraceFile.value());
+
+    const Memory::PoolStats stats = pool.GetStats();
+
+    std::cout << "Frame buffers: " << stats.Allocations << " allocated, "
+              << stats.Reuses << " reused, "
+              << stats.PageFaults << " page faults taken, "
+              << stats.PageFaultsAvoided << " avoided\n";
+
+    if (stats.ExplicitFallbacks > 0)
+        std::cout << "Explicit huge pages unavailable, " << stats.ExplicitFallbacks
+                  << " buffers fell back to transparent ones\n";
+
+    if (cache.has_value())
+    {
+        const TileCache::Stats cache_stats = cache->GetStats();
+        const size_t lookups = cache_stats.Hits + cache_stats.Misses;
+
+        std::cout << "Tile cache: " << cache_stats.Hits << " hits, " << cache_stats.Misses << " misses ("
+                  << (lookups > 0 ? 100.0 * double(cache_stats.Hits) / double(lookups) : 0.0) << "% hit rate), "
+                  << cache_stats.Evictions << " evicted\n";
+    }
+}